@@ -14,6 +14,7 @@
  */
 
 #include "camera.h"
+#include "memory.h"
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -121,7 +122,7 @@ static void camResize( Camera* camera, int screenWidth, int screenHeight );
 Camera* camCreate( Vector eye, Vector at, Vector up, double fovy, double nearp, double farp,
 					int screenWidth, int screenHeight )
 {
-	Camera* camera = (struct _Camera *)malloc( sizeof(struct _Camera) );
+	Camera* camera = (struct _Camera *)memAlloc( MEM_SCENE, sizeof(struct _Camera) );
 
 	/* Copia propriedades */
 	camera->eye = eye;
@@ -155,6 +156,17 @@ Vector camGetEye( Camera* camera )
 	return camera->eye;
 }
 
+void camGetView( Camera* camera, Vector* eye, Vector* at, Vector* up, double* fovy,
+				double* nearp, double* farp )
+{
+	if( eye ) *eye = camera->eye;
+	if( at ) *at = camera->at;
+	if( up ) *up = camera->up;
+	if( fovy ) *fovy = camera->fovy;
+	if( nearp ) *nearp = camera->nearp;
+	if( farp ) *farp = camera->farp;
+}
+
 Vector camGetRay( Camera* camera, double x, double y )
 {
 	Vector u = algScale( ( x / camera->screenWidth ), camera->nearU );
@@ -164,6 +176,11 @@ Vector camGetRay( Camera* camera, double x, double y )
 	return algUnit( algSub( point, camera->eye ) );
 }
 
+double camGetPixelAngle( Camera* camera )
+{
+	return ( 2.0 * tan( ( M_PI * camera->fovy ) / ( 2.0 * 180.0 ) ) ) / camera->screenHeight;
+}
+
 int camGetScreenWidth( Camera* camera )
 {
 	return (int)camera->screenWidth;
@@ -177,7 +194,7 @@ int camGetScreenHeight( Camera* camera )
 
 void camDestroy( Camera* camera )
 {
-	free( camera );
+	memFree( camera );
 }
 
 
@@ -63,6 +63,13 @@ void camGetFarPlane( Camera* camera, Vector *origin, Vector *normal, Vector *u,
  */
 Vector camGetEye( Camera* camera );
 
+/**
+ *	Obtm as propriedades com que uma cmera foi criada (ver camCreate).
+ *	Qualquer parmetro de sada pode ser NULL.
+ */
+void camGetView( Camera* camera, Vector* eye, Vector* at, Vector* up, double* fovy,
+				double* nearp, double* farp );
+
 /**
  *	Obtm um raio saindo do eye de uma cmera e passando por um pixel especificado.
  *
@@ -73,6 +80,12 @@ Vector camGetEye( Camera* camera );
  */
 Vector camGetRay( Camera* camera, double x, double y );
 
+/**
+ *	Obtm o ngulo (em radianos) subentendido por um pixel no centro da tela.
+ *	Usado para estimar a abertura do cone de cada raio primrio.
+ */
+double camGetPixelAngle( Camera* camera );
+
 /**
  *	Obtm a largura da tela de uma cmera, em pixels.
  */
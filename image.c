@@ -12,6 +12,11 @@
  *	@version 2.0
  */
 
+/* fseeko com deslocamentos de 64 bits tambem em sistemas de 32 bits */
+#ifndef WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -20,6 +25,25 @@
 #include <float.h>
 #include "color.h"
 #include "image.h"
+#include "parallel.h"
+#include "trace.h"
+#include "memory.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 /* Compiler dependent definitions */
 typedef unsigned char BYTE;       
@@ -30,6 +54,10 @@ typedef unsigned long int DWORD;
 
 #define ROUND(_) (int)floor( (_) + 0.5 )
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 struct Image_imp {
 
 	int width;		/* numero de pixels na direcao horizontal da imagem */
@@ -41,20 +69,17 @@ struct Image_imp {
 
 typedef struct
 {
-	Color max;     /* maximos R's, G's e B's */
-	Color min;	   /* minimos R's, G's e B's */
-	float var;	   /* variacao em cada cubo  */
-	int ini;	   /* final do cubo  */
-	int fim;       /* inicio do cubo */
-	int maiorDim;  /* R=0, G=1, B=2  */
-	int checked;
+	int min[3];          /* menores celulas do histograma em R, G e B (inclusive) */
+	int max[3];          /* maiores celulas do histograma em R, G e B (inclusive) */
+	unsigned int count;  /* numero de pixels no cubo */
+	int maiorDim;        /* R=0, G=1, B=2  */
 } colorCube;
 
 /************************************************************************/
 /* Definicao das Funcoes Privadas                                       */
 /************************************************************************/
 
-/*  getuint e putuint:
+/*  fetchuint e storeuint:
 * Funcoes auxiliares para ler e escrever inteiros na ordem (lo-hi)
 * Note  que  no Windows as variaveis tipo "unsigned short int" sao 
 * armazenadas  no disco em dois bytes na ordem inversa. Ou seja, o 
@@ -67,1430 +92,1818 @@ typedef struct
 */
 
 /***************************************************************************
-* Reads an unsigned integer from input                                     *
-***************************************************************************/
-static int getuint(unsigned short *_uint, FILE *input)
-{
-	int got;
-	unsigned char temp[2];
-	unsigned short tempuint;
-
-	got = (int) fread(&temp, 1, 2, input);
-	if (got != 2) return 0;
-
-	tempuint = ((unsigned short)(temp[1])<<8) | ((unsigned short)(temp[0]));
-
-	*_uint = tempuint;
-
-	return 1;
-}
-
-/***************************************************************************
-* Writes an unsigned integer in output                                     *
+* Fetches an unsigned integer from a buffer                                *
 ***************************************************************************/
-static int putuint(unsigned short _uint, FILE *output)
+static unsigned short fetchuint(const unsigned char *src)
 {
-	int put;
-	unsigned char temp[2];
-
-	temp[0] = _uint & 0xff;
-	temp[1] = (_uint >> 8) & 0xff;
-
-	put = (int) fwrite(&temp, 1, 2, output);
-	if (put != 2) return 0;
-
-	return 1;
+	return (unsigned short)(((unsigned short)(src[1])<<8) | ((unsigned short)(src[0])));
 }
 
 /***************************************************************************
-* Reads a long integer from input                                          *
+* Fetches a double word from a buffer                                      *
 ***************************************************************************/ 
-static int getlong(FILE *input, long int *longint)
+static unsigned long int fetchdword(const unsigned char *src)
 {
-	int got;
-	unsigned char temp[4];
-	long int templongint;
-
-	got = (int)fread(&temp, 1, 4, input);
-	if (got != 4) return 0;
-
-	templongint = ((long int)(temp[3])<<24) | ((long int)(temp[2])<<16) 
-		| ((long int)(temp[1])<<8) | ((long int)(temp[0]));
-
-	*longint = templongint;
-
-	return 1;
+	return ((unsigned long int)(src[3])<<24) | ((unsigned long int)(src[2])<<16) 
+		| ((unsigned long int)(src[1])<<8) | ((unsigned long int)(src[0]));
 }
 
 /***************************************************************************
-* Writes a long integer in output                                          *
+* Fetches a signed long integer (32 bits) from a buffer                    *
 ***************************************************************************/ 
-static int putlong(FILE *output, long int longint)
+static long int fetchlong(const unsigned char *src)
 {
-	int put;
-	unsigned char temp[4];
+	unsigned long int v = fetchdword(src);
 
-	temp[0] = (unsigned char)longint & 0xff;
-	temp[1] = (unsigned char)(longint >> 8) & 0xff;
-	temp[2] = (unsigned char)(longint >> 16) & 0xff;
-	temp[3] = (unsigned char)(longint >> 24) & 0xff;
-
-	put = (int)fwrite(&temp, 1, 4, output);
-
-	if (put != 4) return 0;
-
-	return 1;
+	return (v & 0x80000000UL) ? -(long int)(0xFFFFFFFFUL - v) - 1 : (long int)v;
 }
 
 /***************************************************************************
-* Reads a word from input                                                  *
-***************************************************************************/ 
-static int getword(FILE *input, unsigned short int *word)
-{
-	int got;
-	unsigned char temp[2];
-	unsigned short int tempword;
-
-	got = (int)fread(&temp, 1, 2, input);
-	if (got != 2) return 0;
-
-	tempword = ((unsigned short int)(temp[1])<<8) | ((unsigned short int)(temp[0]));
-
-	*word = tempword;
-
-	return 1;
+* Stores an unsigned integer in a buffer                                   *
+***************************************************************************/
+static void storeuint(unsigned char *dst, unsigned short _uint)
+{
+	dst[0] = _uint & 0xff;
+	dst[1] = (_uint >> 8) & 0xff;
 }
 
-/***************************************************************************
-* Writes a word in output                                                  *
+/***************************************************************************
+* Stores a double word in a buffer                                         *
 ***************************************************************************/ 
-static int putword(FILE *output, unsigned short int word)
+static void storedword(unsigned char *dst, unsigned long int dword)
 {
-	int put;
-	unsigned char temp[2];
-
-	temp[0] = word & 0xff;
-	temp[1] = (word >> 8) & 0xff;
-
-	put = (int)fwrite(&temp, 1, 2, output);
-	if (put != 2) return 0;
-
-	return 1;
+	dst[0] = (unsigned char) (dword & 0xff);
+	dst[1] = (unsigned char) ((dword >>  8) & 0xff);
+	dst[2] = (unsigned char) ((dword >> 16) & 0xff);
+	dst[3] = (unsigned char) ((dword >> 24) & 0xff);
 }
 
-/***************************************************************************
-* Reads a double word from input                                           *
-***************************************************************************/ 
-static int getdword(FILE *input, unsigned long int *dword)
-{
-	int got;
-	unsigned char temp[4];
-	unsigned long int tempdword;
-
-	got = (int)fread(&temp, 1, 4, input);
-	if (got != 4) return 0;
-
-	tempdword = ((unsigned long int)(temp[3])<<24) | ((unsigned long int)(temp[2])<<16) 
-		| ((unsigned long int)(temp[1])<<8) | ((unsigned long int)(temp[0]));
-
-	*dword = tempdword;
-
-	return 1;
-}
+/***************************************************************************
+* Redimensionamento separavel                                              *
+***************************************************************************/
 
-/***************************************************************************
-* Writes a double word in output                                           *
-***************************************************************************/ 
-static int putdword(FILE *output, unsigned long int dword)
-{
-	int put;
-	unsigned char temp[4];
-
-	temp[0] = (unsigned char) (dword & 0xff);
-	temp[1] = (unsigned char) ((dword >>  8) & 0xff);
-	temp[2] = (unsigned char) ((dword >> 16) & 0xff);
-	temp[3] = (unsigned char) ((dword >> 24) & 0xff);
-
-	put = (int)fwrite(&temp, 1, 4, output);
-
-	if (put != 4) return 0;
-
-	return 1;
-}
+/* Contribuicoes dos pixels de origem para cada pixel de destino, em um eixo */
+typedef struct {
+	int n;           /* numero de pixels de destino */
+	int maxCount;    /* maximo de pixels de origem por pixel de destino */
+	int *first;      /* primeiro pixel de origem de cada pixel de destino */
+	int *count;      /* numero de pixels de origem de cada pixel de destino */
+	float *weight;   /* pesos, maxCount por pixel de destino (soma 1) */
+} ResizeAxis;
+
+/* Amostrador de imgSamplerCreate: a origem e os pesos de imgResizeFiltered */
+struct ImageSampler_imp {
+	Image *src;
+	ResizeAxis axisX;
+	ResizeAxis axisY;
+};
 
-/************************************************************************/
-/* Definicao das Funcoes Exportadas                                     */
-/************************************************************************/
+/* Uma passada do redimensionamento (horizontal ou vertical) */
+typedef struct {
+	const float *src;
+	float *dst;
+	int srcWidth;
+	int dstWidth;
+	const ResizeAxis *axis;
+} ResizePass;
 
-Image * imgCreate(int w, int h)
+static double resizeSupport(int filter)
 {
-	Image * image = (Image*) malloc (sizeof(Image));
-	assert(image);
-	image->width  =(unsigned int) w;
-	image->height =(unsigned int) h;
-	image->buf = (float *) malloc (w * h * 3*sizeof(float));
-	assert(image->buf);
-	return image;
+	switch (filter) {
+		case IMG_RESIZE_BOX:      return 0.5;
+		case IMG_RESIZE_LANCZOS:  return 3.0;
+		default:                  return 1.0;
+	}
 }
 
-void imgDestroy (Image *image)
+static double resizeKernel(int filter, double x)
 {
-   if (image)
-   {
-      if (image->buf) free (image->buf);
-      free(image);
-   }
+	switch (filter) {
+		case IMG_RESIZE_BOX:
+			return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+		case IMG_RESIZE_LANCZOS:
+			if (x == 0.0) return 1.0;
+			if (x <= -3.0 || x >= 3.0) return 0.0;
+			return 3.0 * sin(M_PI*x) * sin(M_PI*x/3.0) / (M_PI*M_PI*x*x);
+		default:
+			x = fabs(x);
+			return (x < 1.0) ? 1.0 - x : 0.0;
+	}
 }
 
-Image * imgCopy(Image * image)
+/* Calcula os pesos de um eixo. Ao reduzir, o filtro e' alargado pela escala
+   (media sobre a area do pixel de destino); nas bordas os pesos sao renormalizados. */
+static void resizeAxisBuild(ResizeAxis *axis, int n0, int n1, int filter)
 {
-	int w = imgGetWidth(image);
-	int h = imgGetHeight(image);
-	Image * img1=imgCreate(w,h);
-	int x,y;
-	float rgb[3];
+	double scale = (double)n1 / n0;
+	double filterScale = (scale < 1.0) ? 1.0/scale : 1.0;
+	double support = resizeSupport(filter) * filterScale;
+	int i, j;
+
+	axis->n = n1;
+	axis->maxCount = (int)ceil(2.0*support) + 2;
+	axis->first = (int *)malloc(n1*sizeof(int));
+	axis->count = (int *)malloc(n1*sizeof(int));
+	axis->weight = (float *)malloc(n1*axis->maxCount*sizeof(float));
+
+	for (i=0;i<n1;i++) {
+		double center = (i + 0.5) / scale;
+		int lo = (int)floor(center - support);
+		int hi = (int)ceil(center + support);
+		float *w = &axis->weight[i*axis->maxCount];
+		double sum = 0.0;
+		int count = 0;
+
+		if (lo < 0) lo = 0;
+		if (hi > n0) hi = n0;
+		if (hi - lo > axis->maxCount) hi = lo + axis->maxCount;
+
+		axis->first[i] = lo;
+		for (j=lo;j<hi;j++) {
+			double k = resizeKernel(filter, (j + 0.5 - center) / filterScale);
+			w[count++] = (float)k;
+			sum += k;
+		}
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
-			imgGetPixel3fv(image,x,y,rgb);
-			imgSetPixel3fv(img1,x,y,rgb);
+		if (sum == 0.0) {
+			/* nenhum peso (nunca deve acontecer): usa o pixel mais proximo */
+			int nearest = (int)center;
+			axis->first[i] = (nearest < n0) ? nearest : n0-1;
+			w[0] = 1.f;
+			count = 1;
+		}
+		else {
+			for (j=0;j<count;j++) w[j] = (float)(w[j]/sum);
 		}
+		axis->count[i] = count;
 	}
+}
 
-	return img1;
+static void resizeAxisFree(ResizeAxis *axis)
+{
+	free(axis->first);
+	free(axis->count);
+	free(axis->weight);
 }
 
-Image * imgGrey(Image * image)
+/* dst[0..n) += w*src[0..n), usado pelo redimensionamento e pela convolucao */
+static void accumulateRow(float *dst, const float *src, float w, int n)
 {
-	int w = imgGetWidth(image);
-	int h = imgGetHeight(image);
-	Image * img1=imgCreate(w,h);
-	int x,y;
-	float rgb[3],grey[3];
+	int i = 0;
+#ifdef __SSE__
+	__m128 vw = _mm_set1_ps(w);
+	for (;i+4<=n;i+=4)
+		_mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), _mm_mul_ps(vw, _mm_loadu_ps(src+i))));
+#endif
+	for (;i<n;i++)
+		dst[i] += w*src[i];
+}
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
-			imgGetPixel3fv(image,x,y,rgb);
-			grey[0]=0.2126f*rgb[0]+0.7152f*rgb[1]+0.0722f*rgb[2];
-			grey[1]=grey[0];
-			grey[2]=grey[0];
-			imgSetPixel3fv(img1,x,y,grey);
+/* Passada horizontal: cada linha de origem gera uma linha de destino */
+static void resizeRows(void *context, int begin, int end)
+{
+	const ResizePass *p = (const ResizePass *)context;
+	const ResizeAxis *axis = p->axis;
+	int x, y, k;
+
+	for (y=begin;y<end;y++) {
+		const float *src = &p->src[3*y*p->srcWidth];
+		float *dst = &p->dst[3*y*p->dstWidth];
+
+		for (x=0;x<p->dstWidth;x++) {
+			const float *w = &axis->weight[x*axis->maxCount];
+			const float *s = &src[3*axis->first[x]];
+			float r=0.f, g=0.f, b=0.f;
+
+			for (k=0;k<axis->count[x];k++,s+=3) {
+				r += w[k]*s[0];
+				g += w[k]*s[1];
+				b += w[k]*s[2];
+			}
+			dst[3*x  ] = r;
+			dst[3*x+1] = g;
+			dst[3*x+2] = b;
 		}
 	}
-
-	return img1;
 }
 
-Image * imgResize(Image * img0, int w1, int h1)
+/* Passada vertical: cada linha de destino e' uma combinacao de linhas de origem */
+static void resizeColumns(void *context, int begin, int end)
 {
-	Image *img1 = imgCreate(w1,h1);
-	int w0, h0;
-	int x0,y0,x1,y1;
-	Color color;
-
-	w0 = imgGetWidth(img0);
-	h0 = imgGetHeight(img0);
+	const ResizePass *p = (const ResizePass *)context;
+	const ResizeAxis *axis = p->axis;
+	int n = 3*p->dstWidth;
+	int y, k, i;
+
+	for (y=begin;y<end;y++) {
+		const float *w = &axis->weight[y*axis->maxCount];
+		float *dst = &p->dst[y*n];
+
+		memset(dst, 0, n*sizeof(float));
+		for (k=0;k<axis->count[y];k++)
+			accumulateRow(dst, &p->src[(axis->first[y]+k)*n], w[k], n);
+
+		/* Lanczos tem lobulos negativos: mantem as cores em [0,1] */
+		for (i=0;i<n;i++)
+			dst[i] = (dst[i] < 0.f) ? 0.f : ((dst[i] > 1.f) ? 1.f : dst[i]);
+	}
+}
 
-	for (y1=0;y1<h1;y1++)
-		for (x1=0;x1<w1;x1++)
-		{
-			x0=ROUND(w0*x1/w1);   /* pega a cor do pixel mais proxima */
-			y0=ROUND(h0*y1/h1);
-			color = imageGetPixel(img0,x0,y0);
-			imageSetPixel(img1,x1,y1,color);
-		}
+/* Tamanho dos cabecalhos BMP (file header + info header) e TGA */
+#define BMP_HEADER_SIZE 54
+#define TGA_HEADER_SIZE 18
 
-		return img1;
-}
+/***************************************************************************
+* Leitura de arquivos BMP e TGA                                            *
+***************************************************************************/
 
-Image * imgAdjust2eN(Image *img0)
+/* Arquivo mapeado em memoria (ou lido inteiro, onde nao ha' mmap) */
+typedef struct {
+	const unsigned char *data;
+	size_t size;
+	int mapped;    /* 1 se data vem de mmap, 0 se de malloc */
+} MappedFile;
+
+/* Parametros da conversao dos pixels de um arquivo (ver decodeRows) */
+typedef struct {
+	Image *img;
+	const unsigned char *pixels;  /* inicio da primeira linha no arquivo */
+	int linesize;                 /* bytes por linha no arquivo */
+	int bytes;                    /* bytes por pixel: 3 (BGR) ou 4 (BGRA) */
+	int topDown;                  /* 1 se a primeira linha do arquivo e' a de cima */
+} DecodePass;
+
+/* Valor em [0,1] de cada nivel de 0 a 255 (preenchida por decodeInit) */
+static float decodeTable[256];
+
+/* Mapeia o arquivo inteiro para leitura. Onde nao ha' mmap (ou se ele
+   falhar) o arquivo e' lido para um buffer. Retorna 0 em caso de erro. */
+static int mapFile(const char *filename, MappedFile *file)
 {
-	Image * img1;
-	int i=0,valid[14]={1,2,4,8,16,32,64,128,512,1024,2048,4096,8192,16384};
-	int w0=img0->width;
-	int h0=img0->height;
-	int w1,h1;
-	int x,y;
-	float rgb[3],black[3]={0.f,0.f,0.f};
-
-	for (i=0;i<14&&valid[i]<w0;i++);
-	w1=valid[i];
+	FILE *filePtr;
+	long size;
+	unsigned char *data;
+
+#ifndef WIN32
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+
+	if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+		void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			close(fd);
+			file->data = (const unsigned char *)map;
+			file->size = (size_t)st.st_size;
+			file->mapped = 1;
+			return 1;
+		}
+	}
+	if (fd >= 0) close(fd);
+#endif
 
-	for (i=0;i<14&&valid[i]<h0;i++);
-	h1=valid[i];
+	filePtr = fopen(filename, "rb");
+	if (!filePtr) {
+		fprintf(stderr, "mapFile: nao foi possivel abrir %s\n", filename);
+		return 0;
+	}
 
-	img1=imgCreate(w1,h1);
+	fseek(filePtr, 0, SEEK_END);
+	size = ftell(filePtr);
+	fseek(filePtr, 0, SEEK_SET);
 
-	for (y=0;y<h1;y++){
-		for (x=0;x<w1;x++) {
-			if (x<w0&&y<h0) {
-				imgGetPixel3fv(img0,x,y,rgb);
-				imgSetPixel3fv(img1,x,y,rgb);
-			}
-			else
-				imgSetPixel3fv(img1,x,y,black);
-		}
+	data = (unsigned char *)malloc(size > 0 ? size : 1);
+	if (size < 0 || fread(data, 1, size, filePtr) != (size_t)size) {
+		fprintf(stderr, "mapFile: erro ao ler %s\n", filename);
+		free(data);
+		fclose(filePtr);
+		return 0;
 	}
+	fclose(filePtr);
 
-	return img1;
+	file->data = data;
+	file->size = (size_t)size;
+	file->mapped = 0;
+	return 1;
 }
 
-int imgGetWidth(Image * image)
+/* Libera um arquivo obtido com mapFile */
+static void unmapFile(MappedFile *file)
 {
-	return image->width;
+#ifndef WIN32
+	if (file->mapped) {
+		munmap((void *)file->data, file->size);
+		return;
+	}
+#endif
+	free((void *)file->data);
 }
 
-int imgGetHeight(Image * image)
+/* Preenche decodeTable, antes das threads de decodeRows */
+static void decodeInit(void)
 {
-	return image->height;
+	int i;
+
+	for (i=0;i<256;i++)
+		decodeTable[i] = (float)(i/255.);
 }
 
-float *imgGetRGBData(Image * image)
+/* Converte as linhas [begin,end) do arquivo de BGR(A) para RGB em [0,1]. Com
+   SSE2 e pixels de 3 bytes, 16 bytes sao convertidos por vez na ordem do
+   arquivo e as componentes B e R sao trocadas depois; o resto usa a tabela
+   decodeTable. */
+static void decodeRows(void *context, int begin, int end)
 {
-	return image->buf;
+	const DecodePass *p = (const DecodePass *)context;
+	int w = p->img->width;
+	int y, x, i;
+
+	for (y=begin;y<end;y++) {
+		int fy = p->topDown ? p->img->height-1-y : y;
+		const unsigned char *src = &p->pixels[(size_t)p->linesize*fy];
+		float *dst = &p->img->buf[3*w*y];
+
+		if (p->bytes == 3) {
+			i = 0;
+#ifdef __SSE2__
+			{
+				__m128i zero = _mm_setzero_si128();
+				__m128 scale = _mm_set1_ps(255.f);
+				for (;i+16<=3*w;i+=16) {
+					__m128i v  = _mm_loadu_si128((const __m128i *)(src+i));
+					__m128i lo = _mm_unpacklo_epi8(v, zero);
+					__m128i hi = _mm_unpackhi_epi8(v, zero);
+					_mm_storeu_ps(dst+i,    _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+					_mm_storeu_ps(dst+i+4,  _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+					_mm_storeu_ps(dst+i+8,  _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+					_mm_storeu_ps(dst+i+12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+				}
+			}
+#endif
+			for (;i<3*w;i++)
+				dst[i] = decodeTable[src[i]];
+
+			/* BGR -> RGB */
+			for (x=0;x<3*w;x+=3) {
+				float b = dst[x];
+				dst[x] = dst[x+2];
+				dst[x+2] = b;
+			}
+		} else {
+			for (x=0;x<w;x++,src+=p->bytes,dst+=3) {
+				dst[0] = decodeTable[src[2]];
+				dst[1] = decodeTable[src[1]];
+				dst[2] = decodeTable[src[0]];
+			}
+		}
+	}
 }
 
-void imgSetPixel3fv(Image * image, int x, int y, float * color)
+/***************************************************************************
+* Codificacao e gravacao de arquivos BMP e TGA                             *
+***************************************************************************/
+
+/* Parametros da conversao da imagem para bytes (ver imgEncode) */
+typedef struct {
+	Image *img;
+	unsigned char *pixels;  /* inicio da linha 0 no arquivo */
+	int linesize;           /* bytes por linha no arquivo */
+} EncodePass;
+
+/* Arquivo BMP ou TGA gravado em faixas de linhas (ver imgStreamOpen) */
+struct ImageStream_imp {
+	FILE *filePtr;
+	int width;
+	int height;
+	int tga;
+	int header;     /* tamanho do cabecalho */
+	int linesize;   /* bytes por linha no arquivo */
+	int ok;         /* 0 depois de algum erro de gravacao */
+};
+
+/* Gravacao pendente de imgWriteAsync */
+typedef struct {
+	char *filename;
+	unsigned char *data;
+	size_t size;
+	int tga;
+	int ok;
+} WriteJob;
+
+static WriteJob writerJob;
+static ParThread *writerThread = NULL;
+static int writerPending = 0;
+
+/* Converte as linhas [begin,end) para bytes BGR: round(255*c), limitado a
+   [0,255]. Com SSE2 sao convertidos 16 componentes por vez. */
+static void encodeRows(void *context, int begin, int end)
 {
-	int pos = (y*image->width*3) + (x*3);
-	image->buf[pos  ] = color[0];
-	image->buf[pos+1] = color[1];
-	image->buf[pos+2] = color[2];
+	const EncodePass *p = (const EncodePass *)context;
+	int n = 3*p->img->width;
+	int y, i;
+
+	for (y=begin;y<end;y++) {
+		const float *src = &p->img->buf[n*y];
+		unsigned char *dst = &p->pixels[p->linesize*y];
+
+		i = 0;
+#ifdef __SSE2__
+		{
+			__m128 scale = _mm_set1_ps(255.f);
+			__m128 half  = _mm_set1_ps(0.5f);
+			__m128 zero  = _mm_setzero_ps();
+			__m128 top   = _mm_set1_ps(255.f);
+			for (;i+16<=n;i+=16) {
+				__m128i a = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src+i),    scale), half), zero), top));
+				__m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src+i+4),  scale), half), zero), top));
+				__m128i c = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src+i+8),  scale), half), zero), top));
+				__m128i d = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src+i+12), scale), half), zero), top));
+				_mm_storeu_si128((__m128i *)(dst+i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+			}
+		}
+#endif
+		for (;i<n;i++) {
+			float v = 255.f*src[i] + 0.5f;
+			dst[i] = (v <= 0.f) ? 0 : ((v >= 255.f) ? 255 : (unsigned char)v);
+		}
+
+		/* RGB -> BGR */
+		for (i=0;i<n;i+=3) {
+			unsigned char r = dst[i];
+			dst[i] = dst[i+2];
+			dst[i+2] = r;
+		}
+	}
 }
 
-void imgGetPixel3fv(Image * image, int x, int y, float *color)
+/* Bytes por linha de pixels num arquivo BMP (tga=0) ou TGA (tga=1); no BMP a
+   linha deve terminar em uma double word boundary */
+static int encodeLinesize(int w, int tga)
 {
-	int pos = (y*image->width*3) + (x*3);
-	color[0] = image->buf[pos  ];
-	color[1] = image->buf[pos+1];
-	color[2] = image->buf[pos+2];
+	return tga ? 3*w : (3*w + 3) & ~3;
 }
 
-void imgSetPixel3ubv(Image * image, int x, int y, unsigned char * color)
+/* Preenche o cabecalho (zerado) de um arquivo BMP ou TGA de w x h pixels e
+   devolve o tamanho do cabecalho */
+static int encodeHeader(unsigned char *data, int w, int h, int tga)
 {
-	int pos = (y*image->width*3) + (x*3);
+	if (tga) {
+		data[2] = 2;                          /* imagem "true color" (RGB) sem compressao */
+		storeuint(data+12, w);                /* largura da imagem em pixels */
+		storeuint(data+14, h);                /* altura da imagem em pixels  */
+		data[16] = 24;                        /* numero de bits de um pixel  */
+		return TGA_HEADER_SIZE;
+	}
 
-	image->buf[pos  ] = (float)(color[0]/255.);
-	image->buf[pos+1] = (float)(color[1]/255.);
-	image->buf[pos+2] = (float)(color[2]/255.);
+	storeuint (data,    19778);           /* type = "BM"                  */
+	storedword(data+2,  (unsigned long)(BMP_HEADER_SIZE + (size_t)encodeLinesize(w,0)*h)); /* bfSize */
+	storedword(data+10, BMP_HEADER_SIZE); /* bfOffBits                    */
+	storedword(data+14, 40);              /* biSize                       */
+	storedword(data+18, w);               /* biWidth                      */
+	storedword(data+22, h);               /* biHeight                     */
+	storeuint (data+26, 1);               /* biPlanes                     */
+	storeuint (data+28, 24);              /* biBitCount                   */
+	return BMP_HEADER_SIZE;
 }
 
-void imgGetPixel3ubv(Image * image, int x, int y, unsigned char *color)
+/* Monta na memoria o arquivo BMP (tga=0) ou TGA (tga=1) da imagem, cabecalho
+   e pixels num unico buffer, que o chamador libera. As linhas sao convertidas
+   em paralelo (ver parFor). */
+static unsigned char *imgEncode(Image *img, int tga, size_t *size)
 {
-	int pos = (y*image->width*3) + (x*3);
-	int r= ROUND(255*image->buf[pos]);
-	int g= ROUND (255*image->buf[pos+1]);
-	int b= ROUND (255*image->buf[pos+2]);
-	color[0] = (unsigned char)(r<256) ? r : 255 ;
-	color[1] = (unsigned char)(g<256) ? g : 255 ;
-	color[2] = (unsigned char)(b<256) ? b : 255 ;
+	EncodePass pass;
+	unsigned char *data;
+	int header = tga ? TGA_HEADER_SIZE : BMP_HEADER_SIZE;
+	double span = trcBegin();
+
+	pass.img = img;
+	pass.linesize = encodeLinesize(img->width, tga);
+	*size = header + (size_t)pass.linesize*img->height;
+
+	data = (unsigned char *)calloc(*size, 1);
+	pass.pixels = data + encodeHeader(data, img->width, img->height, tga);
+
+	parFor(img->height, encodeRows, &pass);
+	trcEnd("image", "imgEncode", span, "%dx%d", img->width, img->height);
+	return data;
 }
 
-void imageSetPixel(Image *image, int x, int y, Color color)
+/* Verifica se o nome do arquivo indica uma imagem TGA (extensao .tga) */
+static int isTGA(const char *filename)
 {
-	int pos = (y*image->width*3) + (x*3);
+	size_t n = strlen(filename);
 
-	image->buf[pos  ] = (float)(color.red);
-	image->buf[pos+1] = (float)(color.green);
-	image->buf[pos+2] = (float)(color.blue);
+	return n >= 4 && (strcmp(filename+n-4, ".tga") == 0 || strcmp(filename+n-4, ".TGA") == 0);
 }
 
-Color imageGetPixel(Image *image, int x, int y)
+/* Posiciona o arquivo no byte offset, que pode passar de 2 GB */
+static int seekFile(FILE *filePtr, size_t offset)
 {
-	Color color;
-	int pos = (y*image->width*3) + (x*3);
+#ifdef WIN32
+	return _fseeki64(filePtr, (__int64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(filePtr, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
 
-	color.red   = (image->buf[pos]);
-	color.green = (image->buf[pos+1]);
-	color.blue  = (image->buf[pos+2]);
+/* Grava o buffer no arquivo com uma unica escrita, sem o buffer do stdio */
+static int writeFile(const char *filename, const unsigned char *data, size_t size)
+{
+	FILE *filePtr = fopen(filename, "wb");
+	double span = trcBegin();
+	int ok;
 
-	return color;
+	if (!filePtr) {
+		fprintf(stderr, "writeFile: nao foi possivel criar %s\n", filename);
+		return 0;
+	}
+
+	setvbuf(filePtr, NULL, _IONBF, 0);
+	ok = fwrite(data, 1, size, filePtr) == size;
+	if (fclose(filePtr) != 0) ok = 0;
+	if (!ok) fprintf(stderr, "writeFile: erro ao gravar %s\n", filename);
+
+	trcEnd("image", "writeFile", span, "%s", filename);
+	return ok;
 }
 
-Image * imageLoad(char *filename) 
+/* Corpo da thread de gravacao de imgWriteAsync */
+static void writerRun(void *context)
 {
-	FILE        *filePtr;
+	WriteJob *job = (WriteJob *)context;
 
-	Image       *image;                /* imagem a ser criada */
-	unsigned char *buffer;             /* buffer para ler o vetor de rgb da imagem  */
+	job->ok = writeFile(job->filename, job->data, job->size);
+	free(job->data);
+	free(job->filename);
+}
+
+/***************************************************************************
+* Convolucao separavel                                                     *
+***************************************************************************/
 
-	unsigned char imageType;           /* 2 para imagens RGB */ 
-	unsigned short int imageWidth;     /* largura da imagem  */
-	unsigned short int imageHeight;    /* altura da imagem   */
-	unsigned char bitCount;            /* numero de bits por pixel */
+/* Numero de linhas de cada faixa processada por uma thread na convolucao */
+#define CONV_BAND 32
+
+/* Parametros de uma convolucao separavel (ver imgConvolve) */
+typedef struct {
+	Image *src;
+	Image *dst;
+	const float *kx;   /* kernel das linhas, 2*rx+1 pesos */
+	int rx;
+	const float *ky;   /* kernel das colunas, 2*ry+1 pesos */
+	int ry;
+} ConvPass;
+
+/* Convolui as faixas [begin,end) de CONV_BAND linhas. Cada linha de origem
+   necessaria (com as ry linhas de borda acima e abaixo da faixa) e' copiada
+   para um buffer com rx pixels de borda repetidos em cada lado; assim as duas
+   passadas sao somas de linhas inteiras deslocadas, sem testes de borda. */
+static void convBands(void *context, int begin, int end)
+{
+	const ConvPass *p = (const ConvPass *)context;
+	int w = p->src->width;
+	int h = p->src->height;
+	int n = 3*w;
+	float *pad = (float *)malloc(3*(w + 2*p->rx)*sizeof(float));
+	float *tmp = (float *)malloc((CONV_BAND + 2*p->ry)*n*sizeof(float));
+	int b, y, k, i;
+
+	for (b=begin;b<end;b++) {
+		int y0 = b*CONV_BAND;
+		int y1 = (y0 + CONV_BAND < h) ? y0 + CONV_BAND : h;
+
+		/* Passada horizontal das linhas y0-ry .. y1-1+ry (bordas repetidas) */
+		for (y=y0-p->ry;y<y1+p->ry;y++) {
+			int sy = (y < 0) ? 0 : ((y >= h) ? h-1 : y);
+			const float *src = &p->src->buf[sy*n];
+			float *row = &tmp[(y - y0 + p->ry)*n];
+
+			for (k=0;k<p->rx;k++) {
+				memcpy(&pad[3*k], src, 3*sizeof(float));
+				memcpy(&pad[3*(p->rx + w + k)], &src[n-3], 3*sizeof(float));
+			}
+			memcpy(&pad[3*p->rx], src, n*sizeof(float));
 
-	int x,y;     /* posicao de um pixel  */
+			memset(row, 0, n*sizeof(float));
+			for (k=0;k<=2*p->rx;k++)
+				accumulateRow(row, &pad[3*k], p->kx[k], n);
+		}
 
-	unsigned char ucharSkip;      /* dado lixo unsigned char */
-	short int     sintSkip;       /* dado lixo short int */
+		/* Passada vertical: cada linha de destino soma 2*ry+1 linhas do buffer */
+		for (y=y0;y<y1;y++) {
+			float *dst = &p->dst->buf[y*n];
 
-	/* abre o arquivo com a imagem TGA */
-	filePtr = fopen(filename, "rb");
-	assert(filePtr);
-
-	/* pula os primeiros dois bytes que devem ter valor zero */
-	ucharSkip = getc(filePtr); /* tamanho do descritor da imagem (0) */
-	if (ucharSkip != 0) printf("erro na leitura de %s: imagem com descritor\n", filename);
-
-	ucharSkip = getc(filePtr); 
-	if (ucharSkip != 0) printf("erro na leitura de %s: imagem com tabela de cores\n", filename);
-
-	/* le o tipo de imagem (que deve ser obrigatoriamente 2).  
-	nao estamos tratando dos outros tipos */
-	imageType=getc(filePtr);
-	assert(imageType == 2);
-
-	/* pula 9 bytes relacionados com a tabela de cores 
-	(que nao existe quando a imagem e' RGB, imageType=2) */
-	getuint((short unsigned int *)&sintSkip,filePtr);
-	getuint((short unsigned int *)&sintSkip,filePtr);
-	ucharSkip = getc(filePtr); 
-
-	/* especificacao da imagem */
-	getuint((short unsigned int *)&sintSkip,filePtr);      /* origem em x (por default = 0) */
-	getuint((short unsigned int *)&sintSkip,filePtr);      /* origem em y (por default = 0) */ 
-	getuint(&imageWidth,filePtr);    /* largura */
-	getuint(&imageHeight,filePtr);   /* altura  */
-
-	/* read image bit depth */
-	bitCount=getc(filePtr);
-	assert(bitCount == 24);  /* colorMode -> 3 = BGR (24 bits) */
-
-	/* read 1 byte of garbage data */
-	ucharSkip = getc(filePtr); 
-
-	/* cria uma instancia do tipo Imagem */
-	image = imgCreate(imageWidth,imageHeight);
-	buffer = (unsigned char *) malloc(3*imageWidth*imageHeight*sizeof(unsigned char));
-	assert(image);
-	assert(buffer);
-
-	/* read in image data */
-	fread(buffer, sizeof(unsigned char), 3*imageWidth*imageHeight, filePtr);
-
-	/* copia e troca as compontes de BGR para RGB */
-	for (y=0;y<imageHeight;y++) {
-		for (x=0;x<imageWidth;x++) {
-			int pos = (y*imageWidth*3) + (x*3);
-			image->buf[pos  ] = (float)(buffer[pos+2]/255.);
-			image->buf[pos+1] = (float)(buffer[pos+1]/255.);
-			image->buf[pos+2] = (float)(buffer[pos  ]/255.);
+			memset(dst, 0, n*sizeof(float));
+			for (k=0;k<=2*p->ry;k++)
+				accumulateRow(dst, &tmp[(y - y0 + k)*n], p->ky[k], n);
+
+			for (i=0;i<n;i++)
+				dst[i] = (dst[i] < 0.f) ? 0.f : ((dst[i] > 1.f) ? 1.f : dst[i]);
 		}
 	}
 
-	free(buffer);
-	fclose(filePtr);
-	return image;
+	free(pad);
+	free(tmp);
 }
 
-int imageWriteTGA(char *filename, Image * image)
-{
-	unsigned char imageType=2;      /* RGB(A) sem compresso */
-	unsigned char bitDepth=24;      /* 24 bits por pixel     */
+/***************************************************************************
+* Conjunto de cores                                                        *
+***************************************************************************/
 
-	FILE          *filePtr;        /* ponteiro do arquivo    */
-	unsigned char * buffer;        /* buffer de bytes        */
-	int  x,y;   
+/* Numero de cores de 24 bits (8 bits por componente) */
+#define COLOR_SET_SIZE (1<<24)
+
+/* Marca o bit b de um conjunto compartilhado entre threads */
+#if defined(_MSC_VER)
+#define COLOR_SET_MARK(set,b) _InterlockedOr((long volatile *)&(set)[(b)>>5], (long)(1u<<((b)&31)))
+#else
+#define COLOR_SET_MARK(set,b) __sync_fetch_and_or(&(set)[(b)>>5], 1u<<((b)&31))
+#endif
+
+/* Parametros da construcao de um conjunto de cores (ver colorSetBuild) */
+typedef struct {
+	Image *img;
+	unsigned int *set;      /* um bit por cor de 24 bits */
+	unsigned int *counts;   /* numero de bits de cada trecho do conjunto */
+	int parts;
+} ColorSetPass;
+
+/* Quantiza um componente de cor em [0,1] para um nivel de 0 a 255 */
+static unsigned char colorLevel(float v)
+{
+	return (v <= 0.f) ? 0 : ((v >= 1.f) ? 255 : (unsigned char)(255.f*v + 0.5f));
+}
 
-	unsigned char byteZero=0;      /* usado para escrever um byte zero no arquivo      */
-	short int     shortZero=0;     /* usado para escrever um short int zero no arquivo */
+/* Marca no conjunto as cores das linhas [begin,end) da imagem. O bit so' e'
+   marcado com uma operacao atomica quando ainda nao esta' marcado, o que e'
+   o caso raro depois das primeiras linhas. */
+static void colorSetMark(void *context, int begin, int end)
+{
+	const ColorSetPass *p = (const ColorSetPass *)context;
+	const float *buf = &p->img->buf[3*p->img->width*begin];
+	int n = p->img->width*(end - begin);
+	int i;
 
-	if (!image) return 0;
+	for (i=0;i<n;i++,buf+=3) {
+		unsigned int b = (colorLevel(buf[0])<<16) | (colorLevel(buf[1])<<8) | colorLevel(buf[2]);
+		if (!(p->set[b>>5] & (1u<<(b&31))))
+			COLOR_SET_MARK(p->set, b);
+	}
+}
 
-	/* cria um arquivo binario novo */
-	filePtr = fopen(filename, "wb");
-	assert(filePtr);
-
-	/* cria o buffer */
-	buffer = (unsigned char *) malloc(3*image->width*image->height*sizeof(unsigned char));
-	assert(buffer);
-
-	/* copia e troca as compontes de BGR para RGB */
-	for (y=0;y<image->height;y++) {
-		for (x=0;x<image->width;x++) {
-			int pos = (y*image->width*3) + (x*3);
-			int r= ROUND (255*image->buf[pos  ]);
-			int g= ROUND (255*image->buf[pos+1]);
-			int b= ROUND (255*image->buf[pos+2]);
-			buffer[pos+2] = (unsigned char)(r<256) ? r : 255 ;
-			buffer[pos+1] = (unsigned char)(g<256) ? g : 255 ;
-			buffer[pos  ] = (unsigned char)(b<256) ? b : 255 ;
+/* Conta os bits dos trechos [begin,end) do conjunto */
+static void colorSetCount(void *context, int begin, int end)
+{
+	const ColorSetPass *p = (const ColorSetPass *)context;
+	int words = COLOR_SET_SIZE/32/p->parts;
+	int k, i;
+
+	for (k=begin;k<end;k++) {
+		const unsigned int *set = &p->set[k*words];
+		unsigned int count = 0;
+
+		for (i=0;i<words;i++) {
+#if defined(__GNUC__)
+			count += __builtin_popcount(set[i]);
+#else
+			unsigned int v = set[i];
+			for (;v;v&=v-1) count++;
+#endif
 		}
+		p->counts[k] = count;
 	}
-
-	/* escreve o cabecalho */
-	putc(byteZero,filePtr);          /* 0, no. de caracteres no campo de id da imagem     */
-	putc(byteZero,filePtr);          /* = 0, imagem nao tem palheta de cores              */
-	putc(imageType,filePtr);         /* = 2 -> imagem "true color" (RGB)                  */
-	putuint(shortZero,filePtr);      /* info sobre a tabela de cores (inexistente)        */
-	putuint(shortZero,filePtr);      /* idem                                              */
-	putc(byteZero,filePtr);          /* idem                                              */
-	putuint(shortZero,filePtr);      /* =0 origem em x                                    */
-	putuint(shortZero,filePtr);      /* =0 origem em y                                    */
-	putuint(image->width,filePtr);   /* largura da imagem em pixels                       */
-	putuint(image->height,filePtr);  /* altura da imagem em pixels                        */
-	putc(bitDepth,filePtr);          /* numero de bits de um pixel                        */
-	putc(byteZero, filePtr);         /* =0 origem no canto inf esquedo sem entrelacamento */
-
-	/* escreve o buf de cores da imagem */
-	fwrite(buffer, sizeof(unsigned char), 3*image->width*image->height, filePtr);
-
-	free(buffer);
-	fclose(filePtr);
-	return 1;
 }
 
-Image * imgReadBMP(char *filename)
+/* Constroi, em paralelo, o conjunto das cores de 24 bits da imagem (um bit
+   por cor, 2 MB) e conta seus elementos. O chamador libera o conjunto. */
+static unsigned int *colorSetBuild(Image *img, unsigned int *numCores)
 {
-	FILE  *filePtr;				/* ponteiro do arquivo */
-	Image *image;				/* imagem a ser criada */
-	BYTE *linedata;
+	ColorSetPass pass;
+	int k;
 
-	USHORT  bfType;             /* "BM" = 19788           */
-	LONG    biWidth;            /* image width in pixels  */
-	LONG    biHeight;           /* image height in pixels */
-	WORD    biBitCount;         /* bitmap color depth     */
-	DWORD   bfSize;
+	pass.img = img;
+	pass.set = (unsigned int *)calloc(COLOR_SET_SIZE/32, sizeof(unsigned int));
+	pass.parts = 256;
+	pass.counts = (unsigned int *)malloc(pass.parts*sizeof(unsigned int));
 
-	USHORT  ushortSkip;			/* dado lixo USHORT */
-	DWORD   dwordSkip;			/* dado lixo DWORD  */
-	LONG    longSkip;			/* dado lixo LONG   */
-	WORD    wordSkip;			/* dado lixo WORD   */
+	parFor(img->height, colorSetMark, &pass);
+	parFor(pass.parts, colorSetCount, &pass);
 
-	LONG i, j, k, l, linesize, got;
+	*numCores = 0;
+	for (k=0;k<pass.parts;k++)
+		*numCores += pass.counts[k];
 
-	/* abre o arquivo com a imagem BMP */
-	filePtr = fopen(filename, "rb");
-	assert(filePtr);
+	free(pass.counts);
+	return pass.set;
+}
 
-	/* verifica se eh uma imagem bmp */
-	getuint(&bfType, filePtr);
-	assert(bfType == 19778);
-
-	/* pula os 12 bytes correspondentes a bfSize, Reserved1 e Reserved2 */
-	getdword(filePtr, &bfSize);
-	getuint(&ushortSkip, filePtr);  /* Reserved1, deve ter valor 0 */
-	assert(ushortSkip == 0);
-	getuint(&ushortSkip, filePtr);  /* Reserved2, deve ter valor 0 */
-	assert(ushortSkip == 0);
-
-	/* pula os 4 bytes correspondentes a bfOffBits, que deve ter valor 54 */
-	getdword(filePtr, &dwordSkip);
-	assert(dwordSkip == 54);
-
-	/* pula os 4 bytes correspondentes a biSize, que deve ter valor 40 */
-	getdword(filePtr, &dwordSkip);
-	assert(dwordSkip == 40);
-
-	/* pega largura e altura da imagem */
-	getlong(filePtr, &biWidth);
-	getlong(filePtr, &biHeight);
-
-	/* verifica que o numero de quadros eh igual a 1 */
-	getword(filePtr, &wordSkip);
-	assert(wordSkip == 1);
-
-	/* Verifica se a imagem eh de 24 bits */
-	getword(filePtr, &biBitCount);
-	if(biBitCount != 24)
-	{
-		fprintf(stderr, "imgReadBMP: Not a bitmap 24 bits file.\n");		
-		fclose(filePtr);
-		return (NULL);
+/***************************************************************************
+* Reducao de cores por corte pela mediana                                  *
+***************************************************************************/
+
+/* Niveis por componente do histograma de cores (5 bits) */
+#define REDUCE_LEVELS 32
+#define REDUCE_BINS   (REDUCE_LEVELS*REDUCE_LEVELS*REDUCE_LEVELS)
+
+/* Celula (r,g,b) do histograma de cores */
+#define REDUCE_BIN(r,g,b) (((r)*REDUCE_LEVELS + (g))*REDUCE_LEVELS + (b))
+
+/* Celula do histograma de cores: numero de pixels e soma das suas cores */
+typedef struct {
+	unsigned int count;
+	double sum[3];
+} ReduceBin;
+
+/* Parametros de uma reducao de cores (ver imgReduceColors) */
+typedef struct {
+	Image *src;
+	Image *dst;
+	int parts;          /* numero de histogramas parciais */
+	ReduceBin *hist;    /* parts histogramas de REDUCE_BINS celulas */
+	colorCube *cubes;
+	Color *pal;         /* paleta, numCores cores */
+	int numCores;
+	Color *map;         /* cor da paleta de cada celula do histograma */
+} ReducePass;
+
+/* Celula do histograma de um pixel */
+static int reduceBin(const float *rgb)
+{
+	return REDUCE_BIN(colorLevel(rgb[0])>>3, colorLevel(rgb[1])>>3, colorLevel(rgb[2])>>3);
+}
+
+/* Preenche os histogramas parciais [begin,end), cada um com um trecho das linhas */
+static void reduceHistogram(void *context, int begin, int end)
+{
+	const ReducePass *p = (const ReducePass *)context;
+	int w = p->src->width;
+	int h = p->src->height;
+	int k, i;
+
+	for (k=begin;k<end;k++) {
+		ReduceBin *hist = &p->hist[k*REDUCE_BINS];
+		int y0 = (int)((long)h*k/p->parts);
+		int y1 = (int)((long)h*(k+1)/p->parts);
+		const float *buf = &p->src->buf[3*w*y0];
+
+		for (i=0;i<w*(y1-y0);i++,buf+=3) {
+			ReduceBin *bin = &hist[reduceBin(buf)];
+			bin->count++;
+			bin->sum[0] += buf[0];
+			bin->sum[1] += buf[1];
+			bin->sum[2] += buf[2];
+		}
 	}
+}
 
-	/* pula os demais bytes do infoheader */
-	getdword(filePtr, &dwordSkip);
-	assert(dwordSkip == 0);
-	getdword(filePtr, &dwordSkip);
-	getlong(filePtr, &longSkip);
-	getlong(filePtr, &longSkip);
-	getdword(filePtr, &dwordSkip);
-	getdword(filePtr, &dwordSkip);
-
-	image = imgCreate(biWidth, biHeight);
-
-	/* a linha deve terminar em uma fronteira de dword */
-	linesize = 3*image->width;
-	if (linesize & 3) {
-		linesize |= 3;
-		linesize++;
-	}
-
-	/* aloca espaco para a area de trabalho */ 
-	linedata = (BYTE *) malloc(linesize);
-	if (linedata == NULL) {
-		fprintf(stderr, "get24bits: Not enough memory.\n");
-		return 0;
-	}
-
-	/* pega as componentes de cada pixel */
-	for (k=0, i=0; i<image->height; i++) {
-		got = (unsigned long int)fread(linedata, linesize, 1, filePtr);
-		if (got != 1) {
-			free(linedata);
-			fprintf(stderr, "get24bits: Unexpected end of file.\n");
-		}
-		for (l=1, j=0; j<image->width; j++, l=l+3) {
-			image->buf[k++] = (float)(linedata[l+1]/255.);
-			image->buf[k++] = (float)(linedata[l  ]/255.); 
-			image->buf[k++] = (float)(linedata[l-1]/255.);
-		}
-	}
-
-	free(linedata);
-	fclose(filePtr);
-	return image;
-}
-
-int imgWriteBMP(char *filename, Image * bmp)
+/* Encolhe o cubo ate' as celulas ocupadas e escolhe a sua maior dimensao */
+static void cuboAjusta(colorCube *cube, const ReduceBin *hist)
 {
-	FILE          *filePtr;		   /* ponteiro do arquivo */
-	unsigned char *filedata;
-	DWORD bfSize;
-	int i, j, k, l;
+	int lo[3], hi[3];
+	int r, g, b, d, ext = -1;
+
+	lo[0] = lo[1] = lo[2] = REDUCE_LEVELS;
+	hi[0] = hi[1] = hi[2] = -1;
+	cube->count = 0;
+
+	for (r=cube->min[0];r<=cube->max[0];r++)
+		for (g=cube->min[1];g<=cube->max[1];g++)
+			for (b=cube->min[2];b<=cube->max[2];b++) {
+				unsigned int n = hist[REDUCE_BIN(r,g,b)].count;
+				if (n == 0) continue;
+				cube->count += n;
+				if (r < lo[0]) lo[0] = r;
+				if (r > hi[0]) hi[0] = r;
+				if (g < lo[1]) lo[1] = g;
+				if (g > hi[1]) hi[1] = g;
+				if (b < lo[2]) lo[2] = b;
+				if (b > hi[2]) hi[2] = b;
+			}
 
-	int linesize, put;
+	for (d=0;d<3;d++) {
+		cube->min[d] = lo[d];
+		cube->max[d] = hi[d];
+		if (hi[d] - lo[d] > ext) {
+			ext = hi[d] - lo[d];
+			cube->maiorDim = d;
+		}
+	}
+}
 
-	if (!bmp) return 0;
+/* Escolhe o cubo a ser cortado: o de maior aresta entre os que tem mais de uma celula */
+static int cuboCorte(const colorCube *cubeVec, int numCubos)
+{
+	int maiorVar = 0;
+	int posCorte = -1;
+	int k;
 
-	/* cria um novo arquivo binario */
-	filePtr = fopen(filename, "wb");
-	assert(filePtr);
+	for (k=0;k<numCubos;k++) {
+		int d = cubeVec[k].maiorDim;
+		int var = cubeVec[k].max[d] - cubeVec[k].min[d];
 
-	/* a linha deve terminar em uma double word boundary */
-	linesize = bmp->width * 3;
-	if (linesize & 3) {
-		linesize |= 3;
-		linesize ++;
+		if (var > maiorVar) {
+			maiorVar = var;
+			posCorte = k;
+		}
 	}
 
-	/* calcula o tamanho do arquivo em bytes */
-	bfSize = 14 +							/* file header size */
-		40 +							/* info header size */
-		bmp->height * linesize;	    /* image data  size */
-
-	/* Preenche o cabealho -> FileHeader e InfoHeader */
-	putuint(19778, filePtr);					/* type = "BM" = 19788								 */
-	putdword(filePtr, bfSize);					/* bfSize -> file size in bytes						 */
-	putuint(0, filePtr);						/* bfReserved1, must be zero						 */
-	putuint(0, filePtr);						/* bfReserved2, must be zero						 */
-	putdword(filePtr, 54);						/* bfOffBits -> offset in bits to data				 */
-
-	putdword(filePtr, 40);						/* biSize -> structure size in bytes				 */
-	putlong(filePtr, bmp->width);				/* biWidth -> image width in pixels					 */			
-	putlong(filePtr, bmp->height);				/* biHeight -> image height in pixels				 */
-	putword(filePtr, 1);						/* biPlanes, must be 1								 */
-	putword(filePtr, 24);						/* biBitCount, 24 para 24 bits -> bitmap color depth */
-	putdword(filePtr, 0);						/* biCompression, compression type -> no compression */
-	putdword(filePtr, 0);						/* biSizeImage, nao eh usado sem compressao			 */
-	putlong(filePtr, 0);						/* biXPelsPerMeter									 */
-	putlong(filePtr, 0);						/* biYPelsPerMeter									 */
-	putdword(filePtr, 0);						/* biClrUsed, numero de cores na palheta			 */
-	putdword(filePtr, 0);						/* biClrImportant, 0 pq todas sao importantes		 */
-
-	/* aloca espacco para a area de trabalho */
-	filedata = (unsigned char *) malloc(linesize);
-	assert(filedata);
-
-	/* a linha deve ser zero padded */
-	for (i=0; i<(linesize-(3*bmp->width)); i++) 
-		filedata[linesize-1-i] = 0;
-	j = 1;
-	for (k=0; k<bmp->height;k++)
-	{
-		l = 1;
-		/* coloca as componentes BGR no buffer */    
-		for (i=0; i<bmp->width; i++) {
-			int b= ROUND (255*bmp->buf[j+1]);
-			int g= ROUND (255*bmp->buf[j  ]);
-			int r= ROUND (255*bmp->buf[j-1]);
-			filedata[l-1] = (unsigned char)(b<256) ? b : 255 ;
-			filedata[l  ] = (unsigned char)(g<256) ? g : 255 ;
-			filedata[l+1] = (unsigned char)(r<256) ? r : 255 ;
-			j+=3; l+=3;
-		}
-
-		/* joga para o arquivo */
-		put = (int)fwrite(filedata, linesize, 1, filePtr);
-		if (put != 1) {
-			fprintf(stderr, "put24bits: Disk full.");
-			free(filedata);
-			return 0;
-		}
-	}
-
-	/* operacao executada com sucesso */
-	fprintf(stdout,"imgWriteBMP: %s successfuly generated\n",filename);
-	free(filedata);
-	fclose(filePtr);
-	return 1;
+	return posCorte;
 }
 
-static int comparaCor(const void * p1, const void * p2)
+/* Divide o cubo na mediana dos pixels ao longo da sua maior dimensao; a metade
+   superior vai para novo. As duas metades ficam com ao menos uma celula. */
+static void cortaCubo(colorCube *cube, colorCube *novo, const ReduceBin *hist)
 {
-	float *c1 = (float *) p1;  /* aponta para o byte red da cor 1 */
-	float *c2 = (float *) p2;  /* aponta para o byte red da cor 2 */
+	unsigned int plane[REDUCE_LEVELS];
+	unsigned int sum = 0;
+	int d = cube->maiorDim;
+	int lo[3], hi[3], idx[3];
+	int corte;
+
+	memset(plane, 0, sizeof(plane));
+	memcpy(lo, cube->min, sizeof(lo));
+	memcpy(hi, cube->max, sizeof(hi));
+
+	/* numero de pixels em cada plano perpendicular a' maior dimensao */
+	for (idx[0]=lo[0];idx[0]<=hi[0];idx[0]++)
+		for (idx[1]=lo[1];idx[1]<=hi[1];idx[1]++)
+			for (idx[2]=lo[2];idx[2]<=hi[2];idx[2]++)
+				plane[idx[d]] += hist[REDUCE_BIN(idx[0],idx[1],idx[2])].count;
+
+	for (corte=lo[d];corte<hi[d]-1;corte++) {
+		sum += plane[corte];
+		if (2*sum >= cube->count) break;
+	}
 
-	/* compara o canal vermelho */
-	if (*c1 < *c2) return -1;
-	if (*c1 > *c2) return  1;
+	*novo = *cube;
+	cube->max[d] = corte;
+	novo->min[d] = corte+1;
+	cuboAjusta(cube, hist);
+	cuboAjusta(novo, hist);
+}
 
-	/* compara  o canal verde, uma vez que o vermelho e' igual */
-	c1++; c2++;
-	if (*c1 < *c2) return -1;
-	if (*c1 > *c2) return  1;
+/* Cor media dos pixels do cubo */
+static Color cuboMedia(const colorCube *cube, const ReduceBin *hist)
+{
+	double sum[3] = { 0, 0, 0 };
+	Color media;
+	int r, g, b;
+
+	for (r=cube->min[0];r<=cube->max[0];r++)
+		for (g=cube->min[1];g<=cube->max[1];g++)
+			for (b=cube->min[2];b<=cube->max[2];b++) {
+				const ReduceBin *bin = &hist[REDUCE_BIN(r,g,b)];
+				sum[0] += bin->sum[0];
+				sum[1] += bin->sum[1];
+				sum[2] += bin->sum[2];
+			}
 
-	/* compara o canal azul, uma vez que o vermelho e o azul sao iguais */
-	c1++; c2++;
-	if (*c1 < *c2) return -1;
-	if (*c1 > *c2) return  1;
+	media.red   = (float)(sum[0]/cube->count);
+	media.green = (float)(sum[1]/cube->count);
+	media.blue  = (float)(sum[2]/cube->count);
+	return media;
+}
 
-	/* sao iguais */
-	return 0;
+/* Preenche a tabela inversa para as celulas com vermelho em [begin,end): cada
+   celula ocupada recebe a cor da paleta mais proxima da media dos seus pixels */
+static void reduceMap(void *context, int begin, int end)
+{
+	const ReducePass *p = (const ReducePass *)context;
+	int b, i;
+
+	for (b=begin*REDUCE_LEVELS*REDUCE_LEVELS;b<end*REDUCE_LEVELS*REDUCE_LEVELS;b++) {
+		const ReduceBin *bin = &p->hist[b];
+		float rgb[3], menor = FLT_MAX;
+		int iMenor = 0;
+
+		if (bin->count == 0) continue;
+		rgb[0] = (float)(bin->sum[0]/bin->count);
+		rgb[1] = (float)(bin->sum[1]/bin->count);
+		rgb[2] = (float)(bin->sum[2]/bin->count);
+
+		for (i=0;i<p->numCores;i++) {
+			float dr = rgb[0] - p->pal[i].red;
+			float dg = rgb[1] - p->pal[i].green;
+			float db = rgb[2] - p->pal[i].blue;
+			float m = dr*dr + dg*dg + db*db;
+
+			if (m < menor) {
+				menor = m;
+				iMenor = i;
+			}
+		}
+		p->map[b] = p->pal[iMenor];
+	}
 }
 
-unsigned int imgCountColors(Image * img)
+/* Troca as cores das linhas [begin,end) pelas da tabela inversa */
+static void reduceApply(void *context, int begin, int end)
 {
-	unsigned int numCor = 1;
-	int w = imgGetWidth(img);
-	int h = imgGetHeight(img);
-	float* buf=imgGetRGBData(img);
-	float *vet=(float*) malloc(3*w*h*sizeof(float));
+	const ReducePass *p = (const ReducePass *)context;
+	int n = 3*p->src->width;
+	const float *src = &p->src->buf[n*begin];
+	float *dst = &p->dst->buf[n*begin];
 	int i;
 
-	/* copia o buffer da imagem no vetor de floats fazendo uma quantizacao para 256 tons de cada componente de cor */
-	for (i=0;i<3*w*h;i++) {
-		float val = (float)(255*buf[i]);
-		vet[i]  = (float)(val<256) ? val : 255;
+	for (i=0;i<n*(end-begin);i+=3) {
+		Color c = p->map[reduceBin(&src[i])];
+		dst[i]   = c.red;
+		dst[i+1] = c.green;
+		dst[i+2] = c.blue;
 	}
+}
 
-	/* ordena o vetor */
-	qsort(vet,w*h,3*sizeof(float),comparaCor);
+/***************************************************************************
+* Filtro de mediana em tempo constante (Perreault e Hebert)                *
+***************************************************************************/
 
-	/* conta o numero de cores diferentes */
-	for (i=3; i<3*w*h; i+=3)
-		if (comparaCor(&vet[i-3],&vet[i])!=0) numCor++;
+/* Numero de linhas de cada faixa processada por uma thread no filtro de mediana */
+#define MEDIAN_BAND 64
+
+/* Maior raio aceito: a janela (2r+1)^2 precisa caber nos contadores de 16 bits */
+#define MEDIAN_MAX_RADIUS 127
+
+/* Parametros de um filtro de mediana (ver imgMedianFilter) */
+typedef struct {
+	unsigned char *levels;  /* imagem de origem quantizada em 256 niveis por componente */
+	Image *dst;
+	int radius;
+} MedianPass;
+
+/* Histogramas de dois niveis de um componente: 16 faixas grossas de 16 niveis
+   finos cada. Os histogramas de coluna sao mantidos para todas as colunas; o
+   da janela so' atualiza os niveis finos de uma faixa quando a mediana cai
+   nela (last guarda a coluna em que cada faixa foi atualizada pela ultima vez). */
+typedef struct {
+	unsigned short *colCoarse;  /* w*16 contadores */
+	unsigned short *colFine;    /* w*256 contadores */
+	unsigned short coarse[16];
+	unsigned short fine[256];
+	int last[16];
+} MedianHist;
+
+/* dst[0..16) += src[0..16) */
+static void histAdd(unsigned short *dst, const unsigned short *src)
+{
+#ifdef __SSE2__
+	__m128i *d = (__m128i *)dst;
+	const __m128i *s = (const __m128i *)src;
+	_mm_storeu_si128(d,   _mm_add_epi16(_mm_loadu_si128(d),   _mm_loadu_si128(s)));
+	_mm_storeu_si128(d+1, _mm_add_epi16(_mm_loadu_si128(d+1), _mm_loadu_si128(s+1)));
+#else
+	int i;
+	for (i=0;i<16;i++) dst[i] += src[i];
+#endif
+}
 
-	free(vet);
-	return numCor;
+/* dst[0..16) -= src[0..16) */
+static void histSub(unsigned short *dst, const unsigned short *src)
+{
+#ifdef __SSE2__
+	__m128i *d = (__m128i *)dst;
+	const __m128i *s = (const __m128i *)src;
+	_mm_storeu_si128(d,   _mm_sub_epi16(_mm_loadu_si128(d),   _mm_loadu_si128(s)));
+	_mm_storeu_si128(d+1, _mm_sub_epi16(_mm_loadu_si128(d+1), _mm_loadu_si128(s+1)));
+#else
+	int i;
+	for (i=0;i<16;i++) dst[i] -= src[i];
+#endif
 }
 
-Image * imgNormalizeColors(Image * img0)
+/* Acrescenta (delta=1) ou retira (delta=-1) a linha y dos histogramas de coluna */
+static void medianColumnsUpdate(MedianHist *hist, const unsigned char *levels, int w, int h, int y, int delta)
 {
-	int w = imgGetWidth(img0);
-	int h = imgGetHeight(img0);
-	Image* img1 = imgCreate(w,h);
-	int x,y;
-	float rgb[3];
+	const unsigned char *row;
+	int x, c;
 
+	y = (y < 0) ? 0 : ((y >= h) ? h-1 : y);
+	row = &levels[3*w*y];
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
-			imgGetPixel3fv(img0,x,y,rgb);
-			imgSetPixel3fv(img1,x,y,rgb);
+	for (x=0;x<w;x++) {
+		for (c=0;c<3;c++) {
+			int v = row[3*x+c];
+			hist[c].colFine[256*x + v] += delta;
+			hist[c].colCoarse[16*x + (v>>4)] += delta;
 		}
 	}
-
-	return img1;
 }
 
-static int comparaR(const void * p1, const void * p2)
+/* Atualiza os niveis finos da faixa b do histograma da janela centrada em x */
+static void medianFineSync(MedianHist *hist, int b, int x, int w, int r)
 {
-	Color *color1 = (Color *) p1;
-	Color *color2 = (Color *) p2;
-
-	Color c1 = *color1;
-	Color c2 = *color2;
-
-	if (c1.red < c2.red) return -1;
-	if (c1.red > c2.red) return  1;
+	unsigned short *fine = &hist->fine[16*b];
+	int k;
 
-	return 0;
+	if (hist->last[b] < 0 || x - hist->last[b] > 2*r+1) {
+		/* Mais barato refazer a soma das 2r+1 colunas da janela */
+		memset(fine, 0, 16*sizeof(unsigned short));
+		for (k=x-r;k<=x+r;k++) {
+			int cx = (k < 0) ? 0 : ((k >= w) ? w-1 : k);
+			histAdd(fine, &hist->colFine[256*cx + 16*b]);
+		}
+	} else {
+		for (k=hist->last[b]+1;k<=x;k++) {
+			int in  = (k+r   >= w) ? w-1 : k+r;
+			int out = (k-r-1 <  0) ? 0   : k-r-1;
+			histAdd(fine, &hist->colFine[256*in  + 16*b]);
+			histSub(fine, &hist->colFine[256*out + 16*b]);
+		}
+	}
+	hist->last[b] = x;
 }
 
-static int comparaG(const void * p1, const void * p2)
+/* Filtra as faixas [begin,end) de MEDIAN_BAND linhas. Cada faixa reconstroi
+   os histogramas de coluna na sua primeira linha e desliza para baixo: por
+   linha, cada coluna perde um pixel e ganha outro; por pixel, a janela perde
+   uma coluna e ganha outra. O custo por pixel nao depende do raio. Os pixels
+   fora da imagem repetem os da borda. */
+static void medianBands(void *context, int begin, int end)
 {
-	Color *color1 = (Color *) p1;
-	Color *color2 = (Color *) p2;
+	const MedianPass *p = (const MedianPass *)context;
+	int w = p->dst->width;
+	int h = p->dst->height;
+	int r = p->radius;
+	int half = (2*r+1)*(2*r+1)/2;
+	MedianHist hist[3];
+	int b, x, y, c, k, i;
+
+	for (c=0;c<3;c++) {
+		hist[c].colCoarse = (unsigned short *)malloc(16*w*sizeof(unsigned short));
+		hist[c].colFine   = (unsigned short *)malloc(256*w*sizeof(unsigned short));
+	}
 
-	Color c1 = *color1;
-	Color c2 = *color2;
+	for (b=begin;b<end;b++) {
+		int y0 = b*MEDIAN_BAND;
+		int y1 = (y0 + MEDIAN_BAND < h) ? y0 + MEDIAN_BAND : h;
 
-	if (c1.green < c2.green) return -1;
-	if (c1.green > c2.green) return  1;
+		for (c=0;c<3;c++) {
+			memset(hist[c].colCoarse, 0, 16*w*sizeof(unsigned short));
+			memset(hist[c].colFine,   0, 256*w*sizeof(unsigned short));
+		}
+		for (y=y0-r;y<=y0+r;y++)
+			medianColumnsUpdate(hist, p->levels, w, h, y, 1);
 
-	return 0;
-}
+		for (y=y0;y<y1;y++) {
+			float *dst = &p->dst->buf[3*w*y];
 
-static int comparaB(const void * p1, const void * p2)
-{
-	Color *color1 = (Color *) p1;
-	Color *color2 = (Color *) p2;
+			if (y > y0) {
+				medianColumnsUpdate(hist, p->levels, w, h, y-r-1, -1);
+				medianColumnsUpdate(hist, p->levels, w, h, y+r, 1);
+			}
 
-	Color c1 = *color1;
-	Color c2 = *color2;
+			for (c=0;c<3;c++) {
+				MedianHist *hc = &hist[c];
 
-	if (c1.blue < c2.blue) return -1;
-	if (c1.blue > c2.blue) return  1;
+				memset(hc->coarse, 0, sizeof(hc->coarse));
+				for (k=-r;k<=r;k++) {
+					int cx = (k < 0) ? 0 : ((k >= w) ? w-1 : k);
+					histAdd(hc->coarse, &hc->colCoarse[16*cx]);
+				}
+				for (i=0;i<16;i++) hc->last[i] = -1;
+
+				for (x=0;x<w;x++) {
+					int sum = 0;
+
+					if (x > 0) {
+						int in  = (x+r   >= w) ? w-1 : x+r;
+						int out = (x-r-1 <  0) ? 0   : x-r-1;
+						histAdd(hc->coarse, &hc->colCoarse[16*in]);
+						histSub(hc->coarse, &hc->colCoarse[16*out]);
+					}
+
+					/* Faixa grossa que contem a mediana, depois o nivel fino */
+					for (k=0;k<15 && sum + hc->coarse[k] <= half;k++)
+						sum += hc->coarse[k];
+					medianFineSync(hc, k, x, w, r);
+					for (i=16*k;i<16*k+15 && sum + hc->fine[i] <= half;i++)
+						sum += hc->fine[i];
+
+					dst[3*x+c] = i/255.f;
+				}
+			}
+		}
+	}
 
-	return 0;
+	for (c=0;c<3;c++) {
+		free(hist[c].colCoarse);
+		free(hist[c].colFine);
+	}
 }
 
-void caixaEnvolvente(colorCube* cube, Color* colorVec)
-{
-	float r,g,b;
-	int i; 
+/************************************************************************/
+/* Definicao das Funcoes Exportadas                                     */
+/************************************************************************/
 
-	/* inicializa com o pior caso */
-	cube->min.red = cube->min.green = cube->min.blue = 1.0; 
-	cube->max.red = cube->max.green = cube->max.blue = 0.0;
+Image * imgCreate(int w, int h)
+{
+	Image * image = (Image*) memAlloc (MEM_FRAMEBUFFER, sizeof(Image));
+	assert(image);
+	image->width  =(unsigned int) w;
+	image->height =(unsigned int) h;
+	image->buf = (float *) memAlloc (MEM_FRAMEBUFFER, w * h * 3*sizeof(float));
+	assert(image->buf);
+	return image;
+}
 
-	/* percorre o cubo ajustando o domnio das cores */
-	for (i=cube->ini;i<=cube->fim;i++){
-		r = colorVec[i].red;
-		if (r > cube->max.red) cube->max.red = r;
-		if (r < cube->min.red) cube->min.red = r;
-		g = colorVec[i].green;
-		if (g > cube->max.green) cube->max.green = g;
-		if (g < cube->min.green) cube->min.green = g;
-		b = colorVec[i].blue;
-		if (b > cube->max.blue) cube->max.blue = b;
-		if (b < cube->min.blue) cube->min.blue = b;
-	}
+void imgDestroy (Image *image)
+{
+   if (image)
+   {
+      if (image->buf) memFree (image->buf);
+      memFree(image);
+   }
 }
 
-Image* bestColor(Image *img0, Color* pal, Image* img1, int pal_size)
+Image * imgCopy(Image * image)
 {
-	int w = imgGetWidth(img0);
-	int h = imgGetHeight(img0);
+	int w = imgGetWidth(image);
+	int h = imgGetHeight(image);
+	Image * img1=imgCreate(w,h);
+	int x,y;
 	float rgb[3];
-	int x,y,i;
 
 	for (y=0;y<h;y++){
-		for (x=0;x<w;x++){
-			int i_menor;
-			float m_menor;
-			float rgb1[3];
-
-			imgGetPixel3fv(img0,x,y,rgb);
-
-			m_menor = FLT_MAX;
-			i_menor = 0;
-
-			for(i=0;i<pal_size;i++)
-			{
-				float dif[3];
-				float m;
-
-				dif[0] = rgb[0] - pal[i].red;
-				dif[1] = rgb[1] - pal[i].green;
-				dif[2] = rgb[2] - pal[i].blue;
-
-				m = (float)((dif[0]*dif[0]) + (dif[1]*dif[1]) + (dif[2]*dif[2]));
+		for (x=0;x<w;x++) {
+			imgGetPixel3fv(image,x,y,rgb);
+			imgSetPixel3fv(img1,x,y,rgb);
+		}
+	}
 
-				if (m < m_menor)
-				{
-					i_menor = i;
-					m_menor = m;
+	return img1;
+}
 
-					rgb1[0]=pal[i_menor].red;
-					rgb1[1]=pal[i_menor].green;
-					rgb1[2]=pal[i_menor].blue;
-				}
-			}
+Image * imgGrey(Image * image)
+{
+	int w = imgGetWidth(image);
+	int h = imgGetHeight(image);
+	Image * img1=imgCreate(w,h);
+	int x,y;
+	float rgb[3],grey[3];
 
-			imgSetPixel3fv(img1,x,y,rgb1);
+	for (y=0;y<h;y++){
+		for (x=0;x<w;x++) {
+			imgGetPixel3fv(image,x,y,rgb);
+			grey[0]=0.2126f*rgb[0]+0.7152f*rgb[1]+0.0722f*rgb[2];
+			grey[1]=grey[0];
+			grey[2]=grey[0];
+			imgSetPixel3fv(img1,x,y,grey);
 		}
 	}
+
 	return img1;
 }
 
-void paleta(Color* pal, colorCube* cubeVec, Color* colorVec, int numCubos)
+Image * imgResize(Image * img0, int w1, int h1)
 {
-	float sumvar[3];
-	int count;
-	int i,j;
+	return imgResizeFiltered(img0, w1, h1, IMG_RESIZE_BILINEAR);
+}
 
-	for(i=0;i<numCubos;i++)
-	{
-		sumvar[0] = sumvar[1] = sumvar[2] = 0.0;
-		count = 0;
+Image * imgResizeFiltered(Image * img0, int w1, int h1, int filter)
+{
+	int w0 = imgGetWidth(img0);
+	int h0 = imgGetHeight(img0);
+	Image *img1 = imgCreate(w1,h1);
+	float *tmp = (float *)malloc(3*w1*h0*sizeof(float));
+	ResizeAxis axisX, axisY;
+	ResizePass pass;
+	double span = trcBegin();
+
+	resizeAxisBuild(&axisX, w0, w1, filter);
+	resizeAxisBuild(&axisY, h0, h1, filter);
+
+	/* Primeiro na horizontal (w0 x h0 -> w1 x h0), depois na vertical */
+	pass.src = img0->buf;
+	pass.dst = tmp;
+	pass.srcWidth = w0;
+	pass.dstWidth = w1;
+	pass.axis = &axisX;
+	parFor(h0, resizeRows, &pass);
+
+	pass.src = tmp;
+	pass.dst = img1->buf;
+	pass.srcWidth = w1;
+	pass.axis = &axisY;
+	parFor(h1, resizeColumns, &pass);
+
+	resizeAxisFree(&axisX);
+	resizeAxisFree(&axisY);
+	free(tmp);
+	trcEnd("image", "imgResize", span, "%dx%d -> %dx%d", w0, h0, w1, h1);
+	return img1;
+}
 
-		for(j=cubeVec[i].ini;j<=cubeVec[i].fim;j++)
-		{
-			sumvar[0] += colorVec[j].red;
-			sumvar[1] += colorVec[j].green;
-			sumvar[2] += colorVec[j].blue;
-			count++;
-		}
+ImageSampler * imgSamplerCreate(Image *img0, int w1, int h1, int filter)
+{
+	ImageSampler *sampler = (ImageSampler *)malloc(sizeof(ImageSampler));
 
-		pal[i].red = sumvar[0]/count;
-		pal[i].green = sumvar[1]/count;
-		pal[i].blue = sumvar[2]/count;
-	}
+	sampler->src = img0;
+	resizeAxisBuild(&sampler->axisX, img0->width, w1, filter);
+	resizeAxisBuild(&sampler->axisY, img0->height, h1, filter);
+	return sampler;
 }
 
-void ordenaMaiorDim(colorCube* cubeVec, Color* colorVec, int i)
+Color imgSamplerGet(ImageSampler *sampler, int x, int y)
 {
-	size_t numElem;
-	size_t tamElem;
-	float var[3];
+	const ResizeAxis *ax = &sampler->axisX;
+	const ResizeAxis *ay = &sampler->axisY;
+	const float *wx = &ax->weight[x*ax->maxCount];
+	const float *wy = &ay->weight[y*ay->maxCount];
+	float rgb[3] = {0.f, 0.f, 0.f};
+	Color color;
+	int j, k;
 
-	numElem = (size_t)(cubeVec[i].fim - cubeVec[i].ini + 1);
-	tamElem = (size_t)(sizeof(Color));
+	/* As mesmas somas, na mesma ordem, de resizeRows e resizeColumns */
+	for (k=0;k<ay->count[y];k++) {
+		const float *s = &sampler->src->buf[3*((ay->first[y]+k)*sampler->src->width + ax->first[x])];
+		float r=0.f, g=0.f, b=0.f;
 
-	var[0] = cubeVec[i].max.red - cubeVec[i].min.red;
-	var[1] = cubeVec[i].max.green - cubeVec[i].min.green;
-	var[2] = cubeVec[i].max.blue - cubeVec[i].min.blue;
+		for (j=0;j<ax->count[x];j++,s+=3) {
+			r += wx[j]*s[0];
+			g += wx[j]*s[1];
+			b += wx[j]*s[2];
+		}
+		rgb[0] += wy[k]*r;
+		rgb[1] += wy[k]*g;
+		rgb[2] += wy[k]*b;
+	}
 
-	/* procura a maior dimensao em um cubo */
-	if((var[0]>=var[1])&&(var[0]>=var[2])) cubeVec[i].maiorDim = 0;
-	else
-		if((var[1]>=var[0])&&(var[1]>=var[2])) cubeVec[i].maiorDim = 1;
-		else
-			if((var[2]>var[0]) && (var[2]>var[1])) cubeVec[i].maiorDim = 2;
+	for (k=0;k<3;k++)
+		rgb[k] = (rgb[k] < 0.f) ? 0.f : ((rgb[k] > 1.f) ? 1.f : rgb[k]);
 
-	/* ordena de acordo com a maior dimensao da caixa */
-	if(cubeVec[i].maiorDim == 0)
-	{
-		qsort(&colorVec[cubeVec[i].ini],numElem,tamElem,comparaR);
-		cubeVec[i].var = var[0];
-	}
-	if(cubeVec[i].maiorDim == 1)
-	{
-		qsort(&colorVec[cubeVec[i].ini],numElem,tamElem,comparaG);
-		cubeVec[i].var = var[1];
-	}
-	if(cubeVec[i].maiorDim == 2)
-	{
-		qsort(&colorVec[cubeVec[i].ini],numElem,tamElem,comparaB);
-		cubeVec[i].var = var[2];
-	}
+	color.red = rgb[0];
+	color.green = rgb[1];
+	color.blue = rgb[2];
+	return color;
 }
 
-void cortaCubo(colorCube* cubeVec, int posCorte, int numCubos)
+void imgSamplerDestroy(ImageSampler *sampler)
 {
-	/* divide o cubo */
-	int ini = cubeVec[posCorte].ini;
-	int fim = cubeVec[posCorte].fim;
+	if (!sampler) return;
 
-	if((fim - ini)%2 != 0) /* numero par de elementos */
-	{
-		cubeVec[numCubos].ini = ini + (fim - ini + 1)/2;
-		cubeVec[numCubos].fim = fim;
-		cubeVec[posCorte].fim = cubeVec[numCubos].ini - 1;
-	}
-	else /* numero impar de elementos */
-	{
-		cubeVec[numCubos].ini = ini + (fim - ini)/2;
-		cubeVec[numCubos].fim = fim;
-		cubeVec[posCorte].fim = cubeVec[numCubos].ini - 1;
-	}
+	resizeAxisFree(&sampler->axisX);
+	resizeAxisFree(&sampler->axisY);
+	free(sampler);
 }
 
-int cuboCorte(colorCube* cubeVec, int numCubos)
+Image * imgAdjust2eN(Image *img0)
 {
-	/* escolhe o cubo a ser cortado */
-	float maiorVar = -1;
-	int posCorte = -1;
-	int k;
-	for(k=0;k<numCubos;k++)
-	{
-		/* cubo com uma unica cor */
-		if((cubeVec[k].max.red == cubeVec[k].min.red)&&(cubeVec[k].max.green == cubeVec[k].min.green)&&(cubeVec[k].max.blue == cubeVec[k].min.blue))
-			continue;
+	Image * img1;
+	int i=0,valid[14]={1,2,4,8,16,32,64,128,512,1024,2048,4096,8192,16384};
+	int w0=img0->width;
+	int h0=img0->height;
+	int w1,h1;
+	int x,y;
+	float rgb[3],black[3]={0.f,0.f,0.f};
 
-		if(cubeVec[k].var>maiorVar)
-		{
-			maiorVar = cubeVec[k].var;
-			posCorte = k;
+	for (i=0;i<14&&valid[i]<w0;i++);
+	w1=valid[i];
+
+	for (i=0;i<14&&valid[i]<h0;i++);
+	h1=valid[i];
+
+	img1=imgCreate(w1,h1);
+
+	for (y=0;y<h1;y++){
+		for (x=0;x<w1;x++) {
+			if (x<w0&&y<h0) {
+				imgGetPixel3fv(img0,x,y,rgb);
+				imgSetPixel3fv(img1,x,y,rgb);
+			}
+			else
+				imgSetPixel3fv(img1,x,y,black);
 		}
 	}
 
-	return posCorte;
+	return img1;
 }
 
-Image* imgReduceColors(Image * img0, int maxCores)
+int imgGetWidth(Image * image)
 {
-	int w = imgGetWidth(img0);
-	int h = imgGetHeight(img0);
-	Image* img1 = imgCreate(w,h);
-
-	int x,y,i,j,numCubos = 0;
-	int posCorte = -1;
-	float rgb[3];
+	return image->width;
+}
 
-	colorCube* cubeVec = (colorCube*)malloc(maxCores*sizeof(colorCube)); /* vetor de cubos */
-	Color* colorVec = (Color*)malloc(w*h*sizeof(Color)); /* vetor  de cores */
-	Color* pal = (Color*)malloc(maxCores*sizeof(Color)); /* paleta de cores */
+int imgGetHeight(Image * image)
+{
+	return image->height;
+}
 
-	/* guarda as cores nos vetores (com repeticao) */
-	i = 0;
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++){
-			imgGetPixel3fv(img0,x,y,rgb);
-			colorVec[i].red = rgb[0];
-			colorVec[i].green = rgb[1];
-			colorVec[i].blue = rgb[2];
-			i++;
-		}
-	}
+float *imgGetRGBData(Image * image)
+{
+	return image->buf;
+}
 
-	/* cria o cubo inicial */
-	cubeVec[0].checked = 0;
-	cubeVec[0].fim = w*h-1;
-	cubeVec[0].ini = 0;
+void imgSetPixel3fv(Image * image, int x, int y, float * color)
+{
+	int pos = (y*image->width*3) + (x*3);
+	image->buf[pos  ] = color[0];
+	image->buf[pos+1] = color[1];
+	image->buf[pos+2] = color[2];
+}
 
-	numCubos = 1;
+void imgGetPixel3fv(Image * image, int x, int y, float *color)
+{
+	int pos = (y*image->width*3) + (x*3);
+	color[0] = image->buf[pos  ];
+	color[1] = image->buf[pos+1];
+	color[2] = image->buf[pos+2];
+}
 
-	for(j=0;j<maxCores-1;j++)
-	{
-		for(i=0;i<numCubos;i++)
-		{
-			if(cubeVec[i].checked) continue;
+void imgSetPixel3ubv(Image * image, int x, int y, unsigned char * color)
+{
+	int pos = (y*image->width*3) + (x*3);
 
-			/* calcula os maximos e os minimos */
-			caixaEnvolvente(&cubeVec[i], colorVec);
+	image->buf[pos  ] = (float)(color[0]/255.);
+	image->buf[pos+1] = (float)(color[1]/255.);
+	image->buf[pos+2] = (float)(color[2]/255.);
+}
 
-			/* ordena de acordo com a maior dimensao */
-			ordenaMaiorDim(cubeVec, colorVec, i);
+void imgGetPixel3ubv(Image * image, int x, int y, unsigned char *color)
+{
+	int pos = (y*image->width*3) + (x*3);
+	int r= ROUND(255*image->buf[pos]);
+	int g= ROUND (255*image->buf[pos+1]);
+	int b= ROUND (255*image->buf[pos+2]);
+	color[0] = (unsigned char)(r<256) ? r : 255 ;
+	color[1] = (unsigned char)(g<256) ? g : 255 ;
+	color[2] = (unsigned char)(b<256) ? b : 255 ;
+}
 
-			cubeVec[i].checked = 1;
-		}
+void imageSetPixel(Image *image, int x, int y, Color color)
+{
+	int pos = (y*image->width*3) + (x*3);
 
-		/* escolhe o cubo a ser cortado */
-		posCorte = cuboCorte(cubeVec, numCubos);
+	image->buf[pos  ] = (float)(color.red);
+	image->buf[pos+1] = (float)(color.green);
+	image->buf[pos+2] = (float)(color.blue);
+}
 
-		if(posCorte == -1) break;
+Color imageGetPixel(Image *image, int x, int y)
+{
+	Color color;
+	int pos = (y*image->width*3) + (x*3);
 
-		/* divide o cubo */
-		cortaCubo(cubeVec, posCorte, numCubos);
+	color.red   = (image->buf[pos]);
+	color.green = (image->buf[pos+1]);
+	color.blue  = (image->buf[pos+2]);
 
-		cubeVec[numCubos].checked = 0;
-		cubeVec[posCorte].checked = 0;
+	return color;
+}
 
-		numCubos++;
+Image * imageLoad(char *filename) 
+{
+	MappedFile file;
+	DecodePass pass;
+	const unsigned char *header;
+	int width, height, depth, descriptor;
+	size_t offset;
+	double span = trcBegin();
+
+	if (!mapFile(filename, &file)) return NULL;
+	header = file.data;
+
+	/* cabecalho de 18 bytes; so' sao aceitas imagens RGB (tipo 2) sem
+	   tabela de cores, de 24 ou 32 bits por pixel */
+	if (file.size < TGA_HEADER_SIZE || header[1] != 0 || header[2] != 2) {
+		fprintf(stderr, "imageLoad: %s nao e' uma imagem TGA RGB sem compressao\n", filename);
+		unmapFile(&file);
+		return NULL;
 	}
 
-	/* cria a paleta de cores */
-	paleta(pal, cubeVec, colorVec, numCubos);
-
-	/* preenche a imagem com as cores da paleta */
-	bestColor(img0,&pal[0],img1,maxCores);
+	width  = fetchuint(header+12);
+	height = fetchuint(header+14);
+	depth  = header[16];
+	descriptor = header[17];
+	offset = TGA_HEADER_SIZE + header[0];   /* pula o campo de id da imagem */
+
+	if ((depth != 24 && depth != 32) || width == 0 || height == 0 ||
+		offset + (size_t)width*height*(depth/8) > file.size) {
+		fprintf(stderr, "imageLoad: cabecalho invalido em %s\n", filename);
+		unmapFile(&file);
+		return NULL;
+	}
 
-	free(colorVec);
-	free(cubeVec);
-	free(pal);
+	pass.img = imgCreate(width, height);
+	pass.pixels = file.data + offset;
+	pass.bytes = depth/8;
+	pass.linesize = width*pass.bytes;
+	pass.topDown = (descriptor & 0x20) != 0;  /* origem no canto superior */
 
-	printf("fim\n");
+	decodeInit();
+	parFor(height, decodeRows, &pass);
 
-	return img1;
+	unmapFile(&file);
+	trcEnd("image", "imageLoad", span, "%s", filename);
+	return pass.img;
 }
 
-void imgSub(Image *img0, Image *img1)
+int imageWriteTGA(char *filename, Image * image)
 {
-	int w = imgGetWidth(img0);
-	int h = imgGetHeight(img0);
-	int x,y;
-	float rgb0[3],rgb1[3];
+	unsigned char *data;
+	size_t size;
+	int ok;
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
-			imgGetPixel3fv(img0,x,y,rgb0);
-			imgGetPixel3fv(img1,x,y,rgb1);
-			rgb0[0]=(rgb1[0]>rgb0[0])? rgb1[0]-rgb0[0] : rgb0[0]-rgb1[0] ;
-			rgb0[1]=(rgb1[1]>rgb0[1])? rgb1[1]-rgb0[1] : rgb0[1]-rgb1[1] ;
-			rgb0[2]=(rgb1[2]>rgb0[2])? rgb1[2]-rgb0[2] : rgb0[2]-rgb1[2] ;
-			imgSetPixel3fv(img0,x,y,rgb0);
-		}
-	}
+	if (!image) return 0;
+
+	data = imgEncode(image, 1, &size);
+	ok = writeFile(filename, data, size);
+	free(data);
+	return ok;
 }
 
-Image * imgGaussFilter(Image * img0)
+Image * imgReadBMP(char *filename)
 {
-	int w = imgGetWidth (img0);
-	int h = imgGetHeight(img0);
-	Image * img1 = imgCreate(w,h);
+	MappedFile file;
+	DecodePass pass;
+	const unsigned char *header;
+	unsigned long int bfOffBits, biSize;
+	long int biWidth, biHeight;
+	double span = trcBegin();
 
-	float rgb00[3], rgb01[3], rgb02[3];
-	float rgb10[3], rgb11[3], rgb12[3];
-	float rgb20[3], rgb21[3], rgb22[3];
-	float rgb[3];
+	if (!mapFile(filename, &file)) return NULL;
+	header = file.data;
 
-	int Gauss[3][3];
+	/* verifica se eh uma imagem bmp */
+	if (file.size < BMP_HEADER_SIZE || fetchuint(header) != 19778) {
+		fprintf(stderr, "imgReadBMP: %s nao e' uma imagem BMP\n", filename);
+		unmapFile(&file);
+		return NULL;
+	}
 
-	int x, y;
+	bfOffBits = fetchdword(header+10);    /* inicio dos pixels */
+	biSize    = fetchdword(header+14);    /* 40 ou mais nas versoes mais novas do infoheader */
+	biWidth   = fetchlong(header+18);
+	biHeight  = fetchlong(header+22);     /* negativa se as linhas vao de cima para baixo */
 
-	/* Filtro Gaussiano */
-	Gauss[0][0] = 1; Gauss[0][1] = 2; Gauss[0][2] = 1;
-	Gauss[1][0] = 2; Gauss[1][1] = 4; Gauss[1][2] = 2;
-	Gauss[2][0] = 1; Gauss[2][1] = 2; Gauss[2][2] = 1;
+	/* Verifica se a imagem eh de 24 bits, de um quadro e sem compressao */
+	if (biSize < 40 || fetchuint(header+26) != 1 || fetchuint(header+28) != 24 || fetchdword(header+30) != 0) {
+		fprintf(stderr, "imgReadBMP: %s nao e' um bitmap de 24 bits sem compressao\n", filename);
+		unmapFile(&file);
+		return NULL;
+	}
+
+	pass.topDown = biHeight < 0;
+	if (biHeight < 0) biHeight = -biHeight;
+	pass.bytes = 3;
+	pass.linesize = (3*biWidth + 3) & ~3;   /* a linha termina em uma fronteira de dword */
+
+	if (biWidth <= 0 || biHeight == 0 || biWidth > 0xFFFFFF || biHeight > 0xFFFFFF ||
+		bfOffBits < 14 + biSize || bfOffBits + (size_t)pass.linesize*biHeight > file.size) {
+		fprintf(stderr, "imgReadBMP: cabecalho invalido em %s\n", filename);
+		unmapFile(&file);
+		return NULL;
+	}
+
+	pass.img = imgCreate(biWidth, biHeight);
+	pass.pixels = file.data + bfOffBits;
+
+	decodeInit();
+	parFor(biHeight, decodeRows, &pass);
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
+	unmapFile(&file);
+	trcEnd("image", "imgReadBMP", span, "%s", filename);
+	return pass.img;
+}
 
-			rgb[0] = rgb[1] = rgb[2] = 0.0f;
+int imgWriteBMP(char *filename, Image * bmp)
+{
+	unsigned char *data;
+	size_t size;
+	int ok;
 
-			imgGetPixel3fv(img0,x,y,rgb11);
-			rgb[0] += rgb11[0];
-			rgb[1] += rgb11[1];
-			rgb[2] += rgb11[2];
+	if (!bmp) return 0;
 
-			if((x-1)>=0 && (y-1)>=0) imgGetPixel3fv(img0,x-1,y-1,rgb00);
-			if((y-1)>=0) imgGetPixel3fv(img0,  x,y-1,rgb01);
-			if((x+1)<w && (y-1)>=0) imgGetPixel3fv(img0,x+1,y-1,rgb02);
-			if((x-1)>=0) imgGetPixel3fv(img0,x-1,  y,rgb10);
-			if((x+1)<w) imgGetPixel3fv(img0,x+1,  y,rgb12);
-			if((x-1)>=0 && (y+1)<h) imgGetPixel3fv(img0,x-1,y+1,rgb20);
-			if((y+1)<h) imgGetPixel3fv(img0,  x,y+1,rgb21);
-			if((x+1)<w && (y+1)<h) imgGetPixel3fv(img0,x+1,y+1,rgb22);
+	data = imgEncode(bmp, 0, &size);
+	ok = writeFile(filename, data, size);
+	free(data);
+
+	/* operacao executada com sucesso */
+	if (ok) fprintf(stdout,"imgWriteBMP: %s successfuly generated\n",filename);
+	return ok;
+}
 
-			/* tratando as bordas */
-			if(((y == 0) && (x == 0))){
+int imgWriteAsync(char *filename, Image * image)
+{
+	size_t n = strlen(filename);
+	int ok;
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb12[0]*Gauss[1][2] + rgb21[0]*Gauss[2][1] + rgb22[0]*Gauss[2][2])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb12[1]*Gauss[1][2] + rgb21[1]*Gauss[2][1] + rgb22[1]*Gauss[2][2])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb12[2]*Gauss[1][2] + rgb21[2]*Gauss[2][1] + rgb22[2]*Gauss[2][2])/16;
-			}
+	if (!image) return 0;
 
-			if(((x == (w-1)) && (y == 0))){
+	/* espera a gravacao anterior: ha' no maximo um arquivo na fila */
+	ok = imgWriteWait();
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb10[0]*Gauss[1][0] + rgb20[0]*Gauss[2][0] + rgb21[0]*Gauss[2][1])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb10[1]*Gauss[1][0] + rgb20[1]*Gauss[2][0] + rgb21[1]*Gauss[2][1])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb10[2]*Gauss[1][0] + rgb20[2]*Gauss[2][0] + rgb21[2]*Gauss[2][1])/16;
-			}
+	writerJob.tga = isTGA(filename);
+	writerJob.filename = (char *)malloc(n+1);
+	strcpy(writerJob.filename, filename);
+	writerJob.data = imgEncode(image, writerJob.tga, &writerJob.size);
+	writerJob.ok = 0;
+	writerThread = parStart(writerRun, &writerJob);
+	writerPending = 1;
 
-			if(((x == (w-1)) && (y == (h-1)))){
-
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb00[0]*Gauss[0][0] + rgb01[0]*Gauss[0][1] + rgb10[0]*Gauss[1][0])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb00[1]*Gauss[0][0] + rgb01[1]*Gauss[0][1] + rgb10[1]*Gauss[1][0])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb00[2]*Gauss[0][0] + rgb01[2]*Gauss[0][1] + rgb10[2]*Gauss[1][0])/16;
-			}
+	return ok;
+}
 
-			if(((y == (h-1)) && (x == 0))){
+int imgWriteWait(void)
+{
+	if (!writerPending) return 1;
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb12[0]*Gauss[1][2] + rgb01[0]*Gauss[0][1] + rgb02[0]*Gauss[0][2])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb12[1]*Gauss[1][2] + rgb01[1]*Gauss[0][1] + rgb02[1]*Gauss[0][2])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb12[2]*Gauss[1][2] + rgb01[2]*Gauss[0][1] + rgb02[2]*Gauss[0][2])/16;
-			}
+	parJoin(writerThread);
+	writerThread = NULL;
+	writerPending = 0;
+	return writerJob.ok;
+}
 
-			if(((x == (w-1)) && (y>0) && (y<(h-1)))){
+ImageStream * imgStreamOpen(char *filename, int width, int height)
+{
+	ImageStream *stream;
+	unsigned char header[BMP_HEADER_SIZE];
+	FILE *filePtr;
+	int tga = isTGA(filename);
+	int size;
+
+	if (width <= 0 || height <= 0 || (tga && (width > 0xFFFF || height > 0xFFFF))) {
+		fprintf(stderr, "imgStreamOpen: dimensoes invalidas para %s\n", filename);
+		return NULL;
+	}
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb00[0]*Gauss[0][0] + rgb01[0]*Gauss[0][1] + rgb10[0]*Gauss[1][0] + rgb21[0]*Gauss[2][1] + rgb20[0]*Gauss[2][0])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb00[1]*Gauss[0][0] + rgb01[1]*Gauss[0][1] + rgb10[1]*Gauss[1][0] + rgb21[1]*Gauss[2][1] + rgb20[1]*Gauss[2][0])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb00[2]*Gauss[0][0] + rgb01[2]*Gauss[0][1] + rgb10[2]*Gauss[1][0] + rgb21[2]*Gauss[2][1] + rgb20[2]*Gauss[2][0])/16;
-			}
+	filePtr = fopen(filename, "wb");
+	if (!filePtr) {
+		fprintf(stderr, "imgStreamOpen: nao foi possivel criar %s\n", filename);
+		return NULL;
+	}
 
-			if(((x == 0) && (y > 0) && (y < (h-1)))){
+	memset(header, 0, sizeof(header));
+	size = encodeHeader(header, width, height, tga);
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb01[0]*Gauss[0][1] + rgb02[0]*Gauss[0][2] + rgb12[0]*Gauss[1][2] + rgb21[0]*Gauss[2][1] + rgb22[0]*Gauss[2][2])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb01[1]*Gauss[0][1] + rgb02[1]*Gauss[0][2] + rgb12[1]*Gauss[1][2] + rgb21[1]*Gauss[2][1] + rgb22[1]*Gauss[2][2])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb01[2]*Gauss[0][1] + rgb02[2]*Gauss[0][2] + rgb12[2]*Gauss[1][2] + rgb21[2]*Gauss[2][1] + rgb22[2]*Gauss[2][2])/16;
-			}
+	stream = (ImageStream *)malloc(sizeof(ImageStream));
+	stream->filePtr = filePtr;
+	stream->width = width;
+	stream->height = height;
+	stream->tga = tga;
+	stream->header = size;
+	stream->linesize = encodeLinesize(width, tga);
 
-			if(((y == 0) && (x > 0) && (x < (w-1)))){
+	/* escreve o cabecalho e o ultimo byte, de modo que o arquivo ja' tenha o
+	   tamanho final e as faixas possam ser gravadas em qualquer ordem */
+	stream->ok = fwrite(header, 1, size, filePtr) == (size_t)size &&
+		seekFile(filePtr, size + (size_t)stream->linesize*height - 1) &&
+		putc(0, filePtr) != EOF;
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb10[0]*Gauss[1][0] + rgb12[0]*Gauss[1][2] + rgb20[0]*Gauss[2][0] + rgb21[0]*Gauss[2][1] + rgb22[0]*Gauss[2][2])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb10[1]*Gauss[1][0] + rgb12[1]*Gauss[1][2] + rgb20[1]*Gauss[2][0] + rgb21[1]*Gauss[2][1] + rgb22[1]*Gauss[2][2])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb10[2]*Gauss[1][0] + rgb12[2]*Gauss[1][2] + rgb20[2]*Gauss[2][0] + rgb21[2]*Gauss[2][1] + rgb22[2]*Gauss[2][2])/16;
-			}
+	return stream;
+}
 
-			if(((y == (h-1)) && (x > 0) && (x < (w-1)))){
+int imgStreamWrite(ImageStream *stream, Image *band, int y0)
+{
+	EncodePass pass;
+	size_t size;
+	int ok;
+
+	if (!stream || !band) return 0;
+	if (band->width != stream->width || y0 < 0 || y0 + band->height > stream->height) {
+		fprintf(stderr, "imgStreamWrite: faixa fora da imagem\n");
+		return 0;
+	}
 
-				rgb[0] = (rgb11[0]*Gauss[1][1] + rgb00[0]*Gauss[0][0] + rgb01[0]*Gauss[0][1] + rgb02[0]*Gauss[0][2] + rgb10[0]*Gauss[1][0] + rgb12[0]*Gauss[1][2])/16;
-				rgb[1] = (rgb11[1]*Gauss[1][1] + rgb00[1]*Gauss[0][0] + rgb01[1]*Gauss[0][1] + rgb02[1]*Gauss[0][2] + rgb10[1]*Gauss[1][0] + rgb12[1]*Gauss[1][2])/16;
-				rgb[2] = (rgb11[2]*Gauss[1][1] + rgb00[2]*Gauss[0][0] + rgb01[2]*Gauss[0][1] + rgb02[2]*Gauss[0][2] + rgb10[2]*Gauss[1][0] + rgb12[2]*Gauss[1][2])/16;
-			}
+	size = (size_t)stream->linesize*band->height;
+	pass.img = band;
+	pass.linesize = stream->linesize;
+	pass.pixels = (unsigned char *)calloc(size, 1);
 
-			/* tratando os pixels centrais */
-			if( ((x!=0) && (y!=0) && (y!=(h-1)) && (x!=(w-1)))){
+	parFor(band->height, encodeRows, &pass);
 
-				rgb[0] = (rgb00[0]*Gauss[0][0] + rgb01[0]*Gauss[0][1] + rgb02[0]*Gauss[0][2] + 
-					rgb10[0]*Gauss[1][0] + rgb11[0]*Gauss[1][1] + rgb12[0]*Gauss[1][2] + 
-					rgb20[0]*Gauss[2][0] + rgb21[0]*Gauss[2][1] + rgb22[0]*Gauss[2][2])/16;
+	/* as linhas do arquivo vao de baixo para cima, como as da imagem */
+	ok = seekFile(stream->filePtr, stream->header + (size_t)stream->linesize*y0) &&
+		fwrite(pass.pixels, 1, size, stream->filePtr) == size;
 
-				rgb[1] = (rgb00[1]*Gauss[0][0] + rgb01[1]*Gauss[0][1] + rgb02[1]*Gauss[0][2] + 
-					rgb10[1]*Gauss[1][0] + rgb11[1]*Gauss[1][1] + rgb12[1]*Gauss[1][2] + 
-					rgb20[1]*Gauss[2][0] + rgb21[1]*Gauss[2][1] + rgb22[1]*Gauss[2][2])/16;
+	free((void *)pass.pixels);
+	if (!ok) stream->ok = 0;
+	return ok;
+}
 
-				rgb[2] = (rgb00[2]*Gauss[0][0] + rgb01[2]*Gauss[0][1] + rgb02[2]*Gauss[0][2] + 
-					rgb10[2]*Gauss[1][0] + rgb11[2]*Gauss[1][1] + rgb12[2]*Gauss[1][2] + 
-					rgb20[2]*Gauss[2][0] + rgb21[2]*Gauss[2][1] + rgb22[2]*Gauss[2][2])/16;
-			}
+int imgStreamClose(ImageStream *stream)
+{
+	int ok;
 
-			if(rgb[0]>1) rgb[0] = 1;
-			if(rgb[1]>1) rgb[1] = 1;
-			if(rgb[2]>1) rgb[2] = 1;
+	if (!stream) return 0;
 
-			imgSetPixel3fv(img1,x,y,rgb);
-		}
-	}
+	ok = stream->ok;
+	if (fclose(stream->filePtr) != 0) ok = 0;
+	free(stream);
 
-	return img1;
+	return ok;
 }
 
-Image * imgLaplcFilter(Image * img)
+unsigned int imgCountColors(Image * img)
 {
-	int w = imgGetWidth (img);
-	int h = imgGetHeight(img);
-	Image * img1 = imgCreate(w,h);
-	Image * img0 = imgCreate(w,h);
-
-	float rgb00[3], rgb01[3], rgb02[3];
-	float rgb10[3], rgb11[3], rgb12[3];
-	float rgb20[3], rgb21[3], rgb22[3];
-	float rgb[3];
+	unsigned int numCor;
+	unsigned int *bits = colorSetBuild(img, &numCor);
 
-	int Laplc[3][3];
+	free(bits);
+	return numCor;
+}
 
+Image * imgNormalizeColors(Image * img0)
+{
+	int w = imgGetWidth(img0);
+	int h = imgGetHeight(img0);
+	Image* img1 = imgCreate(w,h);
 	int x,y;
+	float rgb[3];
 
-	img0 = imgGrey(img);
-
-	/* Filtro Laplaciano */
-	Laplc[0][0] = -1; Laplc[0][1] = -1; Laplc[0][2] = -1;
-	Laplc[1][0] = -1; Laplc[1][1] =  8; Laplc[1][2] = -1;
-	Laplc[2][0] = -1; Laplc[2][1] = -1; Laplc[2][2] = -1;
 
 	for (y=0;y<h;y++){
 		for (x=0;x<w;x++) {
+			imgGetPixel3fv(img0,x,y,rgb);
+			imgSetPixel3fv(img1,x,y,rgb);
+		}
+	}
 
-			rgb[0] = rgb[1] = rgb[2] = 0.0f;
-
-			imgGetPixel3fv(img0,x,y,rgb11);
-			rgb[0] += rgb11[0]*Laplc[1][1];
-			rgb[1] += rgb11[1]*Laplc[1][1];
-			rgb[2] += rgb11[2]*Laplc[1][1];
+	return img1;
+}
 
-			if((y-1)>=0)
-			{
-				imgGetPixel3fv(img0,x,y-1,rgb01);
-				rgb[0] += rgb01[0]*Laplc[0][1];
-				rgb[1] += rgb01[1]*Laplc[0][1];
-				rgb[2] += rgb01[2]*Laplc[0][1];
-			} 
+Image* imgReduceColors(Image * img0, int maxCores)
+{
+	int w = imgGetWidth(img0);
+	int h = imgGetHeight(img0);
+	Image* img1;
+	ReducePass pass;
+	unsigned int numCores;
+	int numCubos, posCorte, i;
+
+	if (maxCores < 1) return NULL;
+
+	/* a imagem ja' tem no maximo maxCores cores: nao ha' o que reduzir */
+	free(colorSetBuild(img0, &numCores));
+	if (numCores <= (unsigned int)maxCores)
+		return imgCopy(img0);
+
+	img1 = imgCreate(w,h);
+	pass.src = img0;
+	pass.dst = img1;
+	pass.parts = parGetThreads();
+	pass.hist = (ReduceBin*)calloc(pass.parts*REDUCE_BINS, sizeof(ReduceBin));
+	pass.cubes = (colorCube*)malloc(maxCores*sizeof(colorCube));
+	pass.pal = (Color*)malloc(maxCores*sizeof(Color));
+	pass.map = (Color*)malloc(REDUCE_BINS*sizeof(Color));
+
+	/* histograma de 5 bits por componente: cada trecho de linhas preenche o
+	   seu, e os trechos sao somados no primeiro */
+	parFor(pass.parts, reduceHistogram, &pass);
+	for (i=1;i<pass.parts;i++) {
+		int b;
+		for (b=0;b<REDUCE_BINS;b++) {
+			ReduceBin *dst = &pass.hist[b];
+			const ReduceBin *src = &pass.hist[i*REDUCE_BINS + b];
+			dst->count += src->count;
+			dst->sum[0] += src->sum[0];
+			dst->sum[1] += src->sum[1];
+			dst->sum[2] += src->sum[2];
+		}
+	}
 
-			if((x-1)>=0)
-			{
-				imgGetPixel3fv(img0,x-1,y,rgb10);
-				rgb[0] += rgb10[0]*Laplc[1][0];
-				rgb[1] += rgb10[1]*Laplc[1][0];
-				rgb[2] += rgb10[2]*Laplc[1][0];
-
-				if((y-1)>=0)
-				{
-					imgGetPixel3fv(img0,x-1,y-1,rgb00);
-					rgb[0] += rgb00[0]*Laplc[0][0];
-					rgb[1] += rgb00[1]*Laplc[0][0];
-					rgb[2] += rgb00[2]*Laplc[0][0];
-				}
+	/* corte pela mediana: comeca com o cubo de todas as cores e divide,
+	   enquanto houver cores na paleta, o cubo com a maior aresta */
+	pass.cubes[0].min[0] = pass.cubes[0].min[1] = pass.cubes[0].min[2] = 0;
+	pass.cubes[0].max[0] = pass.cubes[0].max[1] = pass.cubes[0].max[2] = REDUCE_LEVELS-1;
+	cuboAjusta(&pass.cubes[0], pass.hist);
+	numCubos = 1;
 
-				if((y+1)<h)
-				{
-					imgGetPixel3fv(img0,x-1,y+1,rgb20);
-					rgb[0] += rgb20[0]*Laplc[2][0];
-					rgb[1] += rgb20[1]*Laplc[2][0];
-					rgb[2] += rgb20[2]*Laplc[2][0];
-				}
-			}
+	while (numCubos < maxCores) {
+		posCorte = cuboCorte(pass.cubes, numCubos);
+		if (posCorte == -1) break;
 
-			if((x+1)<w)
-			{
-				imgGetPixel3fv(img0,x+1,y,rgb12);
-				rgb[0] += rgb12[0]*Laplc[1][2];
-				rgb[1] += rgb12[1]*Laplc[1][2];
-				rgb[2] += rgb12[2]*Laplc[1][2];
-
-				if((y-1)>=0)
-				{
-					imgGetPixel3fv(img0,x+1,y-1,rgb02);
-					rgb[0] += rgb02[0]*Laplc[0][2];
-					rgb[1] += rgb02[1]*Laplc[0][2];
-					rgb[2] += rgb02[2]*Laplc[0][2];
-				} 
-
-				if((y+1)<h)
-				{
-					imgGetPixel3fv(img0,x+1,y+1,rgb22);
-					rgb[0] += rgb22[0]*Laplc[2][2];
-					rgb[1] += rgb22[1]*Laplc[2][2];
-					rgb[2] += rgb22[2]*Laplc[2][2];
-				}
-			}
+		cortaCubo(&pass.cubes[posCorte], &pass.cubes[numCubos], pass.hist);
+		numCubos++;
+	}
 
-			if((y+1)<h)
-			{
-				imgGetPixel3fv(img0,x,y+1,rgb21);
-				rgb[0] += rgb21[0]*Laplc[2][1];
-				rgb[1] += rgb21[1]*Laplc[2][1];
-				rgb[2] += rgb21[2]*Laplc[2][1];
-			}
+	/* cria a paleta de cores */
+	for (i=0;i<numCubos;i++)
+		pass.pal[i] = cuboMedia(&pass.cubes[i], pass.hist);
+	pass.numCores = numCubos;
 
-			if(rgb[0]>1) rgb[0] = 1;
-			if(rgb[1]>1) rgb[1] = 1;
-			if(rgb[2]>1) rgb[2] = 1;
+	/* tabela inversa: a cor da paleta mais proxima de cada celula do histograma */
+	parFor(REDUCE_LEVELS, reduceMap, &pass);
 
-			if(rgb[0]<0) rgb[0] = 0;
-			if(rgb[1]<0) rgb[1] = 0;
-			if(rgb[2]<0) rgb[2] = 0;
+	/* preenche a imagem com as cores da paleta */
+	parFor(h, reduceApply, &pass);
 
-			imgSetPixel3fv(img1,x,y,rgb);
-		}
-	}
+	free(pass.hist);
+	free(pass.cubes);
+	free(pass.pal);
+	free(pass.map);
 
 	return img1;
 }
 
-Image * imgEdges(Image * img0)
+void imgSub(Image *img0, Image *img1)
 {
-	int w = imgGetWidth (img0);
+	int w = imgGetWidth(img0);
 	int h = imgGetHeight(img0);
-	Image * imgLoG   = imgCreate(w,h);
-	float rgb1[3];
-	float rgb[3];
-
-	int x, y;
-
-	imgLoG = imgGaussFilter(img0);
-	imgLoG   = imgLaplcFilter(imgLoG);
+	int x,y;
+	float rgb0[3],rgb1[3];
 
 	for (y=0;y<h;y++){
 		for (x=0;x<w;x++) {
-
-			imgGetPixel3fv(imgLoG,x,y,rgb);
-
-			rgb1[0] = 1 - rgb[0];
-			rgb1[1] = 1 - rgb[1];
-			rgb1[2] = 1 - rgb[2];
-
-			imgSetPixel3fv(imgLoG,x,y,rgb1);
+			imgGetPixel3fv(img0,x,y,rgb0);
+			imgGetPixel3fv(img1,x,y,rgb1);
+			rgb0[0]=(rgb1[0]>rgb0[0])? rgb1[0]-rgb0[0] : rgb0[0]-rgb1[0] ;
+			rgb0[1]=(rgb1[1]>rgb0[1])? rgb1[1]-rgb0[1] : rgb0[1]-rgb1[1] ;
+			rgb0[2]=(rgb1[2]>rgb0[2])? rgb1[2]-rgb0[2] : rgb0[2]-rgb1[2] ;
+			imgSetPixel3fv(img0,x,y,rgb0);
 		}
 	}
-
-	return imgLoG;
 }
 
-Image * imgFiltroDeMediana(Image * img0)
+Image * imgConvolve(Image * img0, const float *kx, int rx, const float *ky, int ry)
 {
 	int w = imgGetWidth (img0);
 	int h = imgGetHeight(img0);
 	Image * img1 = imgCreate(w,h);
+	ConvPass pass;
 
-	int x,y,k;
-	int mediana;
+	pass.src = img0;
+	pass.dst = img1;
+	pass.kx = kx;
+	pass.rx = rx;
+	pass.ky = ky;
+	pass.ry = ry;
 
-	float rgb00[3], rgb01[3], rgb02[3];
-	float rgb10[3], rgb11[3], rgb12[3];
-	float rgb20[3], rgb21[3], rgb22[3];
-	float vet0[9], vet1[9], vet2[9];
-	float rgb[3];
+	/* Cada thread processa faixas inteiras de CONV_BAND linhas */
+	parFor((h + CONV_BAND - 1) / CONV_BAND, convBands, &pass);
 
-	for (y=0;y<h;y++){
-		for (x=0;x<w;x++) {
+	return img1;
+}
 
-			k = 0;
+Image * imgGaussFilter(Image * img0)
+{
+	/* Filtro Gaussiano 3x3: [1 2 1]/4 nas linhas e nas colunas */
+	static const float gauss[3] = { 0.25f, 0.5f, 0.25f };
 
-			imgGetPixel3fv(img0,x,y,rgb11);
-			vet0[k] = rgb11[0];
-			vet1[k] = rgb11[1];
-			vet2[k] = rgb11[2];
-			k++;
+	return imgConvolve(img0, gauss, 1, gauss, 1);
+}
 
-			if((y-1)>=0)
-			{
-				imgGetPixel3fv(img0,x,y-1,rgb01);
-				vet0[k] = rgb01[0];
-				vet1[k] = rgb01[1];
-				vet2[k] = rgb01[2];	
-				k++;
-			} 
-
-			if((x-1)>=0)
-			{
-				imgGetPixel3fv(img0,x-1,y,rgb10);
-				vet0[k] = rgb10[0];
-				vet1[k] = rgb10[1];
-				vet2[k] = rgb10[2];
-				k++;
-
-				if((y-1)>=0)
-				{
-					imgGetPixel3fv(img0,x-1,y-1,rgb00);
-					vet0[k] = rgb00[0];
-					vet1[k] = rgb00[1];
-					vet2[k] = rgb00[2];
-					k++;
-				}
+Image * imgLaplcFilter(Image * img)
+{
+	/* Laplaciano 3x3 (8 no centro, -1 nos vizinhos) = 9*(centro - media 3x3);
+	   a media 3x3 e' separavel: [1 1 1]/3 nas linhas e nas colunas */
+	static const float box[3] = { 1.f/3.f, 1.f/3.f, 1.f/3.f };
+	int w = imgGetWidth (img);
+	int h = imgGetHeight(img);
+	Image * img0 = imgGrey(img);
+	Image * img1 = imgConvolve(img0, box, 1, box, 1);
+	int i;
 
-				if((y+1)<h)
-				{
-					imgGetPixel3fv(img0,x-1,y+1,rgb20);
-					vet0[k] = rgb20[0];
-					vet1[k] = rgb20[1];
-					vet2[k] = rgb20[2];
-					k++;
-				}
-			}
+	for (i=0;i<3*w*h;i++) {
+		float v = 9.f*(img0->buf[i] - img1->buf[i]);
+		img1->buf[i] = (v < 0.f) ? 0.f : ((v > 1.f) ? 1.f : v);
+	}
 
-			if((x+1)<w)
-			{
-				imgGetPixel3fv(img0,x+1,y,rgb12);
-				vet0[k] = rgb12[0];
-				vet1[k] = rgb12[1];
-				vet2[k] = rgb12[2];
-				k++;
-
-				if((y-1)>=0)
-				{
-					imgGetPixel3fv(img0,x+1,y-1,rgb02);
-					vet0[k] = rgb02[0];
-					vet1[k] = rgb02[1];
-					vet2[k] = rgb02[2];		
-					k++;
-				} 
-
-				if((y+1)<h)
-				{
-					imgGetPixel3fv(img0,x+1,y+1,rgb22);
-					vet0[k] = rgb22[0];
-					vet1[k] = rgb22[1];
-					vet2[k] = rgb22[2];
-					k++;
-				}
-			}
+	imgDestroy(img0);
+	return img1;
+}
 
-			if((y+1)<h)
-			{
-				imgGetPixel3fv(img0,x,y+1,rgb21);
-				vet0[k] = rgb21[0];
-				vet1[k] = rgb21[1];
-				vet2[k] = rgb21[2];
-				k++;
-			}
+Image * imgEdges(Image * img0)
+{
+	Image * imgGauss = imgGaussFilter(img0);
+	Image * imgLoG   = imgLaplcFilter(imgGauss);
+	int n = 3*imgGetWidth(img0)*imgGetHeight(img0);
+	int i;
 
-			qsort(vet0,k,sizeof(float),comparaCor);
-			qsort(vet1,k,sizeof(float),comparaCor);
-			qsort(vet2,k,sizeof(float),comparaCor);
+	for (i=0;i<n;i++)
+		imgLoG->buf[i] = 1 - imgLoG->buf[i];
 
-			if(k%2==0)mediana = k/2;
-			else mediana = (k+1)/2;
+	imgDestroy(imgGauss);
+	return imgLoG;
+}
 
-			rgb[0] = vet0[mediana];
-			rgb[1] = vet1[mediana];
-			rgb[2] = vet2[mediana];
+Image * imgMedianFilter(Image * img0, int radius)
+{
+	int w = imgGetWidth (img0);
+	int h = imgGetHeight(img0);
+	Image * img1 = imgCreate(w,h);
+	MedianPass pass;
+	int i;
 
-			if(rgb[0]>1) rgb[0] = 1;
-			if(rgb[1]>1) rgb[1] = 1;
-			if(rgb[2]>1) rgb[2] = 1;
+	if (radius < 0) radius = 0;
+	if (radius > MEDIAN_MAX_RADIUS) radius = MEDIAN_MAX_RADIUS;
 
-			imgSetPixel3fv(img1,x,y,rgb);
-		}
+	/* Quantiza a imagem uma unica vez; as threads so' leem os niveis */
+	pass.levels = (unsigned char *)malloc(3*w*h);
+	for (i=0;i<3*w*h;i++) {
+		pass.levels[i] = colorLevel(img0->buf[i]);
 	}
+	pass.dst = img1;
+	pass.radius = radius;
+
+	parFor((h + MEDIAN_BAND - 1) / MEDIAN_BAND, medianBands, &pass);
 
+	free(pass.levels);
 	return img1;
 }
 
+Image * imgFiltroDeMediana(Image * img0)
+{
+	return imgMedianFilter(img0, 1);
+}
+
 Image * imgBinarizacao(Image * img0)
 {
 	int w = imgGetWidth (img0);
@@ -19,6 +19,10 @@
 
 typedef struct Image_imp Image;
 
+typedef struct ImageStream_imp ImageStream;
+
+typedef struct ImageSampler_imp ImageSampler;
+
 /************************************************************************/
 /* Funcoes Exportadas                                                   */
 /************************************************************************/
@@ -59,7 +63,7 @@ Image * imgCopy(Image * image);
 Image * imgGrey(Image * image);
 
 /**
-*	Redimensiona a imagem especificada.
+*	Redimensiona a imagem especificada (filtro bilinear, ver imgResizeFiltered).
 *
 *	@param image Handle para uma imagem.
 *	@param w1 Nova largura da imagem.
@@ -68,6 +72,50 @@ Image * imgGrey(Image * image);
 */
 Image * imgResize(Image *img0, int w1, int h1);
 
+/* Filtros de imgResizeFiltered */
+#define IMG_RESIZE_BOX       0   /* media da area (ao ampliar, pixel mais proximo) */
+#define IMG_RESIZE_BILINEAR  1   /* triangulo (bilinear ao ampliar) */
+#define IMG_RESIZE_LANCZOS   2   /* Lanczos de 3 lobulos */
+
+/**
+*	Redimensiona a imagem especificada com um filtro separavel. Ao reduzir, o
+*	filtro e' alargado pela escala, de modo que cada pixel de destino e' a media
+*	ponderada de toda a area correspondente na origem. As linhas sao processadas
+*	em paralelo (ver parFor).
+*
+*	@param img0 Imagem de origem (nao e' modificada).
+*	@param w1 Nova largura da imagem.
+*	@param h1 Nova altura da imagem.
+*	@param filter IMG_RESIZE_BOX, IMG_RESIZE_BILINEAR ou IMG_RESIZE_LANCZOS.
+*  @return imagem criada.
+*/
+Image * imgResizeFiltered(Image *img0, int w1, int h1, int filter);
+
+/**
+*	Cria um amostrador que calcula sob demanda os pixels de imgResizeFiltered,
+*	sem alocar a imagem redimensionada: guarda so' os pesos dos dois eixos
+*	(memoria proporcional a w1 + h1). Cada pixel e' igual, bit a bit, ao da
+*	imagem que imgResizeFiltered criaria.
+*
+*	@param img0 Imagem de origem; deve existir enquanto o amostrador for usado.
+*	@param w1 Largura da imagem redimensionada.
+*	@param h1 Altura da imagem redimensionada.
+*	@param filter IMG_RESIZE_BOX, IMG_RESIZE_BILINEAR ou IMG_RESIZE_LANCZOS.
+*  @return amostrador criado.
+*/
+ImageSampler * imgSamplerCreate(Image *img0, int w1, int h1, int filter);
+
+/**
+*	Obtem o pixel (x,y) da imagem redimensionada (0 <= x < w1, 0 <= y < h1).
+*/
+Color imgSamplerGet(ImageSampler *sampler, int x, int y);
+
+/**
+*	Destroi um amostrador criado com imgSamplerCreate (a imagem de origem nao
+*	e' destruida). Nao faz nada se sampler for NULL.
+*/
+void imgSamplerDestroy(ImageSampler *sampler);
+
 /**
 *	Ajusta a largura da imagem para uma potencia de 2.
 *
@@ -201,14 +249,67 @@ Image * imgReadBMP (char *filename);
 */
 int imgWriteBMP(char *filename, Image * bmp);
 
+/**
+*	Salva a imagem em formato TGA (nome terminado em .tga) ou BMP numa thread
+*	de gravacao. A imagem e' convertida para bytes antes do retorno e pode ser
+*	modificada ou destruida em seguida; so' a escrita do arquivo fica pendente.
+*	Ha' no maximo uma gravacao pendente: a anterior e' esperada antes.
+*
+*	@param filename Nome do arquivo de imagem.
+*	@param image Handle para uma imagem.
+*
+*	@return resultado da gravacao anterior (ver imgWriteWait).
+*/
+int imgWriteAsync(char *filename, Image * image);
+
+/**
+*	Espera o fim da gravacao pendente de imgWriteAsync, se houver.
+*
+*	@return retorna 1 caso nao haja erros na gravacao.
+*/
+int imgWriteWait(void);
+
+/**
+*	Cria um arquivo TGA (nome terminado em .tga) ou BMP de width x height
+*	pixels para ser gravado em faixas de linhas com imgStreamWrite, sem que a
+*	imagem inteira precise estar na memoria. O arquivo ja' e' criado com o
+*	tamanho final; linhas nao gravadas ficam pretas.
+*
+*	@param filename Nome do arquivo de imagem.
+*	@param width Largura da imagem.
+*	@param height Altura da imagem.
+*
+*	@return Handle do arquivo, ou NULL se nao foi possivel cria-lo.
+*/
+ImageStream * imgStreamOpen(char *filename, int width, int height);
+
+/**
+*	Grava uma faixa de linhas na sua posicao final no arquivo. As faixas podem
+*	ser gravadas em qualquer ordem.
+*
+*	@param stream Handle do arquivo.
+*	@param band Imagem com a faixa, da mesma largura do arquivo.
+*	@param y0 Linha da imagem (0 embaixo) correspondente a' linha 0 da faixa.
+*
+*	@return retorna 1 caso nao haja erros.
+*/
+int imgStreamWrite(ImageStream *stream, Image *band, int y0);
+
+/**
+*	Fecha um arquivo criado com imgStreamOpen.
+*
+*	@return retorna 1 caso nao tenha havido erros em nenhuma das gravacoes.
+*/
+int imgStreamClose(ImageStream *stream);
+
 /*** FUNCOES QUE DEVEM SER IMPLEMENTADAS NO TRABALHO 1 ***/
 
 /**
-*	Conta o numero de cores diferentes na imagem
+*	Conta o numero de cores diferentes na imagem, com os componentes
+*	quantizados em 256 niveis (cores de 24 bits). As linhas sao percorridas
+*	em paralelo (ver parFor), marcando as cores num conjunto de bits.
 *
 *	@param image Handle para uma imagem.
-*	@param w Nova largura da imagem.
-*	@param h Nova altura da imagem.
 */
 unsigned int imgCountColors(Image * image);
 
@@ -223,12 +324,13 @@ unsigned int imgCountColors(Image * image);
 Image * imgNormalizeColors(Image * image);
 
 /**
-*	Reduz o numero de cores distintas
+*	Reduz o numero de cores distintas. Se a imagem ja' tem no maximo maxCores
+*	cores (ver imgCountColors), devolve uma copia dela.
 *
 *	@param image Handle para uma imagem.
-*	@param maxCores numero de cores que a nova imagem deve ter.
+*	@param maxCores numero de cores que a nova imagem deve ter (ao menos 1).
 *
-*  @return Handle para a nova imagem.
+*  @return Handle para a nova imagem, ou NULL se maxCores for menor que 1.
 */
 Image * imgReduceColors(Image * image, int maxCores);
 
@@ -241,7 +343,23 @@ Image * imgReduceColors(Image * image, int maxCores);
 void imgSub(Image *img0, Image *img1);
 
 /**
-*	Passa um filtro gaussiano na imagem.
+*	Convolui a imagem com um kernel separavel: primeiro as linhas com kx, depois
+*	as colunas com ky. Os pixels fora da imagem repetem os da borda e o
+*	resultado e' limitado a [0,1]. A imagem e' processada em faixas de linhas
+*	em paralelo (ver parFor).
+*
+*	@param img0 Imagem de origem (nao e' modificada).
+*	@param kx Pesos do kernel horizontal, 2*rx+1 valores (kx[rx] e' o centro).
+*	@param rx Raio do kernel horizontal.
+*	@param ky Pesos do kernel vertical, 2*ry+1 valores (ky[ry] e' o centro).
+*	@param ry Raio do kernel vertical.
+*
+*	@return imagem filtrada.
+*/
+Image * imgConvolve(Image * img0, const float *kx, int rx, const float *ky, int ry);
+
+/**
+*	Passa um filtro gaussiano 3x3 na imagem (ver imgConvolve).
 *
 *	@param img0 imagem a ser filtrada.
 *
@@ -250,7 +368,7 @@ void imgSub(Image *img0, Image *img1);
 Image * imgGaussFilter(Image * img0);
 
 /**
-*	Passa um filtro laplaciano na imagem.
+*	Passa um filtro laplaciano 3x3 na versao em tons de cinza da imagem.
 *
 *	@param img0 imagem a ser filtrada.
 *
@@ -268,7 +386,7 @@ Image * imgLaplcFilter(Image * img0);
 Image * imgEdges(Image * img0);
 
 /**
-*	Passa um filtro de mediana na imagem.
+*	Passa um filtro de mediana 3x3 na imagem (ver imgMedianFilter).
 *
 *	@param img0 imagem a ser filtrada.
 *
@@ -276,6 +394,20 @@ Image * imgEdges(Image * img0);
 */
 Image * imgFiltroDeMediana(Image * img0);
 
+/**
+*	Passa um filtro de mediana de raio arbitrario na imagem, componente a
+*	componente, com os valores quantizados em 256 niveis. Usa histogramas por
+*	coluna (Perreault e Hebert), de modo que o custo por pixel nao depende do
+*	raio. Os pixels fora da imagem repetem os da borda e a imagem e' processada
+*	em faixas de linhas em paralelo (ver parFor).
+*
+*	@param img0 Imagem de origem (nao e' modificada).
+*	@param radius Raio da janela (2*radius+1)x(2*radius+1), limitado a 127.
+*
+*	@return imagem filtrada.
+*/
+Image * imgMedianFilter(Image * img0, int radius);
+
 /**
 *	transforma a imagem em uma imagem binaria(preta e branca).
 *
@@ -13,6 +13,7 @@
  */
 
 #include "light.h"
+#include "memory.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -36,7 +37,7 @@ struct _Light
 /************************************************************************/
 Light* lightCreate( Vector position, Color color )
 {
-	Light* light = (struct _Light *)malloc( sizeof(struct _Light) );
+	Light* light = (struct _Light *)memAlloc( MEM_SCENE, sizeof(struct _Light) );
 
 	light->position = position;
 	light->color = color;
@@ -56,7 +57,7 @@ Color lightGetColor( Light* light )
 
 void lightDestroy( Light* light )
 {
-	free( light );
+	memFree( light );
 }
 
 void lightSetPosition( Light* light, Vector position )
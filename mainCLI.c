@@ -0,0 +1,368 @@
+/*
+ *	Computacao Grafica - Trabalho de Raytracing
+ *
+ *	@file mainCLI.c Renderizador em linha de comando (sem interface grafica).
+ *
+ *	Uso: rtbatch <cena.rt4> <saida.bmp|saida.tga> [opcoes]
+ *
+ *	Por padrao a imagem e' renderizada em ladrilhos de TILE_SIZE x TILE_SIZE pixels
+ *	distribuidos dinamicamente entre as threads, dos mais caros para os mais
+ *	baratos (ver renRenderScene).
+ *
+ *	Opcoes:
+ *		-depth n       profundidade maxima da arvore de raios
+ *		-contrib c     contribuicao minima de um raio secundario (0 desliga a poda)
+ *		-roulette      usa roleta russa nos raios abaixo da contribuicao minima
+ *		-wavefront     traca os raios em lotes de WAVEFRONT_ROWS linhas, um nivel
+ *		               da arvore de raios por vez (ver rayTraceBatch)
+ *		-ss n          supersampling: n x n raios por pixel, reduzidos com
+ *		               imgResizeFiltered (media da area). Nao pode ser usada com
+ *		               -wavefront
+ *		-threads n     numero de threads dos lacos paralelos (padrao: processadores)
+ *		-median r      pos-processamento: filtro de mediana de raio r para reduzir
+ *		               o ruido da imagem (ver imgMedianFilter)
+ *		-band n        renderiza em faixas de n linhas, gravadas direto no arquivo
+ *		               (ver imgStreamOpen): a memoria usada nao depende da altura
+ *		               da imagem. Nao pode ser usada com -ss, -wavefront ou -median
+ *		-order o       ordem de percurso dos pixels de cada ladrilho: rows, morton,
+ *		               hilbert ou blocks (ver renSetOrder)
+ *		-trace f       grava em f a linha do tempo da execucao (leitura da cena,
+ *		               texturas, renderizacao por ladrilho e gravacao) no formato
+ *		               JSON do chrome://tracing e do Perfetto (ver trcStart)
+ *		-heatmap       diagnostico: grava tambem mapas de calor em falsa cor com os
+ *		               ciclos, raios e testes de intersecao de cada pixel, ao lado
+ *		               da imagem (saida_cycles.bmp, ...; ver renHeatmapWrite).
+ *		               Nao pode ser usada com -ss ou -wavefront
+ *
+ *	As opcoes sobrepoem o comando RAYTREE do arquivo de cena.
+ *
+ *	Ao fim da renderizacao sao impressos os bytes em uso e o pico de cada
+ *	subsistema (ver memGetStats).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "color.h"
+#include "algebra.h"
+#include "raytracing.h"
+#include "texture.h"
+#include "parallel.h"
+#include "render.h"
+#include "trace.h"
+#include "memory.h"
+
+/** Numero de linhas da imagem tracadas por lote no modo wavefront */
+#define WAVEFRONT_ROWS	16
+
+/** Lado dos ladrilhos distribuidos entre as threads */
+#define TILE_SIZE	32
+
+/*- Funcoes auxiliares ------------*/
+
+/* imprime os bytes em uso e o pico de cada subsistema, em KB */
+static void print_memory( void )
+{
+	MemStats stats;
+	int tag;
+
+	for( tag = 0; tag < MEM_TAG_COUNT; ++tag ) {
+		stats = memGetStats( tag );
+		printf( "memoria %-11s atual=%10.1lf KB pico=%10.1lf KB\n", memGetTagName( tag ),
+				stats.current / 1024.0, stats.peak / 1024.0 );
+	}
+
+	stats = memGetTotal();
+	printf( "memoria %-11s atual=%10.1lf KB pico=%10.1lf KB\n", "total",
+			stats.current / 1024.0, stats.peak / 1024.0 );
+}
+
+static void usage( const char* program )
+{
+	fprintf( stderr, "uso: %s <cena.rt4> <saida.bmp|saida.tga> [-depth n] [-contrib c] [-roulette] [-wavefront]"
+			 " [-ss n] [-threads n] [-median r] [-band n]"
+			 " [-order rows|morton|hilbert|blocks] [-heatmap] [-trace f]\n", program );
+}
+
+/* renderiza a imagem em ladrilhos, em paralelo, com o custo estimado por uma passada previa */
+static void render_tiles( Scene* scene, Image* image )
+{
+	renRenderScene( scene, image, TILE_SIZE, NULL, NULL, NULL );
+}
+
+/* renderiza em faixas de rows linhas, gravando cada uma direto no arquivo */
+static int render_bands( Scene* scene, char* filename, int width, int height, int rows )
+{
+	ImageStream* stream = imgStreamOpen( filename, width, height );
+	Image* band = imgCreate( width, ( rows < height ) ? rows : height );
+	RenderTile* tiles;
+	int count, y0;
+	int ok = ( stream != NULL );
+
+	for( y0 = 0; ok && y0 < height; y0 += rows ) {
+		if( height - y0 < rows ) {
+			imgDestroy( band );
+			band = imgCreate( width, height - y0 );
+		}
+
+		count = renCreateTiles( 0, y0, width, imgGetHeight( band ), TILE_SIZE, &tiles );
+		renRenderTiles( scene, band, 0, y0, tiles, count, NULL, NULL );
+		free( tiles );
+
+		ok = imgStreamWrite( stream, band, y0 );
+	}
+
+	imgDestroy( band );
+	return imgStreamClose( stream ) && ok;
+}
+
+/* renderiza com n x n raios por pixel numa imagem n vezes maior e reduz pela media da area */
+static void render_supersampled( Scene* scene, Image* image, int n )
+{
+	Camera* camera = sceGetCamera( scene );
+	Vector eye = camGetEye( camera );
+	int width = imgGetWidth( image );
+	int height = imgGetHeight( image );
+	Image* big = imgCreate( width * n, height * n );
+	Image* small;
+	int x, y;
+
+	/* As amostras ficam centradas no pixel de tela (x,y), que vai de x-0.5 a x+0.5 */
+	for( y = 0; y < height * n; ++y ) {
+		for( x = 0; x < width * n; ++x ) {
+			Vector ray = camGetRay( camera, ( x + 0.5 ) / n - 0.5, ( y + 0.5 ) / n - 0.5 );
+			imageSetPixel( big, x, y, rayTrace( scene, eye, ray, 0 ) );
+		}
+	}
+
+	small = imgResizeFiltered( big, width, height, IMG_RESIZE_BOX );
+	memcpy( imgGetRGBData( image ), imgGetRGBData( small ), 3 * width * height * sizeof(float) );
+
+	imgDestroy( small );
+	imgDestroy( big );
+}
+
+/* renderiza a imagem em lotes de linhas no modo wavefront */
+static void render_wavefront( Scene* scene, Image* image )
+{
+	Camera* camera = sceGetCamera( scene );
+	Vector eye = camGetEye( camera );
+	int width = imgGetWidth( image );
+	int height = imgGetHeight( image );
+	int n = width * WAVEFRONT_ROWS;
+	Vector* eyes = (Vector*)malloc( n * sizeof(Vector) );
+	Vector* rays = (Vector*)malloc( n * sizeof(Vector) );
+	Color* colors = (Color*)malloc( n * sizeof(Color) );
+	int x, y, y0, rows;
+
+	for( y0 = 0; y0 < height; y0 += WAVEFRONT_ROWS ) {
+		rows = ( height - y0 < WAVEFRONT_ROWS ) ? height - y0 : WAVEFRONT_ROWS;
+
+		for( y = 0; y < rows; ++y ) {
+			for( x = 0; x < width; ++x ) {
+				eyes[y*width + x] = eye;
+				rays[y*width + x] = camGetRay( camera, x, y0 + y );
+			}
+		}
+
+		rayTraceBatch( scene, rows * width, eyes, rays, y0, width, colors );
+
+		for( y = 0; y < rows; ++y )
+			for( x = 0; x < width; ++x )
+				imageSetPixel( image, x, y0 + y, colors[y*width + x] );
+	}
+
+	free( eyes );
+	free( rays );
+	free( colors );
+}
+
+/*-------------------------------------------------------------------------*/
+/* Rotina principal.                                                       */
+/*-------------------------------------------------------------------------*/
+int main( int argc, char* argv[] )
+{
+	Scene* scene;
+	Camera* camera;
+	Image* image;
+	RenderHeatmap* heatmap = NULL;
+	RayStats stats;
+	int width, height;
+	int wavefront = 0;
+	int supersample = 1;
+	int median = 0;
+	int bandRows = 0;
+	int diagnostic = 0;
+	char* traceFile = NULL;
+	int ok = 1;
+	int i;
+	double start_time;
+	double duration;
+
+	int maxDepth = -1;
+	double minContribution = -1.0;
+	int roulette = 0;
+
+	if( argc < 3 )
+	{
+		usage( argv[0] );
+		return 1;
+	}
+
+	for( i = 3; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-depth" ) == 0 && i + 1 < argc )
+			maxDepth = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-contrib" ) == 0 && i + 1 < argc )
+			minContribution = atof( argv[++i] );
+		else if( strcmp( argv[i], "-roulette" ) == 0 )
+			roulette = 1;
+		else if( strcmp( argv[i], "-wavefront" ) == 0 )
+			wavefront = 1;
+		else if( strcmp( argv[i], "-ss" ) == 0 && i + 1 < argc )
+			supersample = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc )
+			parSetThreads( atoi( argv[++i] ) );
+		else if( strcmp( argv[i], "-median" ) == 0 && i + 1 < argc )
+			median = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-band" ) == 0 && i + 1 < argc )
+			bandRows = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-order" ) == 0 && i + 1 < argc && renFindOrder( argv[i+1] ) >= 0 )
+			renSetOrder( renFindOrder( argv[++i] ) );
+		else if( strcmp( argv[i], "-heatmap" ) == 0 )
+			diagnostic = 1;
+		else if( strcmp( argv[i], "-trace" ) == 0 && i + 1 < argc )
+			traceFile = argv[++i];
+		else
+		{
+			usage( argv[0] );
+			return 1;
+		}
+	}
+
+	if( supersample > 1 && wavefront )
+	{
+		fprintf( stderr, "%s: -ss nao pode ser usado com -wavefront\n", argv[0] );
+		return 1;
+	}
+
+	if( bandRows > 0 && ( supersample > 1 || wavefront || median > 0 ) )
+	{
+		fprintf( stderr, "%s: -band nao pode ser usado com -ss, -wavefront ou -median\n", argv[0] );
+		return 1;
+	}
+
+	if( diagnostic && ( supersample > 1 || wavefront ) )
+	{
+		fprintf( stderr, "%s: -heatmap nao pode ser usado com -ss ou -wavefront\n", argv[0] );
+		return 1;
+	}
+
+	if( traceFile != NULL )
+		trcStart( traceFile );
+
+	/* Le a cena especificada; as opcoes ausentes vem do comando RAYTREE */
+	scene = sceLoad( argv[1] );
+	if( scene == NULL || sceGetCamera( scene ) == NULL )
+	{
+		fprintf( stderr, "%s: nao foi possivel ler a cena %s\n", argv[0], argv[1] );
+		if( traceFile != NULL && !trcStop() )
+			fprintf( stderr, "%s: nao foi possivel gravar %s\n", argv[0], traceFile );
+		return 1;
+	}
+
+	if( maxDepth < 0 )
+		maxDepth = sceGetMaxDepth( scene );
+	if( minContribution < 0.0 )
+		minContribution = sceGetMinContribution( scene );
+	roulette = roulette || sceGetRoulette( scene );
+
+	sceSetRayTree( scene, maxDepth, minContribution, roulette );
+
+	camera = sceGetCamera( scene );
+	width = camGetScreenWidth( camera );
+	height = camGetScreenHeight( camera );
+	image = ( bandRows > 0 ) ? NULL : imgCreate( width, height );
+
+	if( diagnostic )
+	{
+		heatmap = renHeatmapCreate( width, height );
+		renSetHeatmap( heatmap );
+	}
+
+	rayResetStats();
+	start_time = parGetTime();
+
+	if( bandRows > 0 )
+		ok = render_bands( scene, argv[2], width, height, bandRows );
+	else if( supersample > 1 )
+		render_supersampled( scene, image, supersample );
+	else if( wavefront )
+		render_wavefront( scene, image );
+	else
+		render_tiles( scene, image );
+
+	duration = parGetTime() - start_time;
+	stats = rayGetStats();
+	/* a ordem de percurso so' vale para os ladrilhos (e faixas) de renRenderTiles */
+	printf( "%3dx%3d tempo=%.3lf s raios=%llu podados=%llu testes=%llu raios/s=%.0lf ordem=%s\n",
+			width, height, duration, stats.traced, stats.pruned, stats.tests,
+			( duration > 0.0 ) ? stats.traced / duration : 0.0,
+			( supersample > 1 || wavefront ) ? "-" : renGetOrderName( renGetOrder() ) );
+
+	if( heatmap != NULL )
+	{
+		renSetHeatmap( NULL );
+
+		for( i = 0; i < RENDER_HEAT_COUNT; ++i )
+		{
+			double mean, max;
+
+			renHeatmapGetStats( heatmap, i, &mean, &max );
+			printf( "%-6s por pixel: media=%.1lf max=%.0lf\n", renGetHeatName( i ), mean, max );
+		}
+
+		if( !renHeatmapWrite( heatmap, argv[2] ) )
+			ok = 0;
+		renHeatmapDestroy( heatmap );
+	}
+
+	if( median > 0 )
+	{
+		Image* filtered;
+
+		start_time = parGetTime();
+		filtered = imgMedianFilter( image, median );
+		imgDestroy( image );
+		image = filtered;
+		printf( "mediana r=%d tempo=%.3lf s\n", median, parGetTime() - start_time );
+	}
+
+	print_memory();
+
+	/* a gravacao do arquivo prossegue enquanto a cena e' destruida */
+	if( image != NULL )
+	{
+		imgWriteAsync( argv[2], image );
+		imgDestroy( image );
+	}
+
+	sceDestroy( scene );
+	texFlushCache();
+
+	if( !imgWriteWait() || !ok )
+	{
+		fprintf( stderr, "%s: nao foi possivel gravar %s\n", argv[0], argv[2] );
+		ok = 0;
+	}
+
+	/* a linha do tempo e' gravada mesmo que a imagem nao tenha sido */
+	if( traceFile != NULL && !trcStop() )
+	{
+		fprintf( stderr, "%s: nao foi possivel gravar %s\n", argv[0], traceFile );
+		ok = 0;
+	}
+	return ok ? 0 : 1;
+}
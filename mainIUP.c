@@ -18,6 +18,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 /*- Inclusao das bibliotecas IUP e CD: ------------------------------------*/
@@ -36,15 +38,22 @@
 #include "color.h"
 #include "algebra.h"
 #include "raytracing.h"
+#include "render.h"
 
 /* -- implemented in "iconlib.c" to load standard icon images into IUP */
 void IconLibOpen(void);
 
+/* lado dos ladrilhos calculados a cada chamada de idle_cb */
+#define IDLE_TILE 16
+
 /*- Contexto do Programa: -------------------------------------------------*/
 Scene* scene;         /* cena corrente */
-int yc=0;            /* y corrente para Ray Tracing incremetnal */
+RenderTile *tiles=NULL; /* ladrilhos da imagem, em ordem de linhas */
+int tileCount=0;     /* numero de ladrilhos */
+int tc=0;            /* ladrilho corrente para Ray Tracing incremental */
 int width,height=-1; /* alrgura e altura corrente */
 Image *image;        /* imagem que armazena o resultado at agora do algoritmo */
+unsigned char *pixels=NULL; /* cpia de 8 bits (RGB) de image, enviada ao OpenGL com glDrawPixels */
 Vector eye;
 Camera* camera;
 
@@ -75,6 +84,36 @@ static char * get_file_name( void )
 }
 
 
+/* guarda na cpia de 8 bits a cor de um pixel j calculado */
+static void display_set_pixel( int x, int y, Color color )
+{
+	unsigned char* p = &pixels[3*(y*width + x)];
+	float c[3];
+	int i;
+
+	c[0] = color.red; c[1] = color.green; c[2] = color.blue;
+	for( i = 0; i < 3; ++i )
+		p[i] = ( c[i] <= 0.0f ) ? 0 : ( ( c[i] >= 1.0f ) ? 255 : (unsigned char)( 255.0f*c[i] + 0.5f ) );
+}
+
+/* desenha o retngulo [x0,x0+w)x[y0,y0+h) da imagem com uma nica chamada a glDrawPixels */
+static void display_draw( int x0, int y0, int w, int h )
+{
+	if( pixels == NULL || w <= 0 || h <= 0 ) return;
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, width );
+	glPixelStorei( GL_UNPACK_SKIP_PIXELS, x0 );
+	glPixelStorei( GL_UNPACK_SKIP_ROWS, y0 );
+	glRasterPos2i( x0, y0 );
+	glDrawPixels( w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels );
+
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
+	glPixelStorei( GL_UNPACK_SKIP_ROWS, 0 );
+}
+
+
 /*------------------------------------------*/
 /* Callbacks do IUP.                        */
 /*------------------------------------------*/
@@ -107,36 +146,12 @@ int resize_cb(Ihandle *self, int width, int height)
 /* - Callback de repaint do canvas  */
 int repaint_cb(Ihandle *self)
 {
-	int w,h;
-	int x,y;
-	Color rgb;
-
 	IupGLMakeCurrent(self);
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-	glFlush();
 
-	printf("cp:0\n");
-	if (yc!=height) { /* esta callback so'desenha depois que o algoritmo termina a imagem */
-		return IUP_DEFAULT; 
-	}
-
-	printf("cp:1\n");
-	w = imgGetWidth(image);
-	h = imgGetHeight(image);
-	IupGLMakeCurrent(self);
-	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	glBegin(GL_POINTS);
-	for (y=0;y<h;y++) {
-		for (x=0; x<w; x++) {
-			rgb = imageGetPixel(image, x, y);
-			glColor3f((float)rgb.red,(float)rgb.green,(float)rgb.blue);
-			glVertex2i(x,y);
-		}
-	}
-	glEnd();
+	/* desenha a imagem inteira: os pixels ainda no calculados so pretos, como o fundo */
+	display_draw(0, 0, width, height);
 
 	IupGLSwapBuffers(self);
 	return IUP_DEFAULT; /* retorna o controle para o gerenciador de eventos */
@@ -168,30 +183,35 @@ int save_cb(Ihandle *self)
 	return IUP_DEFAULT;
 }
 
-/* calcula uma linha da imagem a cada camada de idle */
+/* calcula um ladrilho da imagem a cada camada de idle */
 int idle_cb(void)
 {
-	int x;
-
-	/* Faz uma linha de pixels por vez */
-	if (yc<height) {
-		IupGLMakeCurrent(canvas);
-		glBegin(GL_POINTS);
-		for( x = 0; x < width; ++x ) {
+	/* Faz um ladrilho de pixels por vez, na ordem de percurso de renGetOrder */
+	if (tc<tileCount) {
+		RenderTile* tile = &tiles[tc];
+		int* order;
+		int i, x, y;
+
+		renCreateOrder( tile->width, tile->height, renGetOrder(), &order );
+		for( i = 0; i < tile->width*tile->height; ++i ) {
 			Color pixel;
-			Vector ray;				
-
-			ray = camGetRay( camera, x, yc );
-			pixel = rayTrace( scene, eye, ray, 0 );
 
-			imageSetPixel( image, x, yc, pixel );
-			glColor3f((float)pixel.red,(float)pixel.green,(float)pixel.blue);
-			glVertex2i(x,yc);
+			x = tile->x + order[i] % tile->width;
+			y = tile->y + order[i] / tile->width;
+			pixel = rayTracePixel( scene, x, y );
 
+			imageSetPixel( image, x, y, pixel );
+			display_set_pixel( x, y, pixel );
 		}
-		glEnd();
+		free( order );
+
+		/* s o ladrilho novo  enviado ao OpenGL, direto no buffer visvel */
+		IupGLMakeCurrent(canvas);
+		glDrawBuffer(GL_FRONT);
+		display_draw(tile->x, tile->y, tile->width, tile->height);
 		glFlush();
-		yc++;
+		glDrawBuffer(GL_BACK);
+		tc++;
 	}
 	else {
 		IupSetFunction (IUP_IDLE_ACTION, (Icallback) NULL); /* a imagem ja' esta' completa */
@@ -209,21 +229,30 @@ int idle_cb(void)
 int load_cb(void) {
 	char* filename = get_file_name();  /* chama o dialogo de abertura de arquivo */
 	char buffer[30];
+	Scene* newScene;
 
 	if (filename==NULL) return 0;
 
-	/* Le a cena especificada */
-	scene = sceLoad( filename );
-	if( scene == NULL ) return IUP_DEFAULT;
+	/* Le a cena especificada (texturas ja' lidas vem do cache de texturas) */
+	newScene = sceLoad( filename );
+	if( newScene == NULL ) return IUP_DEFAULT;
+
+	/* So' depois descarta a cena anterior */
+	if (scene) sceDestroy(scene);
+	scene = newScene;
 
 	camera = sceGetCamera( scene );
 	eye = camGetEye( camera );
 	width = camGetScreenWidth( camera );
 	height = camGetScreenHeight( camera );
-	yc=0;
+	free(tiles);
+	tileCount = renCreateTiles( 0, 0, width, height, IDLE_TILE, &tiles );
+	tc=0;
 
 	if (image) imgDestroy(image);
 	image = imgCreate( width, height );
+	free(pixels);
+	pixels = (unsigned char*)calloc( 3*width*height, 1 );
 	IupSetfAttribute(label, "TITLE", "%3dx%3d", width, height);
 	sprintf(buffer,"%3dx%3d", width, height);
 	IupSetAttribute(canvas,IUP_RASTERSIZE,buffer);
@@ -305,8 +334,16 @@ int init(void)
 /*-------------------------------------------------------------------------*/
 int main(int argc, char* argv[])
 {
+	int i;
+
 	IupOpen(&argc,&argv);
 	IupGLCanvasOpen();
+
+	/* -order rows|morton|hilbert|blocks: ordem de percurso dos pixels (ver renSetOrder) */
+	for( i = 1; i + 1 < argc; ++i )
+		if( strcmp( argv[i], "-order" ) == 0 && renFindOrder( argv[i+1] ) >= 0 )
+			renSetOrder( renFindOrder( argv[i+1] ) );
+
 	if ( init() )
 		IupMainLoop();
 	IupClose();
@@ -0,0 +1,629 @@
+/*
+ *	Computacao Grafica - Trabalho de Raytracing
+ *
+ *	@file mainNode.c Renderizacao distribuida: um coordenador reparte os
+ *	ladrilhos da imagem entre processos trabalhadores, locais ou em outras
+ *	maquinas, conectados por TCP (so' em sistemas POSIX).
+ *
+ *	Uso:
+ *		rtnode -worker <porta> [-threads n]
+ *		rtnode <cena.rt4> <saida.bmp|saida.tga> <host:porta>... [-depth n]
+ *		       [-contrib c] [-roulette] [-tile n]
+ *
+ *	O trabalhador atende cada coordenador num processo proprio. O coordenador le
+ *	a cena uma vez, envia a cada trabalhador o rt4 e os arquivos de imagem que
+ *	ela usa (ver sceGetFileName) e distribui os ladrilhos sob demanda: cada
+ *	trabalhador tem ate' PIPELINE ladrilhos pendentes e recebe outro a cada um
+ *	que devolve. Quando nao ha' mais ladrilhos a distribuir, um trabalhador
+ *	ocioso rouba um ladrilho ainda pendente em outro, e vale o resultado que
+ *	chegar primeiro: um trabalhador lento (ou que caiu) nao atrasa o fim. Os
+ *	ladrilhos de um trabalhador que desconecta voltam para a fila.
+ *
+ *	Protocolo (linhas de texto; os pixels seguem a linha PIXELS em binario):
+ *		coordenador -> trabalhador
+ *			FILE <bytes> <nome>          seguido do conteudo do arquivo
+ *			LOAD <nome> <depth> <contrib> <roulette>
+ *			TILE <id> <x> <y> <w> <h>
+ *			END
+ *		trabalhador -> coordenador
+ *			READY <largura> <altura>     ou ERROR <mensagem>
+ *			PIXELS <id>                  seguido de w*h*3 floats RGB, linha y primeiro
+ *
+ *	Os floats vao na representacao da maquina: coordenador e trabalhadores
+ *	devem ter a mesma ordem de bytes.
+ *
+ *	Os nomes dos arquivos de imagem sao os do rt4, relativos ao diretorio
+ *	corrente do coordenador; o trabalhador os recria num diretorio temporario.
+ */
+
+/* nftw e mkdtemp */
+#define _XOPEN_SOURCE	700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <ftw.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include "image.h"
+#include "scene.h"
+#include "raytracing.h"
+#include "texture.h"
+#include "parallel.h"
+#include "render.h"
+#include "network.h"
+
+/** Numero maximo de trabalhadores de um coordenador */
+#define MAX_WORKERS	64
+
+/** Ladrilhos pendentes por trabalhador: um sendo renderizado e outro na fila */
+#define PIPELINE	2
+
+/** Numero maximo de trabalhadores com o mesmo ladrilho pendente (o original e um roubo) */
+#define MAX_COPIES	2
+
+/** Lado padrao dos ladrilhos distribuidos */
+#define TILE_SIZE	64
+
+/** Lado dos ladrilhos em que o trabalhador divide cada um entre suas threads */
+#define SUBTILE_SIZE	16
+
+/** Nome com que o rt4 e' enviado aos trabalhadores */
+#define SCENE_NAME	"scene.rt4"
+
+/*- Tipos ------------*/
+
+/* trabalhador, visto pelo coordenador */
+typedef struct
+{
+	const char* address;
+	int socket;
+	NetReader* reader;
+	int alive;
+	int pending[PIPELINE];
+	int pendingCount;
+	int rendered;
+} Worker;
+
+/* ladrilho, visto pelo coordenador */
+typedef struct
+{
+	RenderTile tile;
+	/* numero de trabalhadores com o ladrilho pendente */
+	int copies;
+	int done;
+} TileState;
+
+/*- Funcoes auxiliares ------------*/
+
+static void usage( const char* program )
+{
+	fprintf( stderr, "uso: %s -worker <porta> [-threads n]\n"
+			 "     %s <cena.rt4> <saida.bmp|saida.tga> <host:porta>... [-depth n] [-contrib c]"
+			 " [-roulette] [-tile n]\n", program, program );
+}
+
+/* le um arquivo inteiro; retorna NULL em caso de erro */
+static char* read_file( const char* filename, long* size )
+{
+	FILE* file = fopen( filename, "rb" );
+	char* data;
+
+	if( file == NULL )
+		return NULL;
+
+	fseek( file, 0, SEEK_END );
+	*size = ftell( file );
+	fseek( file, 0, SEEK_SET );
+
+	data = (char*)malloc( *size > 0 ? *size : 1 );
+	if( fread( data, 1, *size, file ) != (size_t)*size ) {
+		free( data );
+		data = NULL;
+	}
+
+	fclose( file );
+	return data;
+}
+
+/* remove um arquivo ou diretorio, para nftw */
+static int remove_entry( const char* path, const struct stat* info, int type, struct FTW* ftw )
+{
+	(void)info;
+	(void)type;
+	(void)ftw;
+	return remove( path );
+}
+
+/* nome relativo que nao sai do diretorio corrente */
+static int is_local_name( const char* name )
+{
+	return name[0] != '\0' && name[0] != '/' && strstr( name, ".." ) == NULL;
+}
+
+/*- Trabalhador ------------*/
+
+/* grava um arquivo recebido, criando os subdiretorios do nome */
+static int worker_save( NetReader* reader, const char* name, long size )
+{
+	char path[FILENAME_MAX];
+	char* data = (char*)malloc( size > 0 ? size : 1 );
+	char* slash;
+	FILE* file;
+	int ok = netRead( reader, data, size ) && is_local_name( name ) && strlen( name ) < sizeof(path);
+
+	if( ok ) {
+		strcpy( path, name );
+		for( slash = strchr( path, '/' ); slash != NULL; slash = strchr( slash + 1, '/' ) ) {
+			*slash = '\0';
+			mkdir( path, 0700 );
+			*slash = '/';
+		}
+
+		file = fopen( path, "wb" );
+		ok = ( file != NULL && fwrite( data, 1, size, file ) == (size_t)size );
+		if( file != NULL )
+			fclose( file );
+	}
+
+	free( data );
+	return ok;
+}
+
+/* renderiza um ladrilho e devolve seus pixels */
+static int worker_tile( int socket, Scene* scene, int id, RenderTile* tile )
+{
+	Image* image = imgCreate( tile->width, tile->height );
+	RenderTile* tiles;
+	int count = renCreateTiles( tile->x, tile->y, tile->width, tile->height, SUBTILE_SIZE, &tiles );
+	int ok;
+
+	renRenderTiles( scene, image, tile->x, tile->y, tiles, count, NULL, NULL );
+	free( tiles );
+
+	ok = netPrintf( socket, "PIXELS %d\n", id ) &&
+		 netSend( socket, imgGetRGBData( image ), 3L * tile->width * tile->height * sizeof(float) );
+
+	imgDestroy( image );
+	return ok;
+}
+
+/* atende um coordenador ate' END ou o fim da conexao, num diretorio temporario */
+static void worker_serve( int socket )
+{
+	char directory[] = "/tmp/rtnodeXXXXXX";
+	char line[NET_LINE_SIZE];
+	char name[FILENAME_MAX];
+	char command[64];
+	NetReader* reader = netReaderCreate( socket );
+	Scene* scene = NULL;
+	RenderTile tile;
+	long size;
+	int id, depth, roulette;
+	double contribution;
+
+	if( mkdtemp( directory ) == NULL || chdir( directory ) != 0 ) {
+		netPrintf( socket, "ERROR nao foi possivel criar o diretorio temporario\n" );
+		netReaderDestroy( reader );
+		return;
+	}
+
+	while( netReadLine( reader, line, sizeof(line) ) ) {
+		if( sscanf( line, "TILE %d %d %d %d %d", &id, &tile.x, &tile.y, &tile.width, &tile.height ) == 5 ) {
+			if( scene == NULL || !worker_tile( socket, scene, id, &tile ) )
+				break;
+		}
+		else if( sscanf( line, "FILE %ld %s", &size, name ) == 2 ) {
+			if( !worker_save( reader, name, size ) ) {
+				netPrintf( socket, "ERROR nao foi possivel gravar %s\n", name );
+				break;
+			}
+		}
+		else if( sscanf( line, "LOAD %s %d %lf %d", name, &depth, &contribution, &roulette ) == 4 ) {
+			if( scene != NULL )
+				sceDestroy( scene );
+
+			scene = sceLoad( name );
+			if( scene == NULL || sceGetCamera( scene ) == NULL ) {
+				netPrintf( socket, "ERROR nao foi possivel ler a cena\n" );
+				break;
+			}
+
+			sceSetRayTree( scene, depth, contribution, roulette );
+			netPrintf( socket, "READY %d %d\n", camGetScreenWidth( sceGetCamera( scene ) ),
+					   camGetScreenHeight( sceGetCamera( scene ) ) );
+		}
+		else if( sscanf( line, "%63s", command ) != 1 || strcmp( command, "END" ) == 0 )
+			break;
+	}
+
+	if( scene != NULL )
+		sceDestroy( scene );
+	texFlushCache();
+	netReaderDestroy( reader );
+
+	/* o diretorio temporario sai com tudo o que foi recebido */
+	if( chdir( "/" ) != 0 || nftw( directory, remove_entry, 16, FTW_DEPTH | FTW_PHYS ) != 0 )
+		fprintf( stderr, "rtnode: nao foi possivel remover %s\n", directory );
+}
+
+/* aceita coordenadores, cada um atendido por um processo filho */
+static int worker_main( const char* program, const char* port )
+{
+	int server = netListen( port );
+	int client;
+
+	if( server < 0 ) {
+		fprintf( stderr, "%s: nao foi possivel abrir a porta %s\n", program, port );
+		return 1;
+	}
+
+	/* os filhos terminados sao descartados sem wait */
+	signal( SIGCHLD, SIG_IGN );
+
+	for( ;; ) {
+		client = accept( server, NULL, NULL );
+		if( client < 0 )
+			continue;
+
+		if( fork() == 0 ) {
+			close( server );
+			worker_serve( client );
+			close( client );
+			_exit( 0 );
+		}
+
+		close( client );
+	}
+}
+
+/*- Coordenador ------------*/
+
+/* envia a cena e espera o trabalhador le-la */
+static int coordinator_send_scene( Worker* worker, Scene* scene, const char* filename,
+								   int width, int height )
+{
+	char line[NET_LINE_SIZE];
+	long size;
+	char* data = read_file( filename, &size );
+	int w, h, i;
+	int ok = ( data != NULL ) &&
+			 netPrintf( worker->socket, "FILE %ld %s\n", size, SCENE_NAME ) &&
+			 netSend( worker->socket, data, size );
+
+	free( data );
+
+	for( i = 0; ok && i < sceGetFileCount( scene ); ++i ) {
+		data = read_file( sceGetFileName( scene, i ), &size );
+		ok = ( data != NULL ) &&
+			 netPrintf( worker->socket, "FILE %ld %s\n", size, sceGetFileName( scene, i ) ) &&
+			 netSend( worker->socket, data, size );
+		free( data );
+	}
+
+	ok = ok && netPrintf( worker->socket, "LOAD %s %d %.17g %d\n", SCENE_NAME, sceGetMaxDepth( scene ),
+						  sceGetMinContribution( scene ), sceGetRoulette( scene ) ) &&
+		 netReadLine( worker->reader, line, sizeof(line) );
+
+	if( ok && ( sscanf( line, "READY %d %d", &w, &h ) != 2 || w != width || h != height ) ) {
+		fprintf( stderr, "rtnode: %s: %s\n", worker->address, line );
+		ok = 0;
+	}
+
+	return ok;
+}
+
+/* escolhe o proximo ladrilho de um trabalhador: um da fila, ou um roubado se ele estiver ocioso */
+static int coordinator_next_tile( TileState* tiles, int count, int* cursor, Worker* worker, int* stolen )
+{
+	int best = -1;
+	int i;
+
+	while( *cursor < count && ( tiles[*cursor].done || tiles[*cursor].copies > 0 ) )
+		( *cursor )++;
+
+	if( *cursor < count )
+		return ( *cursor )++;
+
+	if( worker->pendingCount > 0 )
+		return -1;
+
+	/* fila vazia e trabalhador ocioso: rouba o ladrilho pendente com menos copias */
+	for( i = 0; i < count; ++i ) {
+		if( !tiles[i].done && tiles[i].copies < MAX_COPIES &&
+			( best < 0 || tiles[i].copies < tiles[best].copies ) )
+			best = i;
+	}
+
+	if( best >= 0 && tiles[best].copies > 0 )
+		( *stolen )++;
+	return best;
+}
+
+/* desliga um trabalhador; seus ladrilhos pendentes voltam para a fila */
+static void coordinator_drop( Worker* worker, TileState* tiles, int* cursor )
+{
+	int i, id;
+
+	if( !worker->alive )
+		return;
+
+	fprintf( stderr, "rtnode: trabalhador %s desconectado\n", worker->address );
+
+	for( i = 0; i < worker->pendingCount; ++i ) {
+		id = worker->pending[i];
+		if( --tiles[id].copies == 0 && !tiles[id].done && id < *cursor )
+			*cursor = id;
+	}
+
+	worker->pendingCount = 0;
+	worker->alive = 0;
+	close( worker->socket );
+}
+
+/* recebe uma mensagem PIXELS de um trabalhador; retorna 1 se o ladrilho era novo */
+static int coordinator_receive( Worker* worker, TileState* tiles, int count, Image* image,
+								float* buffer, int* cursor )
+{
+	char line[NET_LINE_SIZE];
+	float* rgb = imgGetRGBData( image );
+	int width = imgGetWidth( image );
+	RenderTile* tile;
+	int id, i, y;
+
+	if( !netReadLine( worker->reader, line, sizeof(line) ) ||
+		sscanf( line, "PIXELS %d", &id ) != 1 || id < 0 || id >= count ) {
+		coordinator_drop( worker, tiles, cursor );
+		return 0;
+	}
+
+	for( i = 0; i < worker->pendingCount && worker->pending[i] != id; ++i )
+		;
+	tile = &tiles[id].tile;
+
+	if( i == worker->pendingCount ||
+		!netRead( worker->reader, buffer, 3L * tile->width * tile->height * sizeof(float) ) ) {
+		coordinator_drop( worker, tiles, cursor );
+		return 0;
+	}
+
+	worker->pending[i] = worker->pending[--worker->pendingCount];
+	tiles[id].copies--;
+
+	/* a copia que chega depois de um ladrilho roubado e' descartada */
+	if( tiles[id].done )
+		return 0;
+
+	for( y = 0; y < tile->height; ++y ) {
+		memcpy( rgb + 3 * ( (size_t)( tile->y + y ) * width + tile->x ),
+				buffer + 3 * y * tile->width, 3 * tile->width * sizeof(float) );
+	}
+
+	tiles[id].done = 1;
+	worker->rendered++;
+	return 1;
+}
+
+/* renderiza a cena nos trabalhadores e grava a imagem */
+static int coordinator_main( const char* program, char* filename, char* output,
+							 const char** addresses, int workerCount,
+							 int maxDepth, double minContribution, int roulette, int tileSize )
+{
+	Worker workers[MAX_WORKERS];
+	struct pollfd fds[MAX_WORKERS];
+	Worker* polled[MAX_WORKERS];
+	Scene* scene;
+	Image* image;
+	RenderTile* rects;
+	TileState* tiles;
+	float* buffer;
+	int width, height, count, done = 0, cursor = 0, stolen = 0, ok;
+	int alive, ready, n, i, id;
+	double start_time;
+
+	scene = sceLoad( filename );
+	if( scene == NULL || sceGetCamera( scene ) == NULL ) {
+		fprintf( stderr, "%s: nao foi possivel ler a cena %s\n", program, filename );
+		return 1;
+	}
+
+	for( i = 0; i < sceGetFileCount( scene ); ++i ) {
+		if( !is_local_name( sceGetFileName( scene, i ) ) ) {
+			fprintf( stderr, "%s: %s fora do diretorio corrente nao pode ser enviado\n",
+					 program, sceGetFileName( scene, i ) );
+			return 1;
+		}
+	}
+
+	if( maxDepth < 0 ) maxDepth = sceGetMaxDepth( scene );
+	if( minContribution < 0.0 ) minContribution = sceGetMinContribution( scene );
+	if( roulette < 0 ) roulette = sceGetRoulette( scene );
+	sceSetRayTree( scene, maxDepth, minContribution, roulette );
+
+	width = camGetScreenWidth( sceGetCamera( scene ) );
+	height = camGetScreenHeight( sceGetCamera( scene ) );
+	start_time = parGetTime();
+
+	/* cada trabalhador recebe a cena; os que falham ficam de fora */
+	for( i = 0, alive = 0; i < workerCount; ++i ) {
+		Worker* worker = &workers[i];
+
+		worker->address = addresses[i];
+		worker->socket = netConnect( addresses[i] );
+		worker->reader = ( worker->socket >= 0 ) ? netReaderCreate( worker->socket ) : NULL;
+		worker->alive = ( worker->socket >= 0 );
+		worker->pendingCount = 0;
+		worker->rendered = 0;
+
+		if( worker->alive && !coordinator_send_scene( worker, scene, filename, width, height ) ) {
+			close( worker->socket );
+			worker->alive = 0;
+		}
+		if( !worker->alive )
+			fprintf( stderr, "%s: trabalhador %s indisponivel\n", program, addresses[i] );
+
+		alive += worker->alive;
+	}
+
+	count = renCreateTiles( 0, 0, width, height, tileSize, &rects );
+	tiles = (TileState*)malloc( ( count > 0 ? count : 1 ) * sizeof(TileState) );
+	for( i = 0; i < count; ++i ) {
+		tiles[i].tile = rects[i];
+		tiles[i].copies = 0;
+		tiles[i].done = 0;
+	}
+	free( rects );
+
+	image = imgCreate( width, height );
+	buffer = (float*)malloc( 3 * ( tileSize < width ? tileSize : width ) * ( tileSize < height ? tileSize : height ) * sizeof(float) );
+
+	while( done < count && alive > 0 ) {
+		/* completa a fila de cada trabalhador */
+		for( i = 0; i < workerCount; ++i ) {
+			Worker* worker = &workers[i];
+
+			while( worker->alive && worker->pendingCount < PIPELINE &&
+				   ( id = coordinator_next_tile( tiles, count, &cursor, worker, &stolen ) ) >= 0 ) {
+				RenderTile* tile = &tiles[id].tile;
+
+				if( !netPrintf( worker->socket, "TILE %d %d %d %d %d\n", id, tile->x, tile->y,
+								tile->width, tile->height ) ) {
+					coordinator_drop( worker, tiles, &cursor );
+					break;
+				}
+
+				worker->pending[worker->pendingCount++] = id;
+				tiles[id].copies++;
+			}
+		}
+
+		/* espera a resposta de algum trabalhador (ou usa a que ja' esta' no buffer) */
+		for( i = 0, n = 0, ready = 0; i < workerCount; ++i ) {
+			if( workers[i].alive && workers[i].pendingCount > 0 ) {
+				polled[n] = &workers[i];
+				fds[n].fd = workers[i].socket;
+				fds[n].events = POLLIN;
+				fds[n].revents = 0;
+				ready |= netPending( workers[i].reader );
+				n++;
+			}
+		}
+
+		if( n > 0 && poll( fds, n, ready ? 0 : -1 ) >= 0 ) {
+			for( i = 0; i < n; ++i ) {
+				if( fds[i].revents || netPending( polled[i]->reader ) )
+					done += coordinator_receive( polled[i], tiles, count, image, buffer, &cursor );
+			}
+		}
+
+		for( i = 0, alive = 0; i < workerCount; ++i )
+			alive += workers[i].alive;
+	}
+
+	for( i = 0; i < workerCount; ++i ) {
+		if( workers[i].alive ) {
+			netPrintf( workers[i].socket, "END\n" );
+			close( workers[i].socket );
+		}
+		if( workers[i].reader != NULL )
+			netReaderDestroy( workers[i].reader );
+	}
+
+	ok = ( done == count );
+	if( !ok ) {
+		fprintf( stderr, "%s: nenhum trabalhador disponivel; %d de %d ladrilhos renderizados\n",
+				 program, done, count );
+	}
+	else {
+		printf( "%3dx%3d tempo=%.3lf s ladrilhos=%d roubados=%d\n",
+				width, height, parGetTime() - start_time, count, stolen );
+		for( i = 0; i < workerCount; ++i )
+			printf( "  %s: %d ladrilhos\n", workers[i].address, workers[i].rendered );
+
+		imgWriteAsync( output, image );
+	}
+
+	free( buffer );
+	free( tiles );
+	imgDestroy( image );
+	sceDestroy( scene );
+	texFlushCache();
+
+	if( ok && !imgWriteWait() ) {
+		fprintf( stderr, "%s: nao foi possivel gravar %s\n", program, output );
+		ok = 0;
+	}
+	return ok ? 0 : 1;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Rotina principal.                                                       */
+/*-------------------------------------------------------------------------*/
+int main( int argc, char* argv[] )
+{
+	const char* addresses[MAX_WORKERS];
+	int workerCount = 0;
+	int maxDepth = -1;
+	double minContribution = -1.0;
+	int roulette = -1;
+	int tileSize = TILE_SIZE;
+	int i;
+
+	/* um trabalhador que cai no meio do envio nao derruba o coordenador */
+	signal( SIGPIPE, SIG_IGN );
+
+	if( argc >= 3 && strcmp( argv[1], "-worker" ) == 0 )
+	{
+		for( i = 3; i < argc; ++i )
+		{
+			if( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc )
+				parSetThreads( atoi( argv[++i] ) );
+			else
+			{
+				usage( argv[0] );
+				return 1;
+			}
+		}
+
+		return worker_main( argv[0], argv[2] );
+	}
+
+	if( argc < 4 )
+	{
+		usage( argv[0] );
+		return 1;
+	}
+
+	for( i = 3; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-depth" ) == 0 && i + 1 < argc )
+			maxDepth = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-contrib" ) == 0 && i + 1 < argc )
+			minContribution = atof( argv[++i] );
+		else if( strcmp( argv[i], "-roulette" ) == 0 )
+			roulette = 1;
+		else if( strcmp( argv[i], "-tile" ) == 0 && i + 1 < argc )
+			tileSize = atoi( argv[++i] );
+		else if( argv[i][0] != '-' && strchr( argv[i], ':' ) != NULL && workerCount < MAX_WORKERS )
+			addresses[workerCount++] = argv[i];
+		else
+		{
+			usage( argv[0] );
+			return 1;
+		}
+	}
+
+	if( workerCount == 0 || tileSize < 1 )
+	{
+		usage( argv[0] );
+		return 1;
+	}
+
+	return coordinator_main( argv[0], argv[1], argv[2], addresses, workerCount,
+							 maxDepth, minContribution, roulette, tileSize );
+}
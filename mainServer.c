@@ -0,0 +1,466 @@
+/*
+ *	Computacao Grafica - Trabalho de Raytracing
+ *
+ *	@file mainServer.c Servidor de renderizacao: mantem as cenas carregadas entre
+ *	um pedido e outro e atende pedidos por um socket UNIX (so' em sistemas POSIX).
+ *
+ *	Uso: rtserver <socket> [-threads n] [-scenes n]
+ *
+ *	Opcoes:
+ *		-threads n     numero de threads dos lacos paralelos (padrao: processadores)
+ *		-scenes n      numero maximo de cenas residentes (padrao: MAX_SCENES); a
+ *		               usada ha' mais tempo e' descartada para dar lugar a outra
+ *
+ *	Protocolo: linhas de texto, um comando por linha; varios pedidos podem ser
+ *	feitos na mesma conexao, atendidos em ordem.
+ *
+ *		RENDER <cena.rt4> <saida> [SIZE w h] [CAMERA ex ey ez ax ay az ux uy uz fovy]
+ *		       [DEPTH n] [CONTRIB c] [ROULETTE 0|1] [TILE n]
+ *
+ *			Renderiza a cena com a camera do arquivo ou com a posicao, alvo,
+ *			vetor up e abertura de CAMERA, na resolucao do arquivo ou na de SIZE.
+ *			A cena so' e' lida de novo se o arquivo mudar. <saida> e' um arquivo
+ *			.bmp/.tga ou shm:/nome, um objeto de memoria compartilhada (shm_open)
+ *			com w*h*3 floats RGB, linha 0 primeiro (o layout de imgGetRGBData).
+ *			Os ladrilhos vao dos mais caros aos mais baratos, pelo custo medido
+ *			na ultima renderizacao da mesma vista (ver renRenderScene); os caros
+ *			podem ser divididos, entao os ladrilhos nao formam uma grade regular.
+ *			Respostas: "TILE x y w h" a cada ladrilho concluido (com shm os pixels
+ *			do ladrilho ja' estao na memoria compartilhada), e no fim
+ *			"DONE w h segundos raios" ou "ERROR mensagem".
+ *
+ *		QUIT       fecha a conexao.
+ *		SHUTDOWN   fecha a conexao e encerra o servidor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "image.h"
+#include "camera.h"
+#include "scene.h"
+#include "raytracing.h"
+#include "texture.h"
+#include "parallel.h"
+#include "render.h"
+#include "network.h"
+
+/** Numero padrao de cenas mantidas carregadas */
+#define MAX_SCENES	8
+
+/** Lado padrao dos ladrilhos */
+#define TILE_SIZE	32
+
+/*- Tipos ------------*/
+
+/* cena residente, com a camera e a arvore de raios como lidas do arquivo */
+typedef struct
+{
+	char filename[FILENAME_MAX];
+	time_t mtime;
+	Scene* scene;
+	unsigned long lastUse;
+
+	/* custo dos ladrilhos de cada vista ja' renderizada, para ordena-los */
+	RenderHistory* history;
+
+	Vector eye, at, up;
+	double fovy, nearp, farp;
+	int width, height;
+
+	int maxDepth;
+	double minContribution;
+	int roulette;
+} SceneEntry;
+
+/* pedido RENDER */
+typedef struct
+{
+	char scene[FILENAME_MAX];
+	char output[FILENAME_MAX];
+	int width, height;
+	int camera;
+	Vector eye, at, up;
+	double fovy;
+	int maxDepth;
+	double minContribution;
+	int roulette;
+	int tileSize;
+} Job;
+
+/* destino de um pedido, repassado a tile_done */
+typedef struct
+{
+	int client;
+	Image* image;
+	float* shared;
+} JobOutput;
+
+/*- Variaveis ------------*/
+
+static SceneEntry scenes[MAX_SCENES];
+static int sceneCount = 0;
+static int sceneLimit = MAX_SCENES;
+static unsigned long useClock = 0;
+
+/*- Funcoes auxiliares ------------*/
+
+static void usage( const char* program )
+{
+	fprintf( stderr, "uso: %s <socket> [-threads n] [-scenes n]\n", program );
+}
+
+/* retira uma cena do cache e a destroi */
+static void scene_remove( SceneEntry* entry )
+{
+	sceDestroy( entry->scene );
+	renHistoryDestroy( entry->history );
+	*entry = scenes[--sceneCount];
+}
+
+/* obtem a cena do cache, lendo o arquivo se ela nao estiver carregada ou tiver mudado */
+static SceneEntry* scene_get( const char* filename )
+{
+	struct stat info;
+	SceneEntry* entry;
+	Camera* camera;
+	Scene* scene;
+	int i;
+
+	if( stat( filename, &info ) != 0 )
+		return NULL;
+
+	for( i = 0; i < sceneCount; ++i ) {
+		if( strcmp( scenes[i].filename, filename ) == 0 ) {
+			if( scenes[i].mtime == info.st_mtime ) {
+				scenes[i].lastUse = ++useClock;
+				return &scenes[i];
+			}
+
+			/* o arquivo mudou: as texturas continuam no cache para a nova leitura */
+			scene_remove( &scenes[i] );
+			break;
+		}
+	}
+
+	if( sceneCount == sceneLimit ) {
+		/* descarta a cena usada ha' mais tempo, e as texturas que so' ela usava */
+		entry = &scenes[0];
+		for( i = 1; i < sceneCount; ++i )
+			if( scenes[i].lastUse < entry->lastUse )
+				entry = &scenes[i];
+
+		scene_remove( entry );
+		texTrimCache();
+	}
+
+	scene = sceLoad( filename );
+	if( scene == NULL || sceGetCamera( scene ) == NULL ) {
+		if( scene != NULL )
+			sceDestroy( scene );
+		return NULL;
+	}
+
+	entry = &scenes[sceneCount++];
+	camera = sceGetCamera( scene );
+	strncpy( entry->filename, filename, sizeof(entry->filename) - 1 );
+	entry->filename[sizeof(entry->filename) - 1] = '\0';
+	entry->mtime = info.st_mtime;
+	entry->scene = scene;
+	entry->lastUse = ++useClock;
+	entry->history = renHistoryCreate();
+	camGetView( camera, &entry->eye, &entry->at, &entry->up, &entry->fovy, &entry->nearp, &entry->farp );
+	entry->width = camGetScreenWidth( camera );
+	entry->height = camGetScreenHeight( camera );
+	entry->maxDepth = sceGetMaxDepth( scene );
+	entry->minContribution = sceGetMinContribution( scene );
+	entry->roulette = sceGetRoulette( scene );
+	return entry;
+}
+
+/* le os argumentos de um comando RENDER; retorna 0 se forem invalidos */
+static int parse_job( char* args, Job* job )
+{
+	char* token;
+
+	job->width = job->height = 0;
+	job->camera = 0;
+	job->maxDepth = -1;
+	job->minContribution = -1.0;
+	job->roulette = -1;
+	job->tileSize = TILE_SIZE;
+
+	if( sscanf( args, "%s %s", job->scene, job->output ) != 2 )
+		return 0;
+
+	strtok( args, " \t\r\n" );
+	strtok( NULL, " \t\r\n" );
+
+	while( ( token = strtok( NULL, " \t\r\n" ) ) != NULL ) {
+		if( strcmp( token, "SIZE" ) == 0 ) {
+			char* w = strtok( NULL, " \t\r\n" );
+			char* h = strtok( NULL, " \t\r\n" );
+			if( w == NULL || h == NULL )
+				return 0;
+			job->width = atoi( w );
+			job->height = atoi( h );
+			if( job->width <= 0 || job->height <= 0 )
+				return 0;
+		}
+		else if( strcmp( token, "CAMERA" ) == 0 ) {
+			double v[10];
+			int i;
+			for( i = 0; i < 10; ++i ) {
+				char* value = strtok( NULL, " \t\r\n" );
+				if( value == NULL )
+					return 0;
+				v[i] = atof( value );
+			}
+			job->camera = 1;
+			job->eye = algVector( v[0], v[1], v[2], 1 );
+			job->at = algVector( v[3], v[4], v[5], 1 );
+			job->up = algVector( v[6], v[7], v[8], 1 );
+			job->fovy = v[9];
+		}
+		else if( strcmp( token, "DEPTH" ) == 0 ) {
+			char* value = strtok( NULL, " \t\r\n" );
+			if( value == NULL )
+				return 0;
+			job->maxDepth = atoi( value );
+		}
+		else if( strcmp( token, "CONTRIB" ) == 0 ) {
+			char* value = strtok( NULL, " \t\r\n" );
+			if( value == NULL )
+				return 0;
+			job->minContribution = atof( value );
+		}
+		else if( strcmp( token, "ROULETTE" ) == 0 ) {
+			char* value = strtok( NULL, " \t\r\n" );
+			if( value == NULL )
+				return 0;
+			job->roulette = atoi( value );
+		}
+		else if( strcmp( token, "TILE" ) == 0 ) {
+			char* value = strtok( NULL, " \t\r\n" );
+			if( value == NULL )
+				return 0;
+			job->tileSize = atoi( value );
+		}
+		else
+			return 0;
+	}
+
+	return 1;
+}
+
+/* chamada a cada ladrilho concluido: copia para a memoria compartilhada e avisa o cliente */
+static void tile_done( void* context, const RenderTile* tile )
+{
+	JobOutput* output = (JobOutput*)context;
+
+	if( output->shared != NULL ) {
+		int width = imgGetWidth( output->image );
+		float* rgb = imgGetRGBData( output->image );
+		int y;
+
+		for( y = tile->y; y < tile->y + tile->height; ++y ) {
+			size_t offset = 3 * ( (size_t)y * width + tile->x );
+			memcpy( output->shared + offset, rgb + offset, 3 * tile->width * sizeof(float) );
+		}
+	}
+
+	netPrintf( output->client, "TILE %d %d %d %d\n", tile->x, tile->y, tile->width, tile->height );
+}
+
+/* atende um pedido RENDER */
+static void render_job( int client, char* args )
+{
+	Job job;
+	SceneEntry* entry;
+	Camera* camera;
+	JobOutput output;
+	RayStats stats;
+	size_t bytes = 0;
+	int ok = 1;
+	double start_time = parGetTime();
+
+	if( !parse_job( args, &job ) ) {
+		netPrintf( client, "ERROR pedido invalido\n" );
+		return;
+	}
+
+	entry = scene_get( job.scene );
+	if( entry == NULL ) {
+		netPrintf( client, "ERROR nao foi possivel ler a cena %s\n", job.scene );
+		return;
+	}
+
+	if( job.width == 0 ) {
+		job.width = entry->width;
+		job.height = entry->height;
+	}
+	if( !job.camera ) {
+		job.eye = entry->eye;
+		job.at = entry->at;
+		job.up = entry->up;
+		job.fovy = entry->fovy;
+	}
+
+	/* a cena residente recebe a camera e a arvore de raios do pedido */
+	camera = camCreate( job.eye, job.at, job.up, job.fovy, entry->nearp, entry->farp, job.width, job.height );
+	sceSetCamera( entry->scene, camera );
+	sceSetRayTree( entry->scene,
+				   ( job.maxDepth >= 0 ) ? job.maxDepth : entry->maxDepth,
+				   ( job.minContribution >= 0.0 ) ? job.minContribution : entry->minContribution,
+				   ( job.roulette >= 0 ) ? job.roulette : entry->roulette );
+
+	output.client = client;
+	output.image = imgCreate( job.width, job.height );
+	output.shared = NULL;
+
+	if( strncmp( job.output, "shm:", 4 ) == 0 ) {
+		int fd = shm_open( job.output + 4, O_RDWR | O_CREAT, 0600 );
+
+		bytes = 3 * (size_t)job.width * job.height * sizeof(float);
+		if( fd >= 0 && ftruncate( fd, (off_t)bytes ) == 0 ) {
+			output.shared = (float*)mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+			if( output.shared == (float*)MAP_FAILED )
+				output.shared = NULL;
+		}
+		if( fd >= 0 )
+			close( fd );
+
+		if( output.shared == NULL ) {
+			netPrintf( client, "ERROR nao foi possivel abrir a memoria compartilhada %s\n", job.output + 4 );
+			imgDestroy( output.image );
+			return;
+		}
+	}
+
+	rayResetStats();
+	renRenderScene( entry->scene, output.image, job.tileSize, entry->history, tile_done, &output );
+	stats = rayGetStats();
+
+	if( output.shared != NULL ) {
+		munmap( output.shared, bytes );
+	}
+	else {
+		imgWriteAsync( job.output, output.image );
+		ok = imgWriteWait();
+	}
+	imgDestroy( output.image );
+
+	if( ok )
+		netPrintf( client, "DONE %d %d %.3lf %llu\n", job.width, job.height, parGetTime() - start_time, stats.traced );
+	else
+		netPrintf( client, "ERROR nao foi possivel gravar %s\n", job.output );
+}
+
+/* atende uma conexao ate' QUIT, SHUTDOWN ou o fim; retorna 0 para encerrar o servidor */
+static int serve( int client )
+{
+	FILE* input = fdopen( dup( client ), "r" );
+	char line[NET_LINE_SIZE];
+	int running = 1;
+
+	if( input == NULL )
+		return 1;
+
+	while( fgets( line, sizeof(line), input ) ) {
+		if( strncmp( line, "RENDER ", 7 ) == 0 )
+			render_job( client, line + 7 );
+		else if( strncmp( line, "QUIT", 4 ) == 0 )
+			break;
+		else if( strncmp( line, "SHUTDOWN", 8 ) == 0 ) {
+			running = 0;
+			break;
+		}
+		else
+			netPrintf( client, "ERROR comando desconhecido\n" );
+	}
+
+	fclose( input );
+	return running;
+}
+
+/*-------------------------------------------------------------------------*/
+/* Rotina principal.                                                       */
+/*-------------------------------------------------------------------------*/
+int main( int argc, char* argv[] )
+{
+	struct sockaddr_un address;
+	int server, client;
+	int running = 1;
+	int i;
+
+	if( argc < 2 )
+	{
+		usage( argv[0] );
+		return 1;
+	}
+
+	for( i = 2; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc )
+			parSetThreads( atoi( argv[++i] ) );
+		else if( strcmp( argv[i], "-scenes" ) == 0 && i + 1 < argc )
+		{
+			sceneLimit = atoi( argv[++i] );
+			if( sceneLimit < 1 || sceneLimit > MAX_SCENES )
+				sceneLimit = MAX_SCENES;
+		}
+		else
+		{
+			usage( argv[0] );
+			return 1;
+		}
+	}
+
+	/* um cliente que desconecta no meio de um pedido nao derruba o servidor */
+	signal( SIGPIPE, SIG_IGN );
+
+	memset( &address, 0, sizeof(address) );
+	address.sun_family = AF_UNIX;
+	if( strlen( argv[1] ) >= sizeof(address.sun_path) )
+	{
+		fprintf( stderr, "%s: nome de socket muito longo: %s\n", argv[0], argv[1] );
+		return 1;
+	}
+	strcpy( address.sun_path, argv[1] );
+	unlink( argv[1] );
+
+	server = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( server < 0 || bind( server, (struct sockaddr*)&address, sizeof(address) ) != 0 ||
+		listen( server, 8 ) != 0 )
+	{
+		fprintf( stderr, "%s: nao foi possivel abrir o socket %s\n", argv[0], argv[1] );
+		return 1;
+	}
+
+	while( running )
+	{
+		client = accept( server, NULL, NULL );
+		if( client < 0 )
+			continue;
+
+		running = serve( client );
+		close( client );
+	}
+
+	close( server );
+	unlink( argv[1] );
+
+	while( sceneCount > 0 )
+		scene_remove( &scenes[0] );
+	texFlushCache();
+	return 0;
+}
@@ -14,6 +14,7 @@
  */
 
 #include "material.h"
+#include "memory.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -25,7 +26,7 @@ struct _Material
 	/**
      *  Textura do material.
      */
-	Image *texture;
+	Texture *texture;
 
 	/**
      *  Cor base do material (difusa).
@@ -57,11 +58,11 @@ struct _Material
 /************************************************************************/
 /* Definio das Funes Exportadas                                     */
 /************************************************************************/
-Material* matCreate( Image *texture, Color diffuseColor, 
+Material* matCreate( Texture *texture, Color diffuseColor, 
 					Color specularColor, double specularExponent,
 					double reflectionFactor, double refractionFactor, double opacityFactor )
 {
-	Material* material = (struct _Material *)malloc( sizeof(struct _Material) );
+	Material* material = (struct _Material *)memAlloc( MEM_SCENE, sizeof(struct _Material) );
 	
 	material->texture = texture;
 	material->diffuseColor = diffuseColor;
@@ -74,27 +75,19 @@ Material* matCreate( Image *texture, Color diffuseColor,
 	return material;
 }
 
-Color matGetDiffuse( Material* material, Vector textureCoordinate )
+Color matGetDiffuse( Material* material, Vector textureCoordinate, double footprint )
 {
-	int x;
-	int y;
-	int width;
-	int height;
-
 	if( material->texture == NULL )
 	{
 		return material->diffuseColor;
 	}
 
-	width = imgGetWidth(material->texture);
-	height = imgGetHeight(material->texture);
-
-	//imageGetDimensions( material->texture, &width, &height );
-	
-	x = ( (int)( textureCoordinate.x * ( width - 1 ) ) % width );
-	y = ( (int)( textureCoordinate.y * ( height - 1 ) ) % height );
+	return texSample( material->texture, textureCoordinate.x, textureCoordinate.y, footprint );
+}
 
-	return imageGetPixel( material->texture, x, y );
+int matHasTexture( Material* material )
+{
+	return material->texture != NULL;
 }
 
 Color matGetSpecular( Material* material )
@@ -124,6 +117,7 @@ double matGetOpacity( Material* material )
 
 void matDestroy( Material* material )
 {
-	free( material );
+	texRelease( material->texture );
+	memFree( material );
 }
 
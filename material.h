@@ -17,7 +17,7 @@
 #define _MATERIAL_H_
 
 #include "color.h"
-#include "image.h"
+#include "texture.h"
 #include "algebra.h"
 
 
@@ -35,7 +35,8 @@ typedef struct _Material Material;
 /**
  *	Cria um novo material com as propriedades especificadas.
  *
- *	@param texture Imagem contendo textura do material (pode ser NULL).
+ *	@param texture Textura do material (pode ser NULL). O material fica com a
+ *				referncia recebida e a libera em matDestroy().
  *	@param diffusecolor Cor base do material ( substituido pela textura, quando presente).
  *	@param specularColor Cor do brilho especular para este material.
  *	@param specularExponent Coeficiente que define o brilho especular.
@@ -46,7 +47,7 @@ typedef struct _Material Material;
  *
  *	@return Handle para o material criado.
  */
-Material* matCreate( Image *texture, Color diffuseColor, 
+Material* matCreate( Texture *texture, Color diffuseColor, 
 					Color specularColor, double specularExponent,
 					double reflectionFactor, double refractionFactor, double opacityFactor );
 
@@ -55,10 +56,17 @@ Material* matCreate( Image *texture, Color diffuseColor,
  *
  *	@param material Handle para o material do objeto.
  *	@param textureCoordinate Coordenada de textura calculada para o objeto em questo.
+ *	@param footprint Tamanho, em coordenadas de textura, da regio coberta pelo pixel
+ *				(escolhe o nvel de mipmap; ver texSample).
  *
  *	@return Cor difusa do objeto num certo ponto.
  */
-Color matGetDiffuse( Material* material, Vector textureCoordinate );
+Color matGetDiffuse( Material* material, Vector textureCoordinate, double footprint );
+
+/**
+ *	Indica se um material tem textura (e portanto precisa de coordenadas de textura).
+ */
+int matHasTexture( Material* material );
 
 /**
  *	Obtm a cor do brilho especular de um material.
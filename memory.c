@@ -0,0 +1,155 @@
+/**
+ *	@file memory.c Memory: contabilidade da memria alocada por subsistema.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "parallel.h"
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Cabealho guardado antes de cada bloco, com o tamanho de dois doubles
+ *   para que o bloco mantenha o alinhamento de malloc.
+ */
+typedef union
+{
+	struct
+	{
+		size_t size;
+		int tag;
+	} info;
+	double align[2];
+} MemHeader;
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** Bytes em uso e pico de cada marca; a posio MEM_TAG_COUNT  o total */
+static volatile long long memCurrent[MEM_TAG_COUNT + 1];
+static volatile long long memPeak[MEM_TAG_COUNT + 1];
+
+/** Nomes das marcas, na ordem das constantes MEM_* */
+static const char* tagNames[] = { "scene", "meshes", "textures", "framebuffer", "accel", "caches" };
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Soma added e subtrai removed dos bytes em uso de uma marca e do total,
+ *	atualizando os picos.
+ */
+static void account( int tag, size_t added, size_t removed );
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+void* memAlloc( int tag, size_t size )
+{
+	MemHeader* header = (MemHeader*)malloc( sizeof(MemHeader) + size );
+
+	if( header == NULL )
+		return NULL;
+
+	header->info.size = size;
+	header->info.tag = tag;
+	account( tag, size, 0 );
+	return header + 1;
+}
+
+void* memCalloc( int tag, size_t count, size_t size )
+{
+	void* block = memAlloc( tag, count * size );
+
+	if( block )
+		memset( block, 0, count * size );
+	return block;
+}
+
+void* memRealloc( int tag, void* block, size_t size )
+{
+	MemHeader* header;
+	size_t old;
+
+	if( block == NULL )
+		return memAlloc( tag, size );
+
+	header = (MemHeader*)block - 1;
+	old = header->info.size;
+	tag = header->info.tag;
+
+	header = (MemHeader*)realloc( header, sizeof(MemHeader) + size );
+	if( header == NULL )
+		return NULL;
+
+	header->info.size = size;
+	account( tag, size, old );
+	return header + 1;
+}
+
+void memFree( void* block )
+{
+	MemHeader* header;
+
+	if( block == NULL )
+		return;
+
+	header = (MemHeader*)block - 1;
+	account( header->info.tag, 0, header->info.size );
+	free( header );
+}
+
+MemStats memGetStats( int tag )
+{
+	MemStats stats;
+
+	stats.current = (size_t)parAtomicAdd64( &memCurrent[tag], 0 );
+	stats.peak = (size_t)parAtomicAdd64( &memPeak[tag], 0 );
+	return stats;
+}
+
+MemStats memGetTotal( void )
+{
+	return memGetStats( MEM_TAG_COUNT );
+}
+
+const char* memGetTagName( int tag )
+{
+	return ( tag < 0 || tag >= MEM_TAG_COUNT ) ? NULL : tagNames[tag];
+}
+
+void memResetPeaks( void )
+{
+	int i;
+
+	for( i = 0; i <= MEM_TAG_COUNT; ++i )
+		memPeak[i] = parAtomicAdd64( &memCurrent[i], 0 );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void account( int tag, size_t added, size_t removed )
+{
+	long long delta = (long long)added - (long long)removed;
+	long long current = parAtomicAdd64( &memCurrent[tag], delta ) + delta;
+	long long total = parAtomicAdd64( &memCurrent[MEM_TAG_COUNT], delta ) + delta;
+
+	if( delta > 0 )
+	{
+		parAtomicMax64( &memPeak[tag], current );
+		parAtomicMax64( &memPeak[MEM_TAG_COUNT], total );
+	}
+}
@@ -0,0 +1,106 @@
+/**
+ *	@file memory.h Memory: contabilidade da memria alocada por subsistema.
+ *
+ *	Cada bloco alocado com memAlloc leva a marca do subsistema dono, e os
+ *	bytes em uso e o pico de cada marca so mantidos enquanto o programa roda.
+ *	Blocos de memAlloc devem ser liberados com memFree (nunca com free).
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <stddef.h>
+
+
+/************************************************************************/
+/* Constantes Exportadas                                                */
+/************************************************************************/
+/** Marcas de subsistema dos blocos alocados */
+#define MEM_SCENE		0	/**< cena, objetos, materiais, luzes e cmera */
+#define MEM_MESHES		1	/**< vrtices e tringulos das malhas */
+#define MEM_TEXTURES	2	/**< nveis das texturas */
+#define MEM_FRAMEBUFFER	3	/**< imagens (imgCreate): a renderizada, o fundo e as intermedirias */
+#define MEM_ACCEL		4	/**< estruturas de acelerao (caixas envolventes) */
+#define MEM_CACHES		5	/**< caches (histricos de custo da renderizao) */
+#define MEM_TAG_COUNT	6
+
+
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+/**
+ *	Bytes alocados de uma marca (ou de todas).
+ */
+typedef struct
+{
+	/**
+	 *  Bytes em uso.
+	 */
+	size_t current;
+	/**
+	 *  Maior valor de current desde o incio do programa (ou de memResetPeaks).
+	 */
+	size_t peak;
+} MemStats;
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Aloca um bloco, como malloc, contado na marca tag.
+ *
+ *	@param tag Uma das constantes MEM_*.
+ *	@param size Tamanho do bloco, em bytes.
+ *
+ *	@return Bloco alocado, ou NULL se no houver memria.
+ */
+void* memAlloc( int tag, size_t size );
+
+/**
+ *	Aloca um bloco zerado de count x size bytes, como calloc, contado na marca tag.
+ */
+void* memCalloc( int tag, size_t count, size_t size );
+
+/**
+ *	Muda o tamanho de um bloco, como realloc. O bloco continua com a sua marca;
+ *	tag s  usada quando block  NULL.
+ */
+void* memRealloc( int tag, void* block, size_t size );
+
+/**
+ *	Libera um bloco alocado com memAlloc, memCalloc ou memRealloc. No faz
+ *	nada se block for NULL.
+ */
+void memFree( void* block );
+
+/**
+ *	Obtm os bytes em uso e o pico de uma marca.
+ *
+ *	@param tag Uma das constantes MEM_*.
+ */
+MemStats memGetStats( int tag );
+
+/**
+ *	Obtm os bytes em uso somados de todas as marcas, e o pico dessa soma
+ *	(menor ou igual  soma dos picos, que podem ter ocorrido em momentos diferentes).
+ */
+MemStats memGetTotal( void );
+
+/**
+ *	Obtm o nome de uma marca: "scene", "meshes", "textures", "framebuffer",
+ *	"accel" ou "caches".
+ */
+const char* memGetTagName( int tag );
+
+/**
+ *	Faz o pico de cada marca (e o do total) voltar aos bytes em uso, para medir
+ *	o pico de um trecho do programa.
+ */
+void memResetPeaks( void );
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ *	@file network.c Network: conexes TCP e leitura de mensagens em linhas de
+ *	texto seguidas de dados binrios. S em sistemas POSIX.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include "network.h"
+
+
+/************************************************************************/
+/* Constantes Privadas                                                  */
+/************************************************************************/
+/** Tamanho do buffer de um NetReader */
+#define NET_BUFFER_SIZE	65536
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Leitor com buffer: os bytes em [begin, end) foram recebidos e ainda no lidos.
+ */
+struct _NetReader
+{
+	int socket;
+	int begin;
+	int end;
+	char buffer[NET_BUFFER_SIZE];
+};
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Recebe mais dados do socket para o buffer vazio.
+ *
+ *	@return 0 se a conexo terminou.
+ */
+static int netFill( NetReader* reader );
+
+/**
+ *	Desliga o algoritmo de Nagle: as mensagens so pequenas e respondidas uma a
+ *	uma, e esperar para agrup-las s aumentaria a latncia.
+ */
+static void netNoDelay( int socket );
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+int netListen( const char* port )
+{
+	struct addrinfo hints, *info;
+	int server, on = 1;
+
+	memset( &hints, 0, sizeof(hints) );
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	if( getaddrinfo( NULL, port, &hints, &info ) != 0 )
+		return -1;
+
+	server = socket( info->ai_family, info->ai_socktype, info->ai_protocol );
+	if( server >= 0 )
+	{
+		setsockopt( server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+		if( bind( server, info->ai_addr, info->ai_addrlen ) != 0 || listen( server, 8 ) != 0 )
+		{
+			close( server );
+			server = -1;
+		}
+	}
+
+	freeaddrinfo( info );
+	return server;
+}
+
+int netConnect( const char* address )
+{
+	struct addrinfo hints, *info, *i;
+	char host[256];
+	const char* port = strrchr( address, ':' );
+	int client = -1;
+
+	if( port == NULL || port - address >= (int)sizeof(host) )
+		return -1;
+
+	memcpy( host, address, port - address );
+	host[port - address] = '\0';
+
+	memset( &hints, 0, sizeof(hints) );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if( getaddrinfo( host, port + 1, &hints, &info ) != 0 )
+		return -1;
+
+	for( i = info; i != NULL && client < 0; i = i->ai_next )
+	{
+		client = socket( i->ai_family, i->ai_socktype, i->ai_protocol );
+		if( client >= 0 && connect( client, i->ai_addr, i->ai_addrlen ) != 0 )
+		{
+			close( client );
+			client = -1;
+		}
+	}
+
+	freeaddrinfo( info );
+
+	if( client >= 0 )
+		netNoDelay( client );
+	return client;
+}
+
+int netSend( int socket, const void* data, long size )
+{
+	const char* bytes = (const char*)data;
+	long sent;
+
+	while( size > 0 )
+	{
+		sent = (long)write( socket, bytes, size );
+		if( sent <= 0 )
+			return 0;
+
+		bytes += sent;
+		size -= sent;
+	}
+
+	return 1;
+}
+
+int netPrintf( int socket, const char* format, ... )
+{
+	char line[NET_LINE_SIZE];
+	va_list args;
+	int length;
+
+	va_start( args, format );
+	length = vsnprintf( line, sizeof(line), format, args );
+	va_end( args );
+
+	if( length < 0 )
+		return 0;
+	if( length >= (int)sizeof(line) )
+		length = sizeof(line) - 1;
+
+	return netSend( socket, line, length );
+}
+
+NetReader* netReaderCreate( int socket )
+{
+	NetReader* reader = (NetReader*)malloc( sizeof(NetReader) );
+
+	reader->socket = socket;
+	reader->begin = 0;
+	reader->end = 0;
+	netNoDelay( socket );
+	return reader;
+}
+
+int netReadLine( NetReader* reader, char* line, int size )
+{
+	int length = 0;
+	char c;
+
+	for( ;; )
+	{
+		if( reader->begin == reader->end && !netFill( reader ) )
+			return 0;
+
+		c = reader->buffer[reader->begin++];
+		if( c == '\n' )
+			break;
+
+		if( c != '\r' && length < size - 1 )
+			line[length++] = c;
+	}
+
+	line[length] = '\0';
+	return 1;
+}
+
+int netRead( NetReader* reader, void* data, long size )
+{
+	char* bytes = (char*)data;
+	long n;
+
+	while( size > 0 )
+	{
+		if( reader->begin == reader->end )
+		{
+			/* Blocos grandes vo direto do socket para o destino */
+			if( size >= NET_BUFFER_SIZE )
+			{
+				n = (long)read( reader->socket, bytes, size );
+				if( n <= 0 )
+					return 0;
+
+				bytes += n;
+				size -= n;
+				continue;
+			}
+
+			if( !netFill( reader ) )
+				return 0;
+		}
+
+		n = reader->end - reader->begin;
+		if( n > size )
+			n = size;
+
+		memcpy( bytes, reader->buffer + reader->begin, n );
+		reader->begin += n;
+		bytes += n;
+		size -= n;
+	}
+
+	return 1;
+}
+
+int netPending( NetReader* reader )
+{
+	return reader->begin < reader->end;
+}
+
+void netReaderDestroy( NetReader* reader )
+{
+	free( reader );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static int netFill( NetReader* reader )
+{
+	long n = (long)read( reader->socket, reader->buffer, NET_BUFFER_SIZE );
+
+	if( n <= 0 )
+		return 0;
+
+	reader->begin = 0;
+	reader->end = (int)n;
+	return 1;
+}
+
+static void netNoDelay( int socket )
+{
+	int on = 1;
+
+	setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+}
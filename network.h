@@ -0,0 +1,97 @@
+/**
+ *	@file network.h Network: conexes TCP e leitura de mensagens em linhas de
+ *	texto seguidas de dados binrios. S em sistemas POSIX.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _NETWORK_H_
+#define _NETWORK_H_
+
+
+/************************************************************************/
+/* Constantes Exportadas                                                */
+/************************************************************************/
+/** Tamanho mximo de uma linha enviada com netPrintf */
+#define NET_LINE_SIZE	1024
+
+
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+/**
+ *	Leitor com buffer associado a um socket.
+ */
+typedef struct _NetReader NetReader;
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Abre um socket TCP que aceita conexes em todas as interfaces.
+ *
+ *	@param port Nmero da porta.
+ *
+ *	@return Socket pronto para accept, ou -1 em caso de erro.
+ */
+int netListen( const char* port );
+
+/**
+ *	Conecta a um endereo TCP.
+ *
+ *	@param address Endereo no formato host:porta.
+ *
+ *	@return Socket conectado, ou -1 em caso de erro.
+ */
+int netConnect( const char* address );
+
+/**
+ *	Envia size bytes, esperando at que todos sejam enviados.
+ *
+ *	@return 1 se todos os bytes foram enviados, 0 se a conexo caiu.
+ */
+int netSend( int socket, const void* data, long size );
+
+/**
+ *	Envia um texto formatado como printf (no mximo NET_LINE_SIZE - 1 bytes).
+ *
+ *	@return 1 se o texto foi enviado, 0 se a conexo caiu.
+ */
+int netPrintf( int socket, const char* format, ... );
+
+/**
+ *	Cria um leitor para um socket. O socket no passa a pertencer ao leitor.
+ */
+NetReader* netReaderCreate( int socket );
+
+/**
+ *	L uma linha, sem o '\n' (e '\r') do fim.
+ *
+ *	@param line [out] Onde a linha  copiada (truncada em size - 1 caracteres).
+ *	@param size Tamanho de line.
+ *
+ *	@return 1 se uma linha foi lida, 0 se a conexo terminou antes.
+ */
+int netReadLine( NetReader* reader, char* line, int size );
+
+/**
+ *	L exatamente size bytes.
+ *
+ *	@return 1 se os bytes foram lidos, 0 se a conexo terminou antes.
+ */
+int netRead( NetReader* reader, void* data, long size );
+
+/**
+ *	Informa se o leitor j tem dados no buffer. Nesse caso a prxima leitura no
+ *	espera pelo socket, mesmo que poll/select no o indiquem como legvel.
+ */
+int netPending( NetReader* reader );
+
+/**
+ *	Destri um leitor criado com netReaderCreate (o socket no  fechado).
+ */
+void netReaderDestroy( NetReader* reader );
+#endif
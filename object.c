@@ -10,10 +10,12 @@
 
 #include "object.h"
 #include <math.h>
+#include <float.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include "algebra.h"
+#include "memory.h"
 
 /**
  *   Tipo objeto
@@ -34,10 +36,23 @@ struct _Object
 	void *data;
 };
 
+/**
+ *   rvore CSG: combinao de dois objetos por uma operao booleana.
+ */
 struct _Btree
 {
+	/**
+	 *  Operao (OP_UNION, OP_INTERSECT, OP_DIFF ou OP_INTERSECTSP).
+	 */
 	int op;
+	/**
+	 *  Operandos da operao.
+	 */
 	struct _Object *left, *right;
+	/**
+	 *  Caixa envolvente (alinhada aos eixos) do resultado da operao.
+	 */
+	Vector boxMin, boxMax;
 };
 
 /**
@@ -139,6 +154,9 @@ struct _Mesh
 #define M_PI 3.14159265358979323846
 #endif
 
+/** Nmero mximo de intervalos de CSG guardados por n da rvore */
+#define MAX_SPANS	16
+
 enum
 {
 	TYPE_UNKNOWN,
@@ -149,6 +167,75 @@ enum
 	TYPE_BTREE,
 };
 
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Extremidade de um intervalo de CSG.
+ */
+typedef struct
+{
+	/**
+	 *  Distncia, ao longo do raio, em que a superfcie  cruzada.
+	 */
+	double t;
+	/**
+	 *  Primitiva cuja superfcie  cruzada.
+	 */
+	Object* leaf;
+	/**
+	 *  No-zero se a normal da primitiva deve ser invertida (superfcie de
+	 *  um objeto subtrado).
+	 */
+	int flip;
+} SpanEnd;
+
+/**
+ *   Intervalo do raio que est dentro de um slido: de in (entrada) a out (sada).
+ */
+typedef struct
+{
+	SpanEnd in;
+	SpanEnd out;
+} Span;
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Calcula a caixa envolvente, alinhada aos eixos, de um objeto.
+ */
+static void objBounds( Object* object, Vector* boxMin, Vector* boxMax );
+
+/**
+ *	Calcula todos os intervalos em que um raio est dentro de um objeto.
+ *	Esferas e caixas geram um intervalo de entrada/sada; tringulos e malhas,
+ *	que no so slidos, geram um intervalo de comprimento nulo no ponto atingido.
+ *	rvores CSG combinam os intervalos dos filhos em uma nica passada, e ns
+ *	cuja caixa envolvente no  atingida pelo raio so ignorados.
+ *
+ *	@param spans [out] Intervalos ordenados por distncia (no mximo MAX_SPANS).
+ *
+ *	@return Nmero de intervalos.
+ */
+static int objSpans( Object* object, Vector eye, Vector ray, Span* spans );
+
+/**
+ *	Combina duas listas ordenadas de intervalos (unio, interseo e diferena).
+ *
+ *	@return Nmero de intervalos escritos em out.
+ */
+static int spanUnion( const Span* a, int na, const Span* b, int nb, Span* out );
+static int spanIntersect( const Span* a, int na, const Span* b, int nb, Span* out );
+static int spanDiff( const Span* a, int na, const Span* b, int nb, Span* out );
+
+/**
+ *	Distncia entre duas coordenadas de textura, considerando a repetio a cada unidade.
+ */
+static double wrapDistance( double a, double b );
+
 /************************************************************************/
 /* Definio das Funes Exportadas                                     */
 /************************************************************************/
@@ -158,14 +245,18 @@ Object* objCreateBtree(Object *left, Object *right, int op )
 	Object* object;
 	Btree* btree;
 
-	object = (Object *)malloc( sizeof(Object) );
-	btree = (Btree *)malloc( sizeof(Btree) );
+	object = (Object *)memAlloc( MEM_SCENE, sizeof(Object) );
+	btree = (Btree *)memAlloc( MEM_SCENE, sizeof(Btree) );
 
 	*btree = (Btree){ .left = left, .right = right, .op = op };
 
 	object->type = TYPE_BTREE;
+	object->material = -1;
 	object->data = btree;
 
+	/* A interseo cabe nas duas caixas; a diferena, na caixa do primeiro operando */
+	objBounds( object, &btree->boxMin, &btree->boxMax );
+
 	return object;
 }
 
@@ -174,8 +265,8 @@ Object* objCreateSphere( int material, const Vector center, double radius )
 	Object* object;
 	Sphere *sphere;
 
-	object = (Object *)malloc( sizeof(Object) );
-	sphere = (Sphere *)malloc( sizeof(Sphere) );
+	object = (Object *)memAlloc( MEM_SCENE, sizeof(Object) );
+	sphere = (Sphere *)memAlloc( MEM_SCENE, sizeof(Sphere) );
 
 	sphere->center = center;
 	sphere->radius = radius;
@@ -194,8 +285,8 @@ Object* objCreateTriangle( int material, const Vector v0, const Vector v1, const
 	Object* object;
 	Triangle *triangle;
 
-	object = (Object *)malloc( sizeof(Object) );
-	triangle = (Triangle *)malloc( sizeof(Triangle) );
+	object = (Object *)memAlloc( MEM_SCENE, sizeof(Object) );
+	triangle = (Triangle *)memAlloc( MEM_SCENE, sizeof(Triangle) );
 
 	triangle->v0 = v0;
 	triangle->v1 = v1;
@@ -218,8 +309,8 @@ Object* objCreateBox( int material, const Vector bottomLeft, const Vector topRig
 	Object* object;
 	Box *box;
 
-	object = (Object *)malloc( sizeof(Object) );
-	box = (Box *)malloc( sizeof(Box) );
+	object = (Object *)memAlloc( MEM_SCENE, sizeof(Object) );
+	box = (Box *)memAlloc( MEM_SCENE, sizeof(Box) );
 
 	box->bottomLeft = bottomLeft;
 	box->topRight = topRight;
@@ -237,11 +328,15 @@ Object* objCreateMesh( int material, const Vector bottomLeft, const Vector topRi
 	Mesh* mesh;
 	FILE* fp=NULL;
 
-	object = (Object *)malloc( sizeof(Object) );
-	mesh = (Mesh*)malloc( sizeof(Mesh) );
+	object = (Object *)memAlloc( MEM_SCENE, sizeof(Object) );
+	mesh = (Mesh*)memAlloc( MEM_SCENE, sizeof(Mesh) );
 
 	mesh->bottomLeft = bottomLeft;
 	mesh->topRight = topRight;
+	mesh->nvertices = 0;
+	mesh->ntriangles = 0;
+	mesh->coord = NULL;
+	mesh->triangle = NULL;
 
 	object->type = TYPE_MESH;
 	object->material = material;
@@ -254,12 +349,12 @@ Object* objCreateMesh( int material, const Vector bottomLeft, const Vector topRi
 		float xm,xM,ym,yM,zm,zM;
 
 		dummy = fscanf(fp,"%d",&mesh->nvertices);
-		mesh->coord = (float*)malloc(3*mesh->nvertices*sizeof(float));
+		mesh->coord = (float*)memAlloc(MEM_MESHES, 3*mesh->nvertices*sizeof(float));
 		for (i=0;i<mesh->nvertices;i++){
 			dummy = fscanf(fp," %f %f %f",&mesh->coord[3*i],&mesh->coord[3*i+1],&mesh->coord[3*i+2]);
 		}
 		dummy = fscanf(fp,"%d",&mesh->ntriangles);
-		mesh->triangle=(int*)malloc(3*mesh->ntriangles*sizeof(int));
+		mesh->triangle=(int*)memAlloc(MEM_MESHES, 3*mesh->ntriangles*sizeof(int));
 		for (i=0;i<mesh->ntriangles;i++){
 			dummy = fscanf(fp," %d %d %d",&mesh->triangle[3*i],&mesh->triangle[3*i+1],&mesh->triangle[3*i+2]);
 		}
@@ -335,91 +430,17 @@ double objMeshIntercept(Mesh* mesh,Vector origin,Vector direction,double distanc
 	return -1.0;
 }
 
-double objInterceptExitW( Object* object, Vector eye, Vector ray )
-{
-	switch (object->type){
-	case TYPE_SPHERE:
-		{
-			Sphere *s = (Sphere *)object->data;
-
-			double a, b, c, delta;
-			double distance = -1.0;
-
-			Vector fromSphereToEye;
-
-			fromSphereToEye = algSub( eye, s->center );
-
-			a = algDot( ray, ray );
-			b = ( 2.0 * algDot( ray, fromSphereToEye ) );
-			c = ( algDot( fromSphereToEye, fromSphereToEye ) - ( s->radius * s->radius ) );
-
-			delta = ( ( b * b ) - ( 4 * a * c ) );
-
-			if( fabs( delta ) <= EPSILON )
-			{
-				distance = ( -b / (2 * a ) );
-			}
-			else if( delta > EPSILON )
-			{
-				double root = sqrt( delta );
-				distance = MAX( ( ( -b + root ) / ( 2 * a ) ), ( ( -b - root ) / ( 2.0 * a ) )  );
-			}
-
-			return distance;
-		}
-	}
-	return 0;
-}
-
 double objIntercept( Object* object, Vector eye, Vector ray )
 {
 	if (!object) return -1;
 	switch( object->type )
 	{
-		Btree *bt;
-		Vector v;
-		double d1, d2, min;
-		double i0, i1, o0, o1;
 	case TYPE_BTREE:
-		bt = (Btree *)object->data;
-		if (bt->op == OP_UNION){
-			d1 = objIntercept( bt->left, eye, ray );
-			d2 = objIntercept( bt->right, eye, ray );
-			min = MIN( d1, d2 );
-			if (min < 0) return MAX( d1, d2 );
-			return min;
-		} else if (bt->op == OP_INTERSECT){
-			i0 = objIntercept( bt->left, eye, ray );
-			i1 = objIntercept( bt->right, eye, ray );
-			o0 = objInterceptExitW( bt->left, eye, ray );
-			o1 = objInterceptExitW( bt->right, eye, ray );
-
-			if ((i0 < i1) && (o0 > i1)) return i1;
-			if ((i1 < i0) && (o1 > i0)) return i0;
-			return -1;
-		} else if (bt->op == OP_DIFF){
-			i0 = objIntercept( bt->left, eye, ray );
-			i1 = objIntercept( bt->right, eye, ray );
-			o0 = objInterceptExitW( bt->left, eye, ray );
-			o1 = objInterceptExitW( bt->right, eye, ray );
-#if 1
-			if (i0 > i1) return i0;
-			if (o0 > i1) return o0;
-#else
-			if (i0 < i1) return i0;
-			if (o1 < o0) return o1;
-#endif
-			return -1;
-		}
-		 else if (bt->op == OP_INTERSECTSP){
-			i0 = objIntercept( bt->left, eye, ray );
-			i1 = objIntercept( bt->right, eye, ray );
-			o0 = algNorm(objInterceptExit( bt->left, eye, ray ));
-			o1 = algNorm(objInterceptExit( bt->right, eye, ray ));
+		{
+			Object* surface;
+			int flip;
 
-			if ((i0 < i1) && (o0 > i1)) return i1;
-			if ((i1 < i0) && (o1 > i0)) return i0;
-			return -1;
+			return objInterceptSurface( object, eye, ray, &surface, &flip );
 		}
 	case TYPE_SPHERE:
 		{
@@ -667,17 +688,55 @@ double objIntercept( Object* object, Vector eye, Vector ray )
 	}
 }
 
+double objInterceptSurface( Object* object, Vector eye, Vector ray, Object** surface, int* flip )
+{
+	Span spans[MAX_SPANS];
+	int i, n;
+
+	if( object == NULL || object->type != TYPE_BTREE )
+	{
+		*surface = object;
+		*flip = 0;
+		return objIntercept( object, eye, ray );
+	}
+
+	/* Primeira fronteira do slido  frente da origem do raio */
+	n = objSpans( object, eye, ray, spans );
+	for( i = 0; i < n; ++i )
+	{
+		const SpanEnd* end = ( spans[i].in.t > EPSILON ) ? &spans[i].in :
+							 ( spans[i].out.t > EPSILON ) ? &spans[i].out : NULL;
+
+		if( end != NULL )
+		{
+			*surface = end->leaf;
+			*flip = end->flip;
+			return end->t;
+		}
+	}
+
+	return -1.0;
+}
+
 Vector objInterceptExit( Object* object, Vector point, Vector d )
 {
 	switch( object->type )
 	{
-		Btree *bt;
-		Vector v1, v2;
 	case TYPE_BTREE:
-		bt = (Btree *)object->data;
-		v1 = objInterceptExit( bt->left, point, d );
-		v2 = objInterceptExit( bt->right, point, d );
-		return algNorm(v1) > algNorm(v2) ? v1 : v2;
+		{
+			Span spans[MAX_SPANS];
+			int i, n;
+
+			/* Sada do primeiro trecho do slido  frente do ponto */
+			n = objSpans( object, point, d, spans );
+			for( i = 0; i < n; ++i )
+			{
+				if( spans[i].out.t > EPSILON )
+					return algAdd( point, algScale( spans[i].out.t, d ) );
+			}
+
+			return point;
+		}
 	case TYPE_SPHERE:
 		{
 			Sphere *s = (Sphere *)object->data;
@@ -715,36 +774,9 @@ Vector objInterceptExit( Object* object, Vector point, Vector d )
 	return point;
 }
 
-int do_btree_check( Object *o, Vector point )
-{
-	if (o->type == TYPE_BTREE ){
-		Btree *bt = (Btree *)o->data;
-		do_btree_check( bt->left, point );
-		do_btree_check( bt->right, point );
-	} else if (o->type == TYPE_SPHERE){
-		Sphere *s = (Sphere *)o->data;
-		Vector v = algSub( point, s->center );
-
-		if ( fabs( s->radius - algNorm( v )) < EPSILON )
-			return 1;
-		return 0;
-	}
-	return -1;
-}
-
 Vector objNormalAt( Object* object, Vector point )
 {
-	if( object->type == TYPE_BTREE )
-	{
-		Btree *bt = (Btree *)object->data;
-
-		if (do_btree_check( bt->left, point ) > 0)
-			return objNormalAt( bt->left, point );
-		if (do_btree_check( bt->right, point ) > 0)
-			return objNormalAt( bt->right, point );
-		return algVector( 0, 0, 0, 1 );
-	}
-	else if( object->type == TYPE_SPHERE )
+	if( object->type == TYPE_SPHERE )
 	{
 		Sphere *sphere = (Sphere *)object->data;
 
@@ -802,24 +834,100 @@ Vector objTextureCoordinateAt( Object* object, Vector point )
 {
 	if( object->type == TYPE_SPHERE )
 	{
-   /*...*/
-		return algVector( 0, 0, 0, 1 );
+		/* Coordenadas esfricas: u ao longo do equador, v do polo sul ao norte */
+		Sphere *sphere = (Sphere *)object->data;
+		Vector d = algScale( ( 1.0 / sphere->radius ), algSub( point, sphere->center ) );
+		double y = ( d.y > 1.0 ) ? 1.0 : ( ( d.y < -1.0 ) ? -1.0 : d.y );
+
+		return algVector( 0.5 + atan2( d.x, d.z ) / ( 2.0 * M_PI ), 0.5 + asin( y ) / M_PI, 0, 1 );
 	} 
 	else if( object->type == TYPE_TRIANGLE )
 	{
-   /*...*/
-		return algVector( 0, 0, 0, 1 );
+		/* Interpola tex0..tex2 pelas coordenadas baricntricas de point */
+		Triangle *t = (Triangle *)object->data;
+		Vector e1 = algSub( t->v1, t->v0 );
+		Vector e2 = algSub( t->v2, t->v0 );
+		Vector p = algSub( point, t->v0 );
+		double d00 = algDot( e1, e1 );
+		double d01 = algDot( e1, e2 );
+		double d11 = algDot( e2, e2 );
+		double d20 = algDot( p, e1 );
+		double d21 = algDot( p, e2 );
+		double denom = d00 * d11 - d01 * d01;
+		double b1, b2;
+
+		if( fabs( denom ) < DBL_EPSILON )
+			return t->tex0;
+
+		b1 = ( d11 * d20 - d01 * d21 ) / denom;
+		b2 = ( d00 * d21 - d01 * d20 ) / denom;
+
+		return algVector( ( 1 - b1 - b2 ) * t->tex0.x + b1 * t->tex1.x + b2 * t->tex2.x,
+						  ( 1 - b1 - b2 ) * t->tex0.y + b1 * t->tex1.y + b2 * t->tex2.y, 0, 1 );
 	} 
 	else if( object->type == TYPE_BOX )
 	{
-   /*...*/
-		return algVector( 0, 0, 0, 1 );
+		/* Projeo planar na face atingida, normalizada pelas dimenses da face */
+		Box *box = (Box *)object->data;
+		Vector n = objNormalAt( object, point );
+		Vector size = algSub( box->topRight, box->bottomLeft );
+		Vector p = algSub( point, box->bottomLeft );
+		double sx = ( size.x > 0 ) ? p.x / size.x : 0;
+		double sy = ( size.y > 0 ) ? p.y / size.y : 0;
+		double sz = ( size.z > 0 ) ? p.z / size.z : 0;
+
+		if( n.x != 0 )
+			return algVector( sz, sy, 0, 1 );
+		else if( n.y != 0 )
+			return algVector( sx, sz, 0, 1 );
+		else
+			return algVector( sx, sy, 0, 1 );
 	} 
 
 	/* Tipo de Objeto Invlido: nunca deve acontecer */
 	return algVector( 0, 0, 0, 1 );	
 }
 
+double objTextureFootprint( Object* object, Vector point, double width )
+{
+	Vector n, a, t1, t2, uv, uv1, uv2;
+	double du1, du2, dv1, dv2;
+
+	n = objNormalAt( object, point );
+	if( algNorm( n ) == 0 )
+		return 0;
+
+	/* Base do plano tangente em point */
+	n = algUnit( n );
+	a = ( fabs( n.x ) < 0.9 ) ? algVector( 1, 0, 0, 1 ) : algVector( 0, 1, 0, 1 );
+	t1 = algUnit( algCross( n, a ) );
+	t2 = algCross( n, t1 );
+
+	uv = objTextureCoordinateAt( object, point );
+	uv1 = objTextureCoordinateAt( object, algAdd( point, algScale( width, t1 ) ) );
+	uv2 = objTextureCoordinateAt( object, algAdd( point, algScale( width, t2 ) ) );
+
+	du1 = wrapDistance( uv.x, uv1.x );
+	du2 = wrapDistance( uv.x, uv2.x );
+	dv1 = wrapDistance( uv.y, uv1.y );
+	dv2 = wrapDistance( uv.y, uv2.y );
+	return MAX( MAX( du1, du2 ), MAX( dv1, dv2 ) );
+}
+
+void objGetBounds( Object* object, Vector* boxMin, Vector* boxMax )
+{
+	if( object->type == TYPE_BTREE )
+	{
+		Btree *bt = (Btree *)object->data;
+
+		*boxMin = bt->boxMin;
+		*boxMax = bt->boxMax;
+		return;
+	}
+
+	objBounds( object, boxMin, boxMax );
+}
+
 int objGetMaterial( Object* object )
 {
 	if (object->type == TYPE_BTREE) {
@@ -835,12 +943,340 @@ int objGetMaterial( Object* object )
 
 void objDestroy( Object* o )
 {
-	if ( o ) return;
+	if ( !o ) return;
 	if ( o->type == TYPE_BTREE ){
 		Btree *bt = o->data;
 		objDestroy( bt->left );
 		objDestroy( bt->right );
 	}
-	free( o->data );
-	free( o );
+	if ( o->type == TYPE_MESH ){
+		Mesh *mesh = o->data;
+		memFree( mesh->coord );
+		memFree( mesh->triangle );
+	}
+	memFree( o->data );
+	memFree( o );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void objBounds( Object* object, Vector* boxMin, Vector* boxMax )
+{
+	switch( object->type )
+	{
+	case TYPE_BTREE:
+		{
+			Btree *bt = (Btree *)object->data;
+			Vector lmin, lmax, rmin, rmax;
+
+			if( bt->left == NULL || bt->right == NULL )
+			{
+				objBounds( bt->left ? bt->left : bt->right, boxMin, boxMax );
+				return;
+			}
+
+			objBounds( bt->left, &lmin, &lmax );
+			objBounds( bt->right, &rmin, &rmax );
+
+			if( bt->op == OP_UNION )
+			{
+				*boxMin = algVector( MIN( lmin.x, rmin.x ), MIN( lmin.y, rmin.y ), MIN( lmin.z, rmin.z ), 1 );
+				*boxMax = algVector( MAX( lmax.x, rmax.x ), MAX( lmax.y, rmax.y ), MAX( lmax.z, rmax.z ), 1 );
+			}
+			else if( bt->op == OP_DIFF )
+			{
+				*boxMin = lmin;
+				*boxMax = lmax;
+			}
+			else
+			{
+				*boxMin = algVector( MAX( lmin.x, rmin.x ), MAX( lmin.y, rmin.y ), MAX( lmin.z, rmin.z ), 1 );
+				*boxMax = algVector( MIN( lmax.x, rmax.x ), MIN( lmax.y, rmax.y ), MIN( lmax.z, rmax.z ), 1 );
+			}
+			return;
+		}
+
+	case TYPE_SPHERE:
+		{
+			Sphere *s = (Sphere *)object->data;
+
+			*boxMin = algVector( s->center.x - s->radius, s->center.y - s->radius, s->center.z - s->radius, 1 );
+			*boxMax = algVector( s->center.x + s->radius, s->center.y + s->radius, s->center.z + s->radius, 1 );
+			break;
+		}
+
+	case TYPE_TRIANGLE:
+		{
+			Triangle *t = (Triangle *)object->data;
+
+			*boxMin = algVector( MIN( t->v0.x, MIN( t->v1.x, t->v2.x ) ),
+								 MIN( t->v0.y, MIN( t->v1.y, t->v2.y ) ),
+								 MIN( t->v0.z, MIN( t->v1.z, t->v2.z ) ), 1 );
+			*boxMax = algVector( MAX( t->v0.x, MAX( t->v1.x, t->v2.x ) ),
+								 MAX( t->v0.y, MAX( t->v1.y, t->v2.y ) ),
+								 MAX( t->v0.z, MAX( t->v1.z, t->v2.z ) ), 1 );
+			break;
+		}
+
+	case TYPE_BOX:
+		{
+			Box *box = (Box *)object->data;
+
+			*boxMin = box->bottomLeft;
+			*boxMax = box->topRight;
+			break;
+		}
+
+	case TYPE_MESH:
+		{
+			Mesh *mesh = (Mesh *)object->data;
+
+			*boxMin = mesh->bottomLeft;
+			*boxMax = mesh->topRight;
+			break;
+		}
+
+	default:
+		*boxMin = algVector( 0, 0, 0, 1 );
+		*boxMax = algVector( 0, 0, 0, 1 );
+		return;
+	}
+
+	/* Folga para que superfcies planas no gerem caixas de espessura nula */
+	*boxMin = algVector( boxMin->x - EPSILON, boxMin->y - EPSILON, boxMin->z - EPSILON, 1 );
+	*boxMax = algVector( boxMax->x + EPSILON, boxMax->y + EPSILON, boxMax->z + EPSILON, 1 );
+}
+
+int objBoxIntercept( Vector boxMin, Vector boxMax, Vector eye, Vector ray,
+					double* tmin, double* tmax )
+{
+	double lo = -DBL_MAX;
+	double hi = DBL_MAX;
+	double o[3], d[3], bmin[3], bmax[3];
+	int i;
+
+	o[0] = eye.x;  o[1] = eye.y;  o[2] = eye.z;
+	d[0] = ray.x;  d[1] = ray.y;  d[2] = ray.z;
+	bmin[0] = boxMin.x;  bmin[1] = boxMin.y;  bmin[2] = boxMin.z;
+	bmax[0] = boxMax.x;  bmax[1] = boxMax.y;  bmax[2] = boxMax.z;
+
+	for( i = 0; i < 3; ++i )
+	{
+		if( fabs( d[i] ) < 1.0e-12 )
+		{
+			/* Raio paralelo s faces: precisa estar entre elas */
+			if( o[i] < bmin[i] || o[i] > bmax[i] )
+				return 0;
+		}
+		else
+		{
+			double t0 = ( bmin[i] - o[i] ) / d[i];
+			double t1 = ( bmax[i] - o[i] ) / d[i];
+
+			if( t0 > t1 ) { double tmp = t0; t0 = t1; t1 = tmp; }
+			if( t0 > lo ) lo = t0;
+			if( t1 < hi ) hi = t1;
+			if( lo > hi )
+				return 0;
+		}
+	}
+
+	*tmin = lo;
+	*tmax = hi;
+	return 1;
+}
+
+static int objSpans( Object* object, Vector eye, Vector ray, Span* spans )
+{
+	switch( object->type )
+	{
+	case TYPE_BTREE:
+		{
+			Btree *bt = (Btree *)object->data;
+			Span left[MAX_SPANS], right[MAX_SPANS];
+			int nl = 0, nr = 0;
+			double tmin, tmax;
+
+			/* Raios que no atingem a caixa do n (ou a tm atrs de si) no descem na rvore */
+			if( !objBoxIntercept( bt->boxMin, bt->boxMax, eye, ray, &tmin, &tmax ) || tmax < 0 )
+				return 0;
+
+			if( bt->left )
+				nl = objSpans( bt->left, eye, ray, left );
+
+			/* Interseo e diferena com o primeiro operando vazio so vazias */
+			if( nl == 0 && bt->op != OP_UNION )
+				return 0;
+
+			if( bt->right )
+				nr = objSpans( bt->right, eye, ray, right );
+
+			switch( bt->op )
+			{
+			case OP_UNION:
+				return spanUnion( left, nl, right, nr, spans );
+			case OP_INTERSECT:
+			case OP_INTERSECTSP:
+				return spanIntersect( left, nl, right, nr, spans );
+			case OP_DIFF:
+				return spanDiff( left, nl, right, nr, spans );
+			}
+			return 0;
+		}
+
+	case TYPE_SPHERE:
+		{
+			Sphere *s = (Sphere *)object->data;
+			Vector fromSphereToEye = algSub( eye, s->center );
+			double a, b, c, delta, root;
+
+			a = algDot( ray, ray );
+			b = ( 2.0 * algDot( ray, fromSphereToEye ) );
+			c = ( algDot( fromSphereToEye, fromSphereToEye ) - ( s->radius * s->radius ) );
+
+			delta = ( ( b * b ) - ( 4 * a * c ) );
+			if( delta < 0 )
+				return 0;
+
+			root = sqrt( delta );
+			spans[0].in.t = ( ( -b - root ) / ( 2.0 * a ) );
+			spans[0].out.t = ( ( -b + root ) / ( 2.0 * a ) );
+			spans[0].in.leaf = spans[0].out.leaf = object;
+			spans[0].in.flip = spans[0].out.flip = 0;
+			return 1;
+		}
+
+	case TYPE_BOX:
+		{
+			Box *box = (Box *)object->data;
+			double tmin, tmax;
+
+			if( !objBoxIntercept( box->bottomLeft, box->topRight, eye, ray, &tmin, &tmax ) )
+				return 0;
+
+			spans[0].in.t = tmin;
+			spans[0].out.t = tmax;
+			spans[0].in.leaf = spans[0].out.leaf = object;
+			spans[0].in.flip = spans[0].out.flip = 0;
+			return 1;
+		}
+
+	default:
+		{
+			/* Superfcies abertas: intervalo de comprimento nulo no ponto atingido */
+			double distance = objIntercept( object, eye, ray );
+
+			if( distance <= 0 )
+				return 0;
+
+			spans[0].in.t = spans[0].out.t = distance;
+			spans[0].in.leaf = spans[0].out.leaf = object;
+			spans[0].in.flip = spans[0].out.flip = 0;
+			return 1;
+		}
+	}
+}
+
+static int spanUnion( const Span* a, int na, const Span* b, int nb, Span* out )
+{
+	int i = 0, j = 0, n = 0;
+
+	/* Intercala as listas por distncia de entrada, fundindo intervalos sobrepostos */
+	while( i < na || j < nb )
+	{
+		Span s = ( j >= nb || ( i < na && a[i].in.t <= b[j].in.t ) ) ? a[i++] : b[j++];
+
+		if( n > 0 && s.in.t <= out[n-1].out.t )
+		{
+			if( s.out.t > out[n-1].out.t )
+				out[n-1].out = s.out;
+		}
+		else if( n < MAX_SPANS )
+		{
+			out[n++] = s;
+		}
+	}
+
+	return n;
+}
+
+static int spanIntersect( const Span* a, int na, const Span* b, int nb, Span* out )
+{
+	int i = 0, j = 0, n = 0;
+
+	while( i < na && j < nb )
+	{
+		SpanEnd in = ( a[i].in.t > b[j].in.t ) ? a[i].in : b[j].in;
+		SpanEnd exit = ( a[i].out.t < b[j].out.t ) ? a[i].out : b[j].out;
+
+		if( in.t <= exit.t && n < MAX_SPANS )
+		{
+			out[n].in = in;
+			out[n].out = exit;
+			n++;
+		}
+
+		/* Avana o intervalo que termina primeiro */
+		if( a[i].out.t < b[j].out.t ) i++;
+		else j++;
+	}
+
+	return n;
+}
+
+static int spanDiff( const Span* a, int na, const Span* b, int nb, Span* out )
+{
+	int i, j, n = 0;
+
+	for( i = 0; i < na; ++i )
+	{
+		SpanEnd in = a[i].in;
+		int inside = 1;
+
+		for( j = 0; j < nb && inside; ++j )
+		{
+			/* Intervalos subtrados que no se sobrepem a [in, a[i].out] */
+			if( b[j].out.t < in.t || b[j].in.t > a[i].out.t )
+				continue;
+
+			/* Trecho antes do intervalo subtrado: sai pela superfcie dele, invertida */
+			if( b[j].in.t > in.t && n < MAX_SPANS )
+			{
+				out[n].in = in;
+				out[n].out = b[j].in;
+				out[n].out.flip = !out[n].out.flip;
+				n++;
+			}
+
+			/* Continua depois do intervalo subtrado, entrando pela superfcie dele */
+			if( b[j].out.t < a[i].out.t )
+			{
+				in = b[j].out;
+				in.flip = !in.flip;
+			}
+			else
+			{
+				inside = 0;
+			}
+		}
+
+		if( inside && n < MAX_SPANS )
+		{
+			out[n].in = in;
+			out[n].out = a[i].out;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static double wrapDistance( double a, double b )
+{
+	double d = fabs( a - b );
+
+	d -= floor( d );
+	return ( d > 0.5 ) ? 1.0 - d : d;
 }
@@ -112,12 +112,31 @@ Object* objCreateMesh( int material, const Vector bottomLeft, const Vector topRi
  */
 double objIntercept( Object* object, Vector eye, Vector ray );
 
+/**
+ *	Calcula a que distncia um raio intercepta um objeto e qual superfcie foi atingida.
+ *	Em rvores CSG a superfcie  a da primitiva cuja fronteira o raio cruza;
+ *	nos demais objetos  o prprio objeto.
+ *
+ *	@param object Handle para um objeto.
+ *	@param eye Origem do raio.
+ *	@param ray Direo do raio.
+ *	@param surface [out] Primitiva atingida, a ser usada em objNormalAt,
+ *				objTextureCoordinateAt e objTextureFootprint.
+ *	@param flip [out] No-zero se a normal da primitiva deve ser invertida
+ *				(superfcies de objetos subtrados).
+ *
+ *	@return A mesma distncia de objIntercept. Se no houver interseo,
+ *				surface e flip podem no ser modificados.
+ */
+double objInterceptSurface( Object* object, Vector eye, Vector ray, Object** surface, int* flip );
+
 Vector objInterceptExit( Object* object, Vector point, Vector d );
 
 /**
  *	Calcula o vetor normal a um objeto em um ponto.
  *
- *	@param object Handle para um objeto.
+ *	@param object Handle para um objeto (em rvores CSG, a primitiva obtida
+ *				com objInterceptSurface).
  *	@param point Ponto na superfcie do objeto onde a normal deve ser calculada.
  *
  *	@return Vetor unitrio, normal ao objeto, com origem em point.
@@ -135,6 +154,39 @@ Vector objNormalAt( Object* object, Vector point );
  */
 Vector objTextureCoordinateAt( Object* object, Vector point );
 
+/**
+ *	Estima quanto das coordenadas de textura  coberto por uma regio da superfcie,
+ *	avaliando objTextureCoordinateAt em dois pontos deslocados de 'width' ao longo
+ *	do plano tangente. Usado para escolher o nvel de mipmap da textura.
+ *
+ *	@param object Handle para um objeto.
+ *	@param point Ponto na superfcie do objeto.
+ *	@param width Largura da regio (por exemplo, a seo do cone de um raio).
+ *
+ *	@return Maior variao das coordenadas de textura (em [0, 0.5], j que as
+ *			texturas se repetem a cada unidade).
+ */
+double objTextureFootprint( Object* object, Vector point, double width );
+
+/**
+ *	Obtm a caixa envolvente, alinhada aos eixos, de um objeto.
+ *	Para rvores CSG  a caixa calculada em objCreateBtree.
+ *
+ *	@param object Handle para um objeto.
+ *	@param boxMin [out] Canto inferior da caixa.
+ *	@param boxMax [out] Canto superior da caixa.
+ */
+void objGetBounds( Object* object, Vector* boxMin, Vector* boxMax );
+
+/**
+ *	Calcula o trecho [tmin, tmax] de um raio que est dentro de uma caixa
+ *	alinhada aos eixos. As distncias so medidas em unidades de 'ray'.
+ *
+ *	@return No-zero se a reta do raio atravessa a caixa (tmin pode ser negativo).
+ */
+int objBoxIntercept( Vector boxMin, Vector boxMax, Vector eye, Vector ray,
+					double* tmin, double* tmax );
+
 /**
  *	Obtm o Material* de um objeto.
  */
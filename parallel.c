@@ -0,0 +1,346 @@
+/**
+ *	@file parallel.c Parallel: laos paralelos simples sobre um intervalo de ndices.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <stdlib.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#include "parallel.h"
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Trecho de um lao paralelo entregue a uma thread.
+ */
+typedef struct
+{
+	ParBody body;
+	void* context;
+	/** ndice da thread (ver parGetThreadIndex) */
+	int index;
+	int begin;
+	int end;
+} ParChunk;
+
+/**
+ *   Thread iniciada com parStart.
+ */
+struct _ParThread
+{
+#ifdef WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	ParTask task;
+	void* context;
+};
+
+/**
+ *   Mutex criado com parMutexCreate.
+ */
+struct _ParMutex
+{
+#ifdef WIN32
+	CRITICAL_SECTION section;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** Nmero de threads definido por parSetThreads (0 = padro) */
+static int parThreads = 0;
+
+/** ndice da thread corrente (ver parGetThreadIndex) */
+static PAR_THREAD_LOCAL int parIndex = 0;
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+#ifdef WIN32
+static DWORD WINAPI parRun( LPVOID chunk );
+static DWORD WINAPI parRunTask( LPVOID thread );
+#else
+static void* parRun( void* chunk );
+static void* parRunTask( void* thread );
+#endif
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+void parFor( int n, ParBody body, void* context )
+{
+	ParChunk chunks[MAX_THREADS];
+	int started[MAX_THREADS];
+	int threads = parGetThreads();
+	int i;
+#ifdef WIN32
+	HANDLE handles[MAX_THREADS];
+#else
+	pthread_t handles[MAX_THREADS];
+#endif
+
+	if( threads > n )
+		threads = n;
+
+	if( threads <= 1 )
+	{
+		if( n > 0 )
+			body( context, 0, n );
+		return;
+	}
+
+	for( i = 0; i < threads; ++i )
+	{
+		chunks[i].body = body;
+		chunks[i].context = context;
+		chunks[i].index = i;
+		chunks[i].begin = (int)( (long)n * i / threads );
+		chunks[i].end = (int)( (long)n * ( i + 1 ) / threads );
+	}
+
+	/* O primeiro trecho  executado pela prpria thread chamadora, assim como
+	   os trechos cuja thread no pde ser criada */
+	for( i = 1; i < threads; ++i )
+	{
+#ifdef WIN32
+		handles[i] = CreateThread( NULL, 0, parRun, &chunks[i], 0, NULL );
+		started[i] = ( handles[i] != NULL );
+#else
+		started[i] = ( pthread_create( &handles[i], NULL, parRun, &chunks[i] ) == 0 );
+#endif
+		if( !started[i] )
+			body( context, chunks[i].begin, chunks[i].end );
+	}
+
+	body( context, chunks[0].begin, chunks[0].end );
+
+	for( i = 1; i < threads; ++i )
+	{
+		if( !started[i] )
+			continue;
+#ifdef WIN32
+		WaitForSingleObject( handles[i], INFINITE );
+		CloseHandle( handles[i] );
+#else
+		pthread_join( handles[i], NULL );
+#endif
+	}
+}
+
+void parSetThreads( int threads )
+{
+	parThreads = ( threads < 0 ) ? 0 : ( ( threads > MAX_THREADS ) ? MAX_THREADS : threads );
+}
+
+int parGetThreads( void )
+{
+	int threads = parThreads;
+
+	if( threads == 0 )
+	{
+#ifdef WIN32
+		SYSTEM_INFO info;
+
+		GetSystemInfo( &info );
+		threads = (int)info.dwNumberOfProcessors;
+#else
+		threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+	}
+
+	return ( threads < 1 ) ? 1 : ( ( threads > MAX_THREADS ) ? MAX_THREADS : threads );
+}
+
+int parGetThreadIndex( void )
+{
+	return parIndex;
+}
+
+ParThread* parStart( ParTask task, void* context )
+{
+	ParThread* thread = (ParThread*)malloc( sizeof(ParThread) );
+
+	thread->task = task;
+	thread->context = context;
+
+#ifdef WIN32
+	thread->handle = CreateThread( NULL, 0, parRunTask, thread, 0, NULL );
+	if( thread->handle == NULL )
+#else
+	if( pthread_create( &thread->handle, NULL, parRunTask, thread ) != 0 )
+#endif
+	{
+		free( thread );
+		task( context );
+		return NULL;
+	}
+
+	return thread;
+}
+
+long parAtomicAdd( volatile long* counter, long delta )
+{
+#ifdef WIN32
+	return InterlockedExchangeAdd( counter, delta );
+#else
+	return __sync_fetch_and_add( counter, delta );
+#endif
+}
+
+long long parAtomicAdd64( volatile long long* counter, long long delta )
+{
+#ifdef WIN32
+	return InterlockedExchangeAdd64( counter, delta );
+#else
+	return __sync_fetch_and_add( counter, delta );
+#endif
+}
+
+void parAtomicMax64( volatile long long* counter, long long value )
+{
+	long long current = parAtomicAdd64( counter, 0 );
+
+	/* Repete enquanto outra thread mudar o contador entre a leitura e a troca */
+	while( value > current )
+	{
+#ifdef WIN32
+		long long seen = InterlockedCompareExchange64( counter, value, current );
+#else
+		long long seen = __sync_val_compare_and_swap( counter, current, value );
+#endif
+		if( seen == current )
+			break;
+		current = seen;
+	}
+}
+
+ParMutex* parMutexCreate( void )
+{
+	ParMutex* mutex = (ParMutex*)malloc( sizeof(ParMutex) );
+
+#ifdef WIN32
+	InitializeCriticalSection( &mutex->section );
+#else
+	pthread_mutex_init( &mutex->mutex, NULL );
+#endif
+	return mutex;
+}
+
+void parLock( ParMutex* mutex )
+{
+#ifdef WIN32
+	EnterCriticalSection( &mutex->section );
+#else
+	pthread_mutex_lock( &mutex->mutex );
+#endif
+}
+
+void parUnlock( ParMutex* mutex )
+{
+#ifdef WIN32
+	LeaveCriticalSection( &mutex->section );
+#else
+	pthread_mutex_unlock( &mutex->mutex );
+#endif
+}
+
+void parMutexDestroy( ParMutex* mutex )
+{
+#ifdef WIN32
+	DeleteCriticalSection( &mutex->section );
+#else
+	pthread_mutex_destroy( &mutex->mutex );
+#endif
+	free( mutex );
+}
+
+double parGetTime( void )
+{
+#ifdef WIN32
+	LARGE_INTEGER count, frequency;
+
+	QueryPerformanceCounter( &count );
+	QueryPerformanceFrequency( &frequency );
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timeval now;
+
+	gettimeofday( &now, NULL );
+	return now.tv_sec + now.tv_usec * 1e-6;
+#endif
+}
+
+double parGetTicks( void )
+{
+#if defined(_MSC_VER) && ( defined(_M_IX86) || defined(_M_X64) )
+	return (double)__rdtsc();
+#elif defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+	return (double)__builtin_ia32_rdtsc();
+#else
+	return parGetTime() * 1e9;
+#endif
+}
+
+void parJoin( ParThread* thread )
+{
+	if( thread == NULL )
+		return;
+
+#ifdef WIN32
+	WaitForSingleObject( thread->handle, INFINITE );
+	CloseHandle( thread->handle );
+#else
+	pthread_join( thread->handle, NULL );
+#endif
+	free( thread );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+#ifdef WIN32
+static DWORD WINAPI parRun( LPVOID chunk )
+#else
+static void* parRun( void* chunk )
+#endif
+{
+	ParChunk* c = (ParChunk*)chunk;
+
+	parIndex = c->index;
+	c->body( c->context, c->begin, c->end );
+	return 0;
+}
+
+#ifdef WIN32
+static DWORD WINAPI parRunTask( LPVOID thread )
+#else
+static void* parRunTask( void* thread )
+#endif
+{
+	ParThread* t = (ParThread*)thread;
+
+	parIndex = -1;
+	t->task( t->context );
+	return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ *	@file parallel.h Parallel: laos paralelos simples sobre um intervalo de ndices.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+
+/************************************************************************/
+/* Constantes Exportadas                                                */
+/************************************************************************/
+/** Nmero mximo de threads usadas por parFor */
+#define MAX_THREADS	64
+
+/** Qualificador de variveis globais com uma cpia por thread */
+#ifdef _MSC_VER
+#define PAR_THREAD_LOCAL	__declspec( thread )
+#else
+#define PAR_THREAD_LOCAL	__thread
+#endif
+
+
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+/**
+ *	Corpo de um lao paralelo: processa os ndices [begin, end).
+ *
+ *	@param context Dados do lao, repassados de parFor.
+ *	@param begin Primeiro ndice do trecho.
+ *	@param end ndice seguinte ao ltimo do trecho.
+ */
+typedef void (*ParBody)( void* context, int begin, int end );
+
+/**
+ *	Corpo de uma thread iniciada com parStart.
+ *
+ *	@param context Dados repassados de parStart.
+ */
+typedef void (*ParTask)( void* context );
+
+/**
+ *	Thread iniciada com parStart.
+ */
+typedef struct _ParThread ParThread;
+
+/**
+ *	Mutex criado com parMutexCreate.
+ */
+typedef struct _ParMutex ParMutex;
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Executa body sobre os ndices [0, n), dividindo-os em trechos contguos de
+ *	tamanho parecido, um por thread. Retorna quando todos os trechos terminam.
+ *	Com uma thread (ou n pequeno) body  chamado diretamente, sem criar threads.
+ *
+ *	@param n Nmero de ndices.
+ *	@param body Funo chamada para cada trecho.
+ *	@param context Dados repassados a body.
+ */
+void parFor( int n, ParBody body, void* context );
+
+/**
+ *	Define o nmero de threads usadas por parFor (0 volta ao padro: o nmero de
+ *	processadores da mquina).
+ */
+void parSetThreads( int threads );
+
+/**
+ *	Obtm o nmero de threads usadas por parFor.
+ */
+int parGetThreads( void );
+
+/**
+ *	Obtm o ndice da thread corrente no parFor que a criou: de 1 ao nmero de
+ *	threads menos um (a thread chamadora executa o trecho 0 e continua com o
+ *	ndice que j tinha). Fora de parFor  0, e -1 nas threads de parStart.
+ */
+int parGetThreadIndex( void );
+
+/**
+ *	Executa task numa nova thread, em paralelo com a chamadora.
+ *
+ *	@param task Funo executada pela thread.
+ *	@param context Dados repassados a task.
+ *
+ *	@return Handle da thread (esperar com parJoin), ou NULL se no foi possvel
+ *			cri-la; nesse caso task  executada antes do retorno.
+ */
+ParThread* parStart( ParTask task, void* context );
+
+/**
+ *	Espera o trmino de uma thread iniciada com parStart e libera seu handle.
+ *	No faz nada se thread for NULL.
+ */
+void parJoin( ParThread* thread );
+
+/**
+ *	Soma delta a um contador compartilhado entre threads, atomicamente.
+ *
+ *	@return Valor do contador antes da soma.
+ */
+long parAtomicAdd( volatile long* counter, long delta );
+
+/**
+ *	Como parAtomicAdd, para contadores de 64 bits (long tem 32 bits no Windows).
+ *
+ *	@return Valor do contador antes da soma.
+ */
+long long parAtomicAdd64( volatile long long* counter, long long delta );
+
+/**
+ *	Troca o valor de um contador de 64 bits compartilhado entre threads por
+ *	value, se value for maior, atomicamente.
+ */
+void parAtomicMax64( volatile long long* counter, long long value );
+
+/**
+ *	Cria um mutex.
+ */
+ParMutex* parMutexCreate( void );
+
+/**
+ *	Obtm o mutex, esperando se outra thread o tiver.
+ */
+void parLock( ParMutex* mutex );
+
+/**
+ *	Libera o mutex obtido com parLock.
+ */
+void parUnlock( ParMutex* mutex );
+
+/**
+ *	Destri um mutex criado com parMutexCreate.
+ */
+void parMutexDestroy( ParMutex* mutex );
+
+/**
+ *	Obtm o tempo de relgio (no o de processador, que soma todas as threads),
+ *	em segundos a partir de uma origem arbitrria.
+ */
+double parGetTime( void );
+
+/**
+ *	Obtm o contador de ciclos do processador (rdtsc), para medir trechos curtos
+ *	de cdigo. Onde ele no existe, retorna parGetTime em nanossegundos.
+ *	Valores de threads diferentes s so comparveis se o contador for sincronizado
+ *	entre os ncleos (o caso dos processadores x86 atuais).
+ */
+double parGetTicks( void );
+
+#endif
@@ -15,6 +15,7 @@
 #include "raytracing.h"
 #include "color.h"
 #include "algebra.h"
+#include "parallel.h"
 
 
 /************************************************************************/
@@ -22,27 +23,182 @@
 /************************************************************************/
 #define MAX( a, b ) ( ( a > b ) ? a : b )
 
-/** Nmero mximo de recurses permitidas */
-#define MAX_DEPTH	6
+/**
+ *	Tamanho da pilha explcita de raios. Cada nvel da rvore deixa no mximo
+ *	um raio irmo pendente, ento 2*MAX_RAY_DEPTH entradas bastam.
+ */
+#define RAY_STACK_SIZE	( 2 * MAX_RAY_DEPTH )
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *	Raio pendente na pilha de avaliao da rvore de raios.
+ */
+typedef struct
+{
+	/**
+	 *  Origem do raio.
+	 */
+	Vector eye;
+	/**
+	 *  Direo do raio.
+	 */
+	Vector ray;
+	/**
+	 *  Peso acumulado (produto dos fatores de reflexo/transparncia) com que
+	 *  a cor deste raio contribui para o pixel.
+	 */
+	double weight;
+	/**
+	 *  Comprimento do caminho percorrido desde o olho at a origem do raio.
+	 *  Junto com o ngulo de um pixel, d a largura do cone do raio (ver shade).
+	 */
+	double length;
+	/**
+	 *  Nvel do raio na rvore (0 para o raio primrio).
+	 */
+	int depth;
+	/**
+	 *  ndice do pixel (no lote) para o qual o raio contribui. Usado pelo modo wavefront.
+	 */
+	int pixel;
+} RayTask;
+
+/**
+ *	Chave de ordenao de um raio dentro de uma onda (modo wavefront).
+ */
+typedef struct
+{
+	/**
+	 *  Octante da direo nos 3 bits altos e cdigo de Morton da origem nos 24 bits baixos.
+	 */
+	unsigned int key;
+	/**
+	 *  ndice do raio na onda.
+	 */
+	int index;
+} WaveKey;
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** Contadores de raios traados e podados e de testes de interseo, somados de todas as threads */
+static volatile long long tracedTotal = 0;
+static volatile long long prunedTotal = 0;
+static volatile long long testsTotal = 0;
+
+/** Contadores da thread corrente, somados aos totais ao fim de cada funo exportada */
+static PAR_THREAD_LOCAL RayStats stats;
+
+/** Estado do gerador pseudo-aleatrio usado pela roleta russa (um por thread) */
+static PAR_THREAD_LOCAL unsigned int rouletteSeed = 2463534242u;
 
 
 /************************************************************************/
 /* Funes Privadas                                                     */
 /************************************************************************/
 /**
- *	Obtm uma cor atravs do traado de um raio dentro de uma cena.
+ *	Traa um raio: encontra o objeto mais prximo e calcula sua iluminao local,
+ *	ou a cor de fundo se nenhum objeto for atingido. Os raios secundrios gerados
+ *	so acrescentados a out.
  *
  *	@param scene Handle para a cena sendo renderizada.
- *	@param eye Posio do observador, origem do raio.
- *	@param ray Direo do raio.
- *	@param depth Para controle do nmero mximo de recurses. Funes clientes devem
- *					passar 0 (zero). A cada recurso depth  incrementado at, no mximo,
- *					MAX_DEPTH. Quando MAX_DEPTH  atingido, recurses so ignoradas.
+ *	@param task Raio sendo traado.
+ *	@param out Vetor onde so acrescentados os raios secundrios (pilha ou prxima onda).
+ *	@param count [in/out] Nmero de raios em out.
+ *
+ *	@return Cor local, sem o peso do raio.
+ */
+static Color traceTask( Scene* scene, const RayTask* task, RayTask* out, int* count );
+
+/**
+ *	Como traceTask, para o raio primrio do pixel (x, y): se ele no atingir
+ *	nenhum objeto, a cor  o prprio pixel da imagem de fundo.
+ */
+static Color tracePrimary( Scene* scene, const RayTask* task, int x, int y, RayTask* out, int* count );
+
+/**
+ *	Calcula a iluminao de um raio que atingiu um objeto a uma certa distncia
+ *	(a parte de traceTask aps a busca do objeto mais prximo).
+ *
+ *	@param object Objeto atingido (d o material).
+ *	@param surface Primitiva atingida (d a normal e as coordenadas de textura).
+ *	@param flip No-zero se a normal da primitiva deve ser invertida.
+ */
+static Color traceHit( Scene* scene, const RayTask* task, Object* object, Object* surface, int flip,
+					  double distance, RayTask* out, int* count );
+
+/**
+ *	Avalia todos os raios de uma pilha, em profundidade, at esvazi-la.
+ *
+ *	@return Soma das cores dos raios, ponderadas por seus pesos.
+ */
+static Color traceStack( Scene* scene, RayTask* stack, int top );
+
+/**
+ *	Ordena uma onda de raios secundrios por octante da direo e posio da origem,
+ *	para que raios vizinhos no vetor percorram a cena de forma coerente.
+ *
+ *	@param wave Raios da onda (reordenados no lugar).
+ *	@param count Nmero de raios na onda.
+ */
+static void sortWave( RayTask* wave, int count );
+
+/**
+ *	Calcula a iluminao local de um ponto e empilha os raios secundrios
+ *	(reflexo e transparncia) que ele gera.
+ *
+ *	@param scene Handle para a cena sendo renderizada.
+ *	@param task Raio que atingiu o objeto.
+ *	@param object Objeto atingido.
+ *	@param surface Primitiva atingida (em rvores CSG, uma folha de object).
+ *	@param point Ponto de interseo.
+ *	@param normal Normal ao objeto em point.
+ *	@param stack Pilha de raios pendentes.
+ *	@param top [in/out] Topo da pilha.
+ *
+ *	@return Cor local do ponto, sem o peso do raio.
+ */
+static Color shade( Scene* scene, const RayTask* task, Object* object, Object* surface, Vector point,
+					     Vector normal, RayTask* stack, int* top );
+
+/**
+ *	Obtm a cor difusa de um material em um ponto. Materiais com textura so
+ *	amostrados com o nvel de mipmap dado pela seo do cone do raio no ponto:
+ *	largura = (caminho percorrido) x (ngulo de um pixel), alargada pela
+ *	inclinao da superfcie em relao ao raio.
+ *
+ *	@param scene Cena.
+ *	@param task Raio que atingiu o objeto.
+ *	@param surface Primitiva atingida.
+ *	@param material Material do objeto.
+ *	@param point Ponto de interseo.
+ *	@param normal Normal ao objeto em point.
+ *
+ *	@return Cor difusa em point.
+ */
+static Color diffuseAt( Scene* scene, const RayTask* task, Object* surface, Material* material,
+					   Vector point, Vector normal );
+
+/**
+ *	Empilha um raio secundrio se sua contribuio acumulada justificar o traado.
+ *	Raios com peso abaixo da contribuio mnima da cena so descartados ou,
+ *	se a roleta russa estiver ligada, sobrevivem com probabilidade proporcional
+ *	ao peso e tm o peso compensado (o valor esperado no muda).
  *
- *	@return Cor resultante do traado do raio.
+ *	@param scene Cena.
+ *	@param parent Raio que gerou o novo raio.
+ *	@param eye Origem do raio.
+ *	@param ray Direo do raio.
+ *	@param weight Peso acumulado do raio.
+ *	@param stack Pilha de raios pendentes.
+ *	@param top [in/out] Topo da pilha.
  */
-static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector point,
-					     Vector normal, int depth );
+static void spawnRay( Scene* scene, const RayTask* parent, Vector eye, Vector ray, double weight,
+					 RayTask* stack, int* top );
 
 /**
  *	Encontra o primeiro objeto interceptado pelo raio originado na posio especificada.
@@ -51,11 +207,14 @@ static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector
  *	@param eye Posio do Observador (origem).
  *	@param ray Raio sendo traado (direo).
  *	@param object Onde  retornado o objeto resultante. No pode ser NULL.
+ *	@param surface Onde  retornada a primitiva atingida (ver objInterceptSurface).
+ *	@param flip Onde  retornado se a normal da primitiva deve ser invertida.
  *	@return Distncia entre 'eye' e a superfcie do objeto interceptado pelo raio.
  *			DBL_MAX se nenhum objeto  interceptado pelo raio, neste caso
  *				'object' no  modificado.
  */
-static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object* *object );
+static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object* *object,
+							   Object* *surface, int* flip );
 
 /**
  *	Checa se objetos em uma cena impedem a luz de alcanar um ponto.
@@ -68,42 +227,275 @@ static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object* *o
  */
 static int isInShadow( Scene* scene, Vector point, Vector rayToLight, Vector lightLocation );
 
+/**
+ *	Soma os contadores da thread corrente aos totais e os zera. Uma operao
+ *	atmica por chamada exportada, em vez de uma por raio.
+ */
+static void flushStats( void );
+
+/**
+ *	Calcula a cor de um pixel da tela (ver rayTracePixel), sem somar os
+ *	contadores da thread aos totais.
+ */
+static Color tracePixel( Scene* scene, int x, int y );
+
 
 /************************************************************************/
 /* Definio das Funes Exportadas                                     */
 /************************************************************************/
 
 Color rayTrace( Scene* scene, Vector eye, Vector ray, int depth )
+{
+	RayTask stack[RAY_STACK_SIZE];
+	int top = 0;
+	Color color;
+
+	stats.traced++;
+	stack[top].eye = eye;
+	stack[top].ray = ray;
+	stack[top].weight = 1.0;
+	stack[top].length = 0.0;
+	stack[top].depth = depth;
+	stack[top].pixel = 0;
+	top++;
+
+	color = traceStack( scene, stack, top );
+	flushStats();
+	return color;
+}
+
+Color rayTracePixel( Scene* scene, int x, int y )
+{
+	Color color = tracePixel( scene, x, y );
+
+	flushStats();
+	return color;
+}
+
+Color rayTracePixelStats( Scene* scene, int x, int y, RayStats* pixel )
+{
+	Color color = tracePixel( scene, x, y );
+
+	/* Os contadores da thread esto zerados desde o ltimo flushStats */
+	*pixel = stats;
+	flushStats();
+	return color;
+}
+
+void rayTraceBatch( Scene* scene, int n, const Vector* eyes, const Vector* rays, int y0, int width,
+				   Color* colors )
+{
+	RayTask* wave = (RayTask*)malloc( n * sizeof(RayTask) );
+	int count = n;
+	int i;
+
+	/* Onda inicial: os raios fornecidos, na ordem em que vieram */
+	for( i = 0; i < n; ++i )
+	{
+		wave[i].eye = eyes[i];
+		wave[i].ray = rays[i];
+		wave[i].weight = 1.0;
+		wave[i].length = 0.0;
+		wave[i].depth = 0;
+		wave[i].pixel = i;
+
+		colors[i].red = colors[i].green = colors[i].blue = 0.f;
+	}
+	stats.traced += n;
+
+	/* Cada nvel da rvore de raios  uma onda traada de uma vez */
+	while( count > 0 )
+	{
+		/* Cada raio gera no mximo dois raios secundrios */
+		RayTask* next = (RayTask*)malloc( 2 * count * sizeof(RayTask) );
+		int nextCount = 0;
+
+		if( wave[0].depth > 0 )
+		{
+			sortWave( wave, count );
+		}
+
+		for( i = 0; i < count; ++i )
+		{
+			const RayTask* task = &wave[i];
+			Color local;
+
+			if( task->depth == 0 )
+				local = tracePrimary( scene, task, task->pixel % width, y0 + task->pixel / width, next, &nextCount );
+			else
+				local = traceTask( scene, task, next, &nextCount );
+
+			colors[task->pixel] = colorAddition( colors[task->pixel], colorScale( task->weight, local ) );
+		}
+
+		free( wave );
+		wave = next;
+		count = nextCount;
+	}
+
+	free( wave );
+	flushStats();
+}
+
+RayStats rayGetStats( void )
+{
+	RayStats total;
+
+	total.traced = (unsigned long long)parAtomicAdd64( &tracedTotal, 0 );
+	total.pruned = (unsigned long long)parAtomicAdd64( &prunedTotal, 0 );
+	total.tests = (unsigned long long)parAtomicAdd64( &testsTotal, 0 );
+	return total;
+}
+
+void rayResetStats( void )
+{
+	tracedTotal = 0;
+	prunedTotal = 0;
+	testsTotal = 0;
+}
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static Color traceTask( Scene* scene, const RayTask* task, RayTask* out, int* count )
 {
 	Object* object;
+	Object* surface;
+	int flip;
 	double distance;
 
-	Vector point;
-	Vector normal;
-
 	/* Calcula o primeiro objeto a ser atingido pelo raio */
-	distance = getNearestObject( scene, eye, ray, &object );
+	distance = getNearestObject( scene, task->eye, task->ray, &object, &surface, &flip );
 
 	/* Se o raio no interceptou nenhum objeto... */
 	if( distance == DBL_MAX )
 	{
-		return sceGetBackgroundColor( scene, eye, ray );
+		return sceGetBackgroundColor( scene, task->eye, task->ray );
+	}
+
+	return traceHit( scene, task, object, surface, flip, distance, out, count );
+}
+
+static Color tracePrimary( Scene* scene, const RayTask* task, int x, int y, RayTask* out, int* count )
+{
+	Object* object;
+	Object* surface;
+	int flip;
+	double distance;
+
+	/* Raio primrio que no atinge nada: o fundo  o prprio pixel da imagem de fundo */
+	distance = getNearestObject( scene, task->eye, task->ray, &object, &surface, &flip );
+	if( distance == DBL_MAX )
+	{
+		return sceGetBackgroundPixel( scene, x, y );
 	}
 
+	return traceHit( scene, task, object, surface, flip, distance, out, count );
+}
+
+static Color traceHit( Scene* scene, const RayTask* task, Object* object, Object* surface, int flip,
+					  double distance, RayTask* out, int* count )
+{
+	Vector point;
+	Vector normal;
+
 	/* Calcula o ponto de interseo do raio com o objeto */
-	point = algAdd( eye, algScale( distance, ray ) );
+	point = algAdd( task->eye, algScale( distance, task->ray ) );
 
 	/* Obtm o vetor normal ao objeto no ponto de interseo */
-	normal =  objNormalAt( object, point );
+	normal =  objNormalAt( surface, point );
+	if( flip )
+		normal = algMinus( normal );
 
-	return shade( scene, eye, ray, object, point, normal, depth );
+	return shade( scene, task, object, surface, point, normal, out, count );
 }
 
-/************************************************************************/
-/* Definio das Funes Privadas                                       */
-/************************************************************************/
-static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector point,
-				   Vector normal, int depth )
+static Color traceStack( Scene* scene, RayTask* stack, int top )
+{
+	Color color = { 0.f, 0.f, 0.f };
+
+	/* Avalia a rvore de raios em profundidade, sem recurso */
+	while( top > 0 )
+	{
+		RayTask task = stack[--top];
+		Color local = traceTask( scene, &task, stack, &top );
+
+		color = colorAddition( color, colorScale( task.weight, local ) );
+	}
+
+	return color;
+}
+
+/* Espalha os 8 bits baixos de v, um a cada 3 bits */
+static unsigned int spreadBits( unsigned int v )
+{
+	v &= 0xff;
+	v = ( v | ( v << 8 ) ) & 0x0300f00f;
+	v = ( v | ( v << 4 ) ) & 0x030c30c3;
+	v = ( v | ( v << 2 ) ) & 0x09249249;
+	return v;
+}
+
+static int compareWaveKey( const void* p1, const void* p2 )
+{
+	const WaveKey* k1 = (const WaveKey*)p1;
+	const WaveKey* k2 = (const WaveKey*)p2;
+
+	if( k1->key < k2->key ) return -1;
+	if( k1->key > k2->key ) return  1;
+	return k1->index - k2->index;
+}
+
+static void sortWave( RayTask* wave, int count )
+{
+	WaveKey* keys;
+	RayTask* sorted;
+	Vector min, max, scale;
+	int i;
+
+	if( count < 2 ) return;
+
+	/* Caixa envolvente das origens da onda */
+	min = max = wave[0].eye;
+	for( i = 1; i < count; ++i )
+	{
+		Vector e = wave[i].eye;
+		min.x = ( e.x < min.x ) ? e.x : min.x;  max.x = ( e.x > max.x ) ? e.x : max.x;
+		min.y = ( e.y < min.y ) ? e.y : min.y;  max.y = ( e.y > max.y ) ? e.y : max.y;
+		min.z = ( e.z < min.z ) ? e.z : min.z;  max.z = ( e.z > max.z ) ? e.z : max.z;
+	}
+	scale.x = ( max.x > min.x ) ? 255.0 / ( max.x - min.x ) : 0.0;
+	scale.y = ( max.y > min.y ) ? 255.0 / ( max.y - min.y ) : 0.0;
+	scale.z = ( max.z > min.z ) ? 255.0 / ( max.z - min.z ) : 0.0;
+
+	keys = (WaveKey*)malloc( count * sizeof(WaveKey) );
+	for( i = 0; i < count; ++i )
+	{
+		const RayTask* t = &wave[i];
+		unsigned int octant = ( t->ray.x < 0 ) | ( ( t->ray.y < 0 ) << 1 ) | ( ( t->ray.z < 0 ) << 2 );
+		unsigned int qx = (unsigned int)( ( t->eye.x - min.x ) * scale.x );
+		unsigned int qy = (unsigned int)( ( t->eye.y - min.y ) * scale.y );
+		unsigned int qz = (unsigned int)( ( t->eye.z - min.z ) * scale.z );
+
+		keys[i].key = ( octant << 24 ) | spreadBits( qx ) | ( spreadBits( qy ) << 1 ) | ( spreadBits( qz ) << 2 );
+		keys[i].index = i;
+	}
+
+	qsort( keys, count, sizeof(WaveKey), compareWaveKey );
+
+	sorted = (RayTask*)malloc( count * sizeof(RayTask) );
+	for( i = 0; i < count; ++i )
+	{
+		sorted[i] = wave[keys[i].index];
+	}
+	memcpy( wave, sorted, count * sizeof(RayTask) );
+
+	free( sorted );
+	free( keys );
+}
+
+static Color shade( Scene* scene, const RayTask* task, Object* object, Object* surface, Vector point,
+				   Vector normal, RayTask* stack, int* top )
 {
 	Material* material = sceGetMaterial(scene,objGetMaterial(object));
 	double reflectionFactor = matGetReflectionFactor( material );
@@ -111,15 +503,15 @@ static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector
 	double refractedIndex   = matGetRefractionIndex( material );
 	double opacity = matGetOpacity( material );
 	Color ambient = sceGetAmbientLight( scene );
-	Color diffuse = matGetDiffuse( material, objTextureCoordinateAt( object, point ) );	
+	Color diffuse = diffuseAt( scene, task, surface, material, point, normal );
 	Color specular = matGetSpecular( material );
 
 	int nlights;
 	int i;
+	int depth;
 	double cos, sin;
 	Vector V;
 	Vector Rr, Rt;
-	Color colorRr, colorRt;
 	Vector vt, T;
 
 	/* Comea com a cor ambiente */
@@ -138,7 +530,7 @@ static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector
 	}
 
 	/*Componente especular*/
-	V  = algUnit(algMinus(ray));
+	V  = algUnit(algMinus(task->ray));
 	for (i=0; i<nlights; i++) {
 		Light *light     = sceGetLight(scene,i);   /* ponteiro da luz i */
 		Color lightcolor = lightGetColor(light);   /* cor da luz i */
@@ -151,20 +543,18 @@ static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector
 	}
 
 
-	depth ++;
+	depth = task->depth + 1;
 
 	/*Reflexo*/ 
 	Rr = algReflect(V,algUnit(normal));
-	if ((reflectionFactor>0.001)&&(depth < MAX_DEPTH))
+	if ((reflectionFactor>0.001)&&(depth < sceGetMaxDepth(scene)))
 	{
-		colorRr = rayTrace (scene,point,Rr,depth);
-		colorRr = colorScale(reflectionFactor,colorRr);
-		color = colorAddition(color,colorRr);
+		spawnRay(scene,task,point,Rr,task->weight*reflectionFactor,stack,top);
 	}
 
 
 	/*Transparncia */ 
-	if(((1-opacity)>0.001)&&(depth < MAX_DEPTH))
+	if(((1-opacity)>0.001)&&(depth < sceGetMaxDepth(scene)))
 	{
 		vt = algSub(algProj(V,algUnit(normal)),V);
 		sin = (1.0/refractedIndex)*algNorm(vt);
@@ -172,13 +562,74 @@ static Color shade( Scene* scene, Vector eye, Vector ray, Object* object, Vector
 		T   = algUnit(vt);
 		Rt  = algAdd(algScale(sin,T),algScale(-cos,algUnit(normal)));
 		//Rt=algMinus(V);
-		colorRt = rayTrace(scene,point,Rt,depth);
-		color = colorAddition(color,colorScale(1-opacity,colorRt));
+		spawnRay(scene,task,point,Rt,task->weight*(1-opacity),stack,top);
 	}
 	return color;
 }
 
-static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object** object )
+static Color diffuseAt( Scene* scene, const RayTask* task, Object* surface, Material* material,
+					   Vector point, Vector normal )
+{
+	Camera* camera = sceGetCamera( scene );
+	Vector uv;
+	double width, cosine;
+
+	if( !matHasTexture( material ) || camera == NULL )
+	{
+		return matGetDiffuse( material, algVector( 0, 0, 0, 1 ), 0 );
+	}
+
+	uv = objTextureCoordinateAt( surface, point );
+
+	/* Seo do cone do raio, projetada na superfcie (limitada a 4x em incidncia rasante) */
+	width = ( task->length + algNorm( algSub( point, task->eye ) ) ) * camGetPixelAngle( camera );
+	cosine = fabs( algDot( algUnit( task->ray ), algUnit( normal ) ) );
+	width /= MAX( cosine, 0.25 );
+
+	return matGetDiffuse( material, uv, objTextureFootprint( surface, point, width ) );
+}
+
+static void spawnRay( Scene* scene, const RayTask* parent, Vector eye, Vector ray, double weight,
+					 RayTask* stack, int* top )
+{
+	double minContribution = sceGetMinContribution( scene );
+	RayTask* child;
+
+	if( weight < minContribution )
+	{
+		double survival;
+
+		if( !sceGetRoulette( scene ) )
+		{
+			stats.pruned++;
+			return;
+		}
+
+		/* Roleta russa: sobrevive com probabilidade weight/minContribution */
+		rouletteSeed ^= rouletteSeed << 13;
+		rouletteSeed ^= rouletteSeed >> 17;
+		rouletteSeed ^= rouletteSeed << 5;
+		survival = weight / minContribution;
+		if( ( rouletteSeed / 4294967296.0 ) >= survival )
+		{
+			stats.pruned++;
+			return;
+		}
+		weight = minContribution;
+	}
+
+	stats.traced++;
+	child = &stack[(*top)++];
+	child->eye = eye;
+	child->ray = ray;
+	child->weight = weight;
+	child->length = parent->length + algNorm( algSub( eye, parent->eye ) );
+	child->depth = parent->depth + 1;
+	child->pixel = parent->pixel;
+}
+
+static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object** object,
+							   Object** surface, int* flip )
 {
 	int i;
 	int objectCount = sceGetObjectCount( scene );
@@ -188,12 +639,26 @@ static double getNearestObject( Scene* scene, Vector eye, Vector ray, Object** o
 	/* Para cada objeto na cena */
 	for( i = 0; i < objectCount; ++i ) {
 		Object* currentObject = sceGetObject( scene, i );
-		double distance = objIntercept( currentObject, eye, ray );
-		
+		Object* currentSurface;
+		int currentFlip;
+		Vector boxMin, boxMax;
+		double tmin, tmax, distance;
+
+		/* Descarta objetos cuja caixa no  atingida antes do mais prximo at agora */
+		if( !sceGetObjectBounds( scene, i, &boxMin, &boxMax ) ||
+			!objBoxIntercept( boxMin, boxMax, eye, ray, &tmin, &tmax ) ||
+			tmax <= 0.001 || tmin >= closest )
+			continue;
+
+		stats.tests++;
+		distance = objInterceptSurface( currentObject, eye, ray, &currentSurface, &currentFlip );
+
 		if( distance > 0.001 && distance < closest )   /* 0.001 e' uma tolerancia (autointersecao) */
 		{
 			closest = distance;
 			*object = currentObject;
+			*surface = currentSurface;
+			*flip = currentFlip;
 		}
 	}
 
@@ -211,8 +676,17 @@ static int isInShadow( Scene* scene, Vector point, Vector rayToLight, Vector lig
 	/* Para cada objeto na cena */
 	for( i = 0; i < objectCount; ++i )
 	{
-		double distance = objIntercept( sceGetObject( scene, i ), point, rayToLight );
-		
+		Vector boxMin, boxMax;
+		double tmin, tmax, distance;
+
+		if( !sceGetObjectBounds( scene, i, &boxMin, &boxMax ) ||
+			!objBoxIntercept( boxMin, boxMax, point, rayToLight, &tmin, &tmax ) ||
+			tmax <= 0.1 || tmin >= maxDistance )
+			continue;
+
+		stats.tests++;
+		distance = objIntercept( sceGetObject( scene, i ), point, rayToLight );
+
 		if( distance > 0.1 && distance < maxDistance )
 		{
 			return 1;
@@ -222,3 +696,47 @@ static int isInShadow( Scene* scene, Vector point, Vector rayToLight, Vector lig
 	return 0;
 }
 
+
+static Color tracePixel( Scene* scene, int x, int y )
+{
+	Camera* camera = sceGetCamera( scene );
+	RayTask stack[RAY_STACK_SIZE];
+	int top = 0;
+	Color color;
+	unsigned int seed;
+
+	/* A roleta russa de cada pixel no depende de quais pixels a thread j traou */
+	seed = (unsigned int)x * 0x9E3779B1u ^ (unsigned int)y * 0x85EBCA77u;
+	seed ^= seed >> 15;
+	seed *= 0x2C1B3C6Du;
+	seed ^= seed >> 13;
+	rouletteSeed = ( seed != 0 ) ? seed : 2463534242u;
+
+	stats.traced++;
+	stack[0].eye = camGetEye( camera );
+	stack[0].ray = camGetRay( camera, x, y );
+	stack[0].weight = 1.0;
+	stack[0].length = 0.0;
+	stack[0].depth = 0;
+	stack[0].pixel = 0;
+
+	color = tracePrimary( scene, &stack[0], x, y, stack + 1, &top );
+
+	/* Os raios secundrios foram empilhados a partir de stack + 1 */
+	color = colorAddition( color, traceStack( scene, stack + 1, top ) );
+	return color;
+}
+
+static void flushStats( void )
+{
+	if( stats.traced )
+		parAtomicAdd64( &tracedTotal, (long long)stats.traced );
+	if( stats.pruned )
+		parAtomicAdd64( &prunedTotal, (long long)stats.pruned );
+	if( stats.tests )
+		parAtomicAdd64( &testsTotal, (long long)stats.tests );
+
+	stats.traced = 0;
+	stats.pruned = 0;
+	stats.tests = 0;
+}
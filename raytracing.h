@@ -20,6 +20,32 @@
 #include "color.h"
 
 
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+/**
+ *	Contadores de raios da rvore de raios (de 64 bits: um quadro grande passa
+ *	facilmente de 2^32 testes de interseo).
+ */
+typedef struct
+{
+	/**
+	 *  Nmero de raios traados (primrios e secundrios).
+	 */
+	unsigned long long traced;
+	/**
+	 *  Nmero de raios secundrios descartados por contribuio abaixo do mnimo.
+	 */
+	unsigned long long pruned;
+	/**
+	 *  Nmero de testes de interseo raio-objeto (objIntercept) feitos para
+	 *  achar o objeto mais prximo e para as sombras, fora os descartados pela
+	 *  caixa envolvente.
+	 */
+	unsigned long long tests;
+} RayStats;
+
+
 /************************************************************************/
 /* Funes Exportadas                                                   */
 /************************************************************************/
@@ -34,5 +60,65 @@
  *	@return cor  correspondente ao raio.
  */
 Color rayTrace( Scene* scene, Vector eye, Vector ray, int depth );
+
+/**
+ *	Calcula a cor de um pixel da tela, traando o raio primrio da cmera da cena
+ *	que passa por ele. Equivale a rayTrace com o raio de camGetRay, mas quando o
+ *	raio no atinge nenhum objeto a cor vem direto do pixel correspondente da
+ *	imagem de fundo (ver sceGetBackgroundPixel). A roleta russa de cada pixel 
+ *	semeada por (x,y), ento o resultado no depende da ordem em que os pixels
+ *	so traados nem de quantas threads os traam.
+ *
+ *	@param scene Handle para cena (com cmera definida).
+ *	@param x     coluna do pixel.
+ *	@param y     linha do pixel.
+ *
+ *	@return cor do pixel.
+ */
+Color rayTracePixel( Scene* scene, int x, int y );
+
+/**
+ *	Calcula a cor de um pixel da tela como rayTracePixel, obtendo tambm os
+ *	contadores s desse pixel (para diagnstico, ver renSetHeatmap). Os totais
+ *	de rayGetStats so atualizados do mesmo jeito.
+ *
+ *	@param scene Handle para cena (com cmera definida).
+ *	@param x     coluna do pixel.
+ *	@param y     linha do pixel.
+ *	@param pixel [out] raios traados, podados e testes de interseo do pixel.
+ *
+ *	@return cor do pixel.
+ */
+Color rayTracePixelStats( Scene* scene, int x, int y, RayStats* pixel );
+
+/**
+ *	Calcula as cores de um lote de raios em modo wavefront (em largura): todos os
+ *	raios de um mesmo nvel da rvore so traados juntos, e os raios secundrios
+ *	gerados so reunidos e ordenados por octante da direo e posio da origem
+ *	antes do prximo nvel. Os raios so os primrios de linhas consecutivas da
+ *	tela, e o resultado  o mesmo de chamar rayTracePixel para cada pixel
+ *	(inclusive o fundo dos raios que no atingem nada).
+ *
+ *	@param scene  Handle para cena.
+ *	@param n      nmero de raios do lote.
+ *	@param eyes   vetor com as origens dos raios.
+ *	@param rays   vetor com as direes dos raios.
+ *	@param y0     linha da tela do primeiro raio.
+ *	@param width  largura da tela: o raio i  o do pixel (i % width, y0 + i / width).
+ *	@param colors [out] vetor onde so retornadas as cores de cada raio.
+ */
+void rayTraceBatch( Scene* scene, int n, const Vector* eyes, const Vector* rays, int y0, int width,
+				   Color* colors );
+
+/**
+ *	Obtm os contadores de raios acumulados desde o ltimo rayResetStats(),
+ *	somados de todas as threads.
+ */
+RayStats rayGetStats( void );
+
+/**
+ *	Zera os contadores de raios.
+ */
+void rayResetStats( void );
 #endif
 
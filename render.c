@@ -0,0 +1,808 @@
+/**
+ *	@file render.c Render: renderizao paralela de uma cena em ladrilhos.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render.h"
+#include "raytracing.h"
+#include "parallel.h"
+#include "trace.h"
+#include "memory.h"
+
+
+/************************************************************************/
+/* Constantes Privadas                                                  */
+/************************************************************************/
+/** Um ladrilho com mais de 1/(threads x SPLIT_SHARE) do custo total  dividido */
+#define SPLIT_SHARE	4
+
+/** Lado mnimo de um ladrilho dividido */
+#define SPLIT_MIN_SIZE	8
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Estado compartilhado pelas threads de renRenderTiles.
+ */
+typedef struct
+{
+	Scene* scene;
+	Image* image;
+	int imageX;
+	int imageY;
+	const RenderTile* tiles;
+	int count;
+	/** Prximo ladrilho a ser distribudo */
+	volatile long next;
+	RenderTileDone done;
+	void* context;
+	/** Serializa as chamadas de done */
+	ParMutex* mutex;
+	/** Tempo de cada ladrilho (NULL se no for medido) */
+	double* times;
+	/** Pixels da passada prvia: 0 ignora, 1 traa s eles, -1 traa todos menos eles */
+	int samples;
+	/** Ordem de percurso dos pixels de cada ladrilho */
+	int order;
+	/** Mapa de calor que recebe o custo de cada pixel (NULL se no for medido) */
+	RenderHeatmap* heatmap;
+} RenderPass;
+
+/**
+ *   Ladrilho da grade de renRenderScene, ou parte de um, com seu custo estimado.
+ */
+typedef struct
+{
+	RenderTile tile;
+	/** ndice do ladrilho da grade que contm este */
+	int cell;
+	double cost;
+} ScheduledTile;
+
+/**
+ *   Vista renderizada: o que precisa ser igual para que os custos se repitam.
+ */
+typedef struct
+{
+	Scene* scene;
+	Vector eye;
+	Vector at;
+	Vector up;
+	double fovy;
+	int width;
+	int height;
+	int size;
+	int maxDepth;
+	double minContribution;
+	int roulette;
+} RenderView;
+
+/**
+ *   Custos medidos de cada ladrilho da grade de uma vista.
+ */
+typedef struct
+{
+	RenderView view;
+	int count;
+	double* costs;
+	unsigned long lastUse;
+} HistoryEntry;
+
+/**
+ *   Histrico com as vistas renderizadas mais recentemente.
+ */
+struct _RenderHistory
+{
+	HistoryEntry entries[RENDER_HISTORY_SIZE];
+	int count;
+	unsigned long clock;
+};
+
+/**
+ *   Mapa de calor: uma matriz de width x height valores por medida.
+ */
+struct _RenderHeatmap
+{
+	int width;
+	int height;
+	float* values[RENDER_HEAT_COUNT];
+};
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** Ordem de percurso definida por renSetOrder */
+static int renderOrder = RENDER_ORDER_ROWS;
+
+/** Nomes das ordens de percurso, na ordem das constantes RENDER_ORDER_* */
+static const char* orderNames[] = { "rows", "morton", "hilbert", "blocks" };
+
+/** Mapa de calor definido por renSetHeatmap */
+static RenderHeatmap* renderHeatmap = NULL;
+
+/** Nomes das medidas, na ordem das constantes RENDER_HEAT_* */
+static const char* heatNames[] = { "cycles", "rays", "tests" };
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Corpo do lao paralelo: cada ndice  uma thread, que renderiza ladrilhos
+ *	at a lista acabar.
+ */
+static void renderTiles( void* pass, int begin, int end );
+
+/**
+ *	Renderiza ladrilhos em paralelo (ver renRenderTiles), opcionalmente medindo o
+ *	tempo de cada um e restrito aos pixels da passada prvia ou aos demais.
+ *
+ *	@param times [out] Tempo de cada ladrilho (NULL se no for medido).
+ *	@param samples 0 traa todos os pixels, 1 s os da passada prvia e -1 os demais.
+ */
+static void renderPass( Scene* scene, Image* image, int imageX, int imageY,
+					   const RenderTile* tiles, int count, double* times, int samples,
+					   RenderTileDone done, void* context );
+
+/**
+ *	Obtm os custos guardados de uma vista, ou cria uma entrada vazia para ela
+ *	(substituindo a usada h mais tempo).
+ *
+ *	@return Entrada da vista; count  0 se ela ainda no foi renderizada.
+ */
+static HistoryEntry* historyGet( RenderHistory* history, const RenderView* view );
+
+/**
+ *	Acrescenta a tiles o ladrilho, dividido em quatro (recursivamente) enquanto
+ *	seu custo passar de limit.
+ */
+static void splitTile( const ScheduledTile* tile, double limit, ScheduledTile* tiles, int* count );
+
+/**
+ *	Ordena ladrilhos do mais caro para o mais barato (para qsort).
+ */
+static int compareCost( const void* p1, const void* p2 );
+
+/**
+ *	Obtm o ponto de ndice d da curva de Morton: x e y so os bits pares e
+ *	mpares de d.
+ */
+static void mortonPoint( int d, int* x, int* y );
+
+/**
+ *	Obtm o ponto de ndice d da curva de Hilbert que percorre um quadrado de
+ *	lado n (potncia de 2).
+ */
+static void hilbertPoint( int n, int d, int* x, int* y );
+
+/**
+ *	Traa um pixel da tela, guardando seu custo no mapa de calor.
+ */
+static Color tracePixelHeat( Scene* scene, int x, int y, RenderHeatmap* heatmap );
+
+/**
+ *	Ordena valores em ordem crescente (para qsort).
+ */
+static int compareValue( const void* p1, const void* p2 );
+
+/**
+ *	Converte um valor em [0,1] numa cor da escala azul, ciano, verde, amarelo, vermelho.
+ */
+static Color falseColor( double t );
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+int renCreateTiles( int x, int y, int width, int height, int size, RenderTile** tiles )
+{
+	int columns, rows, count, i, j;
+	RenderTile* t;
+
+	if( size < 1 )
+		size = 1;
+
+	columns = ( width + size - 1 ) / size;
+	rows = ( height + size - 1 ) / size;
+	count = ( width > 0 && height > 0 ) ? columns * rows : 0;
+	t = (RenderTile*)malloc( ( count > 0 ? count : 1 ) * sizeof(RenderTile) );
+
+	for( j = 0; j < rows; ++j )
+	{
+		for( i = 0; i < columns; ++i )
+		{
+			RenderTile* tile = &t[j*columns + i];
+
+			tile->x = x + i * size;
+			tile->y = y + j * size;
+			tile->width = ( width - i * size < size ) ? width - i * size : size;
+			tile->height = ( height - j * size < size ) ? height - j * size : size;
+		}
+	}
+
+	*tiles = t;
+	return count;
+}
+
+void renRenderTiles( Scene* scene, Image* image, int imageX, int imageY,
+					const RenderTile* tiles, int count, RenderTileDone done, void* context )
+{
+	renderPass( scene, image, imageX, imageY, tiles, count, NULL, 0, done, context );
+}
+
+void renRenderScene( Scene* scene, Image* image, int size, RenderHistory* history,
+					RenderTileDone done, void* context )
+{
+	Camera* camera = sceGetCamera( scene );
+	int threads = parGetThreads();
+	HistoryEntry* entry = NULL;
+	RenderView view;
+	RenderTile* grid;
+	RenderTile* tiles;
+	ScheduledTile* scheduled;
+	double* costs;
+	double* times;
+	double total = 0.0;
+	double span = trcBegin();
+	double prepass;
+	int cells, count, samples = 0;
+	int i;
+
+	if( size < SPLIT_MIN_SIZE )
+		size = SPLIT_MIN_SIZE;
+
+	cells = renCreateTiles( 0, 0, imgGetWidth( image ), imgGetHeight( image ), size, &grid );
+	costs = (double*)calloc( cells > 0 ? cells : 1, sizeof(double) );
+
+	if( history )
+	{
+		memset( &view, 0, sizeof(view) );
+		view.scene = scene;
+		camGetView( camera, &view.eye, &view.at, &view.up, &view.fovy, NULL, NULL );
+		view.width = imgGetWidth( image );
+		view.height = imgGetHeight( image );
+		view.size = size;
+		view.maxDepth = sceGetMaxDepth( scene );
+		view.minContribution = sceGetMinContribution( scene );
+		view.roulette = sceGetRoulette( scene );
+
+		entry = historyGet( history, &view );
+	}
+
+	if( entry && entry->count == cells )
+	{
+		memcpy( costs, entry->costs, cells * sizeof(double) );
+	}
+	else if( threads > 1 )
+	{
+		/* Passada prvia: o tempo dos pixels amostrados estima o custo de cada ladrilho */
+		prepass = trcBegin();
+		renderPass( scene, image, 0, 0, grid, cells, costs, 1, NULL, NULL );
+		trcEnd( "render", "prepass", prepass, "%d ladrilhos", cells );
+		samples = 1;
+	}
+
+	/* Ladrilhos caros so divididos; cada parte herda uma frao do custo.
+	   As partes tm lado >= SPLIT_MIN_SIZE na direo dividida, o que limita seu nmero */
+	for( i = 0, count = 0; i < cells; ++i )
+	{
+		total += costs[i];
+		count += ( ( grid[i].width >= 2 * SPLIT_MIN_SIZE ) ? grid[i].width / SPLIT_MIN_SIZE : 1 ) *
+				 ( ( grid[i].height >= 2 * SPLIT_MIN_SIZE ) ? grid[i].height / SPLIT_MIN_SIZE : 1 );
+	}
+
+	scheduled = (ScheduledTile*)malloc( ( count > 0 ? count : 1 ) * sizeof(ScheduledTile) );
+
+	for( i = 0, count = 0; i < cells; ++i )
+	{
+		ScheduledTile tile;
+
+		tile.tile = grid[i];
+		tile.cell = i;
+		tile.cost = costs[i];
+
+		if( threads > 1 && total > 0.0 )
+			splitTile( &tile, total / ( threads * SPLIT_SHARE ), scheduled, &count );
+		else
+			scheduled[count++] = tile;
+	}
+
+	if( threads > 1 )
+		qsort( scheduled, count, sizeof(ScheduledTile), compareCost );
+
+	tiles = (RenderTile*)malloc( ( count > 0 ? count : 1 ) * sizeof(RenderTile) );
+	times = (double*)malloc( ( count > 0 ? count : 1 ) * sizeof(double) );
+	for( i = 0; i < count; ++i )
+		tiles[i] = scheduled[i].tile;
+
+	renderPass( scene, image, 0, 0, tiles, count, times, samples ? -1 : 0, done, context );
+
+	/* O custo de um ladrilho da grade  a soma do tempo de suas partes */
+	if( entry )
+	{
+		entry->costs = (double*)memRealloc( MEM_CACHES, entry->costs, ( cells > 0 ? cells : 1 ) * sizeof(double) );
+		entry->count = cells;
+		memset( entry->costs, 0, cells * sizeof(double) );
+
+		for( i = 0; i < count; ++i )
+			entry->costs[scheduled[i].cell] += times[i];
+	}
+
+	free( times );
+	free( tiles );
+	free( scheduled );
+	free( costs );
+	free( grid );
+
+	trcEnd( "render", "renRenderScene", span, "%dx%d, %d ladrilhos, %d threads",
+			imgGetWidth( image ), imgGetHeight( image ), count, threads );
+}
+
+void renSetOrder( int order )
+{
+	renderOrder = ( order < RENDER_ORDER_ROWS || order > RENDER_ORDER_BLOCKS ) ? RENDER_ORDER_ROWS : order;
+}
+
+int renGetOrder( void )
+{
+	return renderOrder;
+}
+
+const char* renGetOrderName( int order )
+{
+	return ( order < RENDER_ORDER_ROWS || order > RENDER_ORDER_BLOCKS ) ? NULL : orderNames[order];
+}
+
+int renFindOrder( const char* name )
+{
+	int order;
+
+	for( order = RENDER_ORDER_ROWS; order <= RENDER_ORDER_BLOCKS; ++order )
+		if( strcmp( name, orderNames[order] ) == 0 )
+			return order;
+
+	return -1;
+}
+
+void renCreateOrder( int width, int height, int order, int** pixels )
+{
+	int* p = (int*)malloc( ( width * height > 0 ? width * height : 1 ) * sizeof(int) );
+	int count = 0, n = 1;
+	int d, x, y, bx, by;
+
+	switch( order )
+	{
+	case RENDER_ORDER_MORTON:
+	case RENDER_ORDER_HILBERT:
+		/* A curva cobre o menor quadrado de lado 2^k que contm o retngulo */
+		while( n < width || n < height )
+			n *= 2;
+
+		for( d = 0; d < n * n; ++d )
+		{
+			if( order == RENDER_ORDER_MORTON )
+				mortonPoint( d, &x, &y );
+			else
+				hilbertPoint( n, d, &x, &y );
+
+			if( x < width && y < height )
+				p[count++] = y * width + x;
+		}
+		break;
+
+	case RENDER_ORDER_BLOCKS:
+		for( by = 0; by < height; by += RENDER_BLOCK_SIZE )
+			for( bx = 0; bx < width; bx += RENDER_BLOCK_SIZE )
+				for( y = by; y < by + RENDER_BLOCK_SIZE && y < height; ++y )
+					for( x = bx; x < bx + RENDER_BLOCK_SIZE && x < width; ++x )
+						p[count++] = y * width + x;
+		break;
+
+	default:
+		for( d = 0; d < width * height; ++d )
+			p[d] = d;
+	}
+
+	*pixels = p;
+}
+
+RenderHistory* renHistoryCreate( void )
+{
+	RenderHistory* history = (RenderHistory*)memAlloc( MEM_CACHES, sizeof(RenderHistory) );
+
+	history->count = 0;
+	history->clock = 0;
+	return history;
+}
+
+void renHistoryDestroy( RenderHistory* history )
+{
+	int i;
+
+	if( history == NULL )
+		return;
+
+	for( i = 0; i < history->count; ++i )
+		memFree( history->entries[i].costs );
+	memFree( history );
+}
+
+RenderHeatmap* renHeatmapCreate( int width, int height )
+{
+	RenderHeatmap* heatmap = (RenderHeatmap*)memAlloc( MEM_FRAMEBUFFER, sizeof(RenderHeatmap) );
+	int metric;
+
+	heatmap->width = width;
+	heatmap->height = height;
+	for( metric = 0; metric < RENDER_HEAT_COUNT; ++metric )
+		heatmap->values[metric] = (float*)memCalloc( MEM_FRAMEBUFFER, ( width * height > 0 ) ? width * height : 1, sizeof(float) );
+
+	return heatmap;
+}
+
+void renSetHeatmap( RenderHeatmap* heatmap )
+{
+	renderHeatmap = heatmap;
+}
+
+void renHeatmapGetStats( RenderHeatmap* heatmap, int metric, double* mean, double* max )
+{
+	const float* values = heatmap->values[metric];
+	int n = heatmap->width * heatmap->height;
+	double sum = 0.0, top = 0.0;
+	int i;
+
+	for( i = 0; i < n; ++i )
+	{
+		sum += values[i];
+		if( values[i] > top )
+			top = values[i];
+	}
+
+	if( mean )
+		*mean = ( n > 0 ) ? sum / n : 0.0;
+	if( max )
+		*max = top;
+}
+
+const char* renGetHeatName( int metric )
+{
+	return ( metric < 0 || metric >= RENDER_HEAT_COUNT ) ? NULL : heatNames[metric];
+}
+
+int renHeatmapWrite( RenderHeatmap* heatmap, const char* filename )
+{
+	int n = heatmap->width * heatmap->height;
+	const char* dot = strrchr( filename, '.' );
+	const char* slash = strrchr( filename, '/' );
+	int length = ( dot && ( slash == NULL || dot > slash ) ) ? (int)( dot - filename ) : (int)strlen( filename );
+	char* name = (char*)malloc( length + 16 );
+	float* sorted = (float*)malloc( ( n > 0 ? n : 1 ) * sizeof(float) );
+	Image* image = imgCreate( heatmap->width, heatmap->height );
+	int ok = 1;
+	int metric, i;
+
+	for( metric = 0; metric < RENDER_HEAT_COUNT; ++metric )
+	{
+		const float* values = heatmap->values[metric];
+		double scale;
+
+		/* O topo da escala  o valor que s RENDER_HEAT_CLIP dos pixels ultrapassam,
+		   ou o mximo se at ele todos os pixels forem iguais (contagens pequenas) */
+		memcpy( sorted, values, n * sizeof(float) );
+		qsort( sorted, n, sizeof(float), compareValue );
+		scale = ( n > 0 ) ? sorted[(int)( ( n - 1 ) * ( 1.0 - RENDER_HEAT_CLIP ) )] : 0.0;
+		if( n > 0 && scale == sorted[0] )
+			scale = sorted[n-1];
+		scale = ( scale > 0.0 ) ? 1.0 / scale : 0.0;
+
+		for( i = 0; i < n; ++i )
+			imageSetPixel( image, i % heatmap->width, i / heatmap->width, falseColor( values[i] * scale ) );
+
+		sprintf( name, "%.*s_%s.bmp", length, filename, heatNames[metric] );
+		ok = imgWriteBMP( name, image ) && ok;
+	}
+
+	imgDestroy( image );
+	free( sorted );
+	free( name );
+	return ok;
+}
+
+void renHeatmapDestroy( RenderHeatmap* heatmap )
+{
+	int metric;
+
+	if( heatmap == NULL )
+		return;
+
+	for( metric = 0; metric < RENDER_HEAT_COUNT; ++metric )
+		memFree( heatmap->values[metric] );
+	memFree( heatmap );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void renderTiles( void* pass, int begin, int end )
+{
+	RenderPass* p = (RenderPass*)pass;
+	long index;
+	double start = 0.0;
+	double span;
+	int* order = NULL;
+	int orderWidth = 0, orderHeight = 0;
+	int i, x, y;
+
+	(void)begin;
+	(void)end;
+
+	while( ( index = parAtomicAdd( &p->next, 1 ) ) < p->count )
+	{
+		const RenderTile* tile = &p->tiles[index];
+
+		span = trcBegin();
+		if( p->times )
+			start = parGetTime();
+
+		/* A ordem de percurso  recalculada s quando o tamanho do ladrilho muda */
+		if( order == NULL || tile->width != orderWidth || tile->height != orderHeight )
+		{
+			free( order );
+			renCreateOrder( tile->width, tile->height, p->order, &order );
+			orderWidth = tile->width;
+			orderHeight = tile->height;
+		}
+
+		for( i = 0; i < tile->width * tile->height; ++i )
+		{
+			x = tile->x + order[i] % tile->width;
+			y = tile->y + order[i] / tile->width;
+
+			if( p->samples )
+			{
+				int sample = ( x % RENDER_SAMPLE_STEP == 0 && y % RENDER_SAMPLE_STEP == 0 );
+
+				if( sample != ( p->samples > 0 ) )
+					continue;
+			}
+
+			if( p->heatmap )
+				imageSetPixel( p->image, x - p->imageX, y - p->imageY, tracePixelHeat( p->scene, x, y, p->heatmap ) );
+			else
+				imageSetPixel( p->image, x - p->imageX, y - p->imageY, rayTracePixel( p->scene, x, y ) );
+		}
+
+		if( p->times )
+			p->times[index] = parGetTime() - start;
+
+		trcEnd( "render", ( p->samples > 0 ) ? "samples" : "tile", span, "%d,%d %dx%d",
+				tile->x, tile->y, tile->width, tile->height );
+
+		if( p->done )
+		{
+			parLock( p->mutex );
+			p->done( p->context, tile );
+			parUnlock( p->mutex );
+		}
+	}
+
+	free( order );
+}
+
+static void renderPass( Scene* scene, Image* image, int imageX, int imageY,
+					   const RenderTile* tiles, int count, double* times, int samples,
+					   RenderTileDone done, void* context )
+{
+	RenderPass pass;
+
+	pass.scene = scene;
+	pass.image = image;
+	pass.imageX = imageX;
+	pass.imageY = imageY;
+	pass.tiles = tiles;
+	pass.count = count;
+	pass.next = 0;
+	pass.done = done;
+	pass.context = context;
+	pass.mutex = done ? parMutexCreate() : NULL;
+	pass.times = times;
+	pass.samples = samples;
+	pass.order = renderOrder;
+	pass.heatmap = renderHeatmap;
+
+	parFor( ( parGetThreads() < count ) ? parGetThreads() : count, renderTiles, &pass );
+
+	if( pass.mutex )
+		parMutexDestroy( pass.mutex );
+}
+
+static HistoryEntry* historyGet( RenderHistory* history, const RenderView* view )
+{
+	HistoryEntry* entry;
+	int i;
+
+	history->clock++;
+
+	for( i = 0; i < history->count; ++i )
+	{
+		if( memcmp( &history->entries[i].view, view, sizeof(RenderView) ) == 0 )
+		{
+			history->entries[i].lastUse = history->clock;
+			return &history->entries[i];
+		}
+	}
+
+	if( history->count < RENDER_HISTORY_SIZE )
+	{
+		entry = &history->entries[history->count++];
+		entry->costs = NULL;
+	}
+	else
+	{
+		entry = &history->entries[0];
+		for( i = 1; i < history->count; ++i )
+			if( history->entries[i].lastUse < entry->lastUse )
+				entry = &history->entries[i];
+	}
+
+	entry->view = *view;
+	entry->count = 0;
+	entry->lastUse = history->clock;
+	return entry;
+}
+
+static void splitTile( const ScheduledTile* tile, double limit, ScheduledTile* tiles, int* count )
+{
+	const RenderTile* t = &tile->tile;
+	int halfWidth = t->width / 2;
+	int halfHeight = t->height / 2;
+	int i;
+
+	if( tile->cost <= limit || ( halfWidth < SPLIT_MIN_SIZE && halfHeight < SPLIT_MIN_SIZE ) )
+	{
+		tiles[(*count)++] = *tile;
+		return;
+	}
+
+	/* Quatro partes (duas se um dos lados j  pequeno demais para dividir) */
+	for( i = 0; i < 4; ++i )
+	{
+		ScheduledTile part = *tile;
+		int right = i & 1;
+		int top = i >> 1;
+
+		if( halfWidth >= SPLIT_MIN_SIZE )
+		{
+			part.tile.x = t->x + right * halfWidth;
+			part.tile.width = right ? t->width - halfWidth : halfWidth;
+		}
+		else if( right )
+			continue;
+
+		if( halfHeight >= SPLIT_MIN_SIZE )
+		{
+			part.tile.y = t->y + top * halfHeight;
+			part.tile.height = top ? t->height - halfHeight : halfHeight;
+		}
+		else if( top )
+			continue;
+
+		part.cost = tile->cost * ( (double)part.tile.width * part.tile.height ) / ( (double)t->width * t->height );
+		splitTile( &part, limit, tiles, count );
+	}
+}
+
+static int compareCost( const void* p1, const void* p2 )
+{
+	const ScheduledTile* t1 = (const ScheduledTile*)p1;
+	const ScheduledTile* t2 = (const ScheduledTile*)p2;
+
+	if( t1->cost != t2->cost )
+		return ( t1->cost < t2->cost ) ? 1 : -1;
+
+	/* Empates na ordem da grade, para que a ordem no dependa do qsort */
+	if( t1->tile.y != t2->tile.y )
+		return t1->tile.y - t2->tile.y;
+	return t1->tile.x - t2->tile.x;
+}
+
+static void mortonPoint( int d, int* x, int* y )
+{
+	int bit;
+
+	*x = 0;
+	*y = 0;
+	for( bit = 0; ( d >> ( 2 * bit ) ) != 0; ++bit )
+	{
+		*x |= ( ( d >> ( 2 * bit ) ) & 1 ) << bit;
+		*y |= ( ( d >> ( 2 * bit + 1 ) ) & 1 ) << bit;
+	}
+}
+
+static void hilbertPoint( int n, int d, int* x, int* y )
+{
+	int s, rx, ry, t;
+
+	*x = 0;
+	*y = 0;
+	for( s = 1; s < n; s *= 2 )
+	{
+		rx = 1 & ( d / 2 );
+		ry = 1 & ( d ^ rx );
+
+		/* Cada quadrante  a curva de lado s, girada ou refletida */
+		if( ry == 0 )
+		{
+			if( rx == 1 )
+			{
+				*x = s - 1 - *x;
+				*y = s - 1 - *y;
+			}
+
+			t = *x;
+			*x = *y;
+			*y = t;
+		}
+
+		*x += s * rx;
+		*y += s * ry;
+		d /= 4;
+	}
+}
+
+static Color tracePixelHeat( Scene* scene, int x, int y, RenderHeatmap* heatmap )
+{
+	RayStats counts;
+	double start = parGetTicks();
+	Color color = rayTracePixelStats( scene, x, y, &counts );
+	double cycles = parGetTicks() - start;
+
+	if( x >= 0 && x < heatmap->width && y >= 0 && y < heatmap->height )
+	{
+		int i = y * heatmap->width + x;
+
+		heatmap->values[RENDER_HEAT_CYCLES][i] = (float)cycles;
+		heatmap->values[RENDER_HEAT_RAYS][i] = (float)counts.traced;
+		heatmap->values[RENDER_HEAT_TESTS][i] = (float)counts.tests;
+	}
+
+	return color;
+}
+
+static int compareValue( const void* p1, const void* p2 )
+{
+	float v1 = *(const float*)p1;
+	float v2 = *(const float*)p2;
+
+	return ( v1 < v2 ) ? -1 : ( ( v1 > v2 ) ? 1 : 0 );
+}
+
+static Color falseColor( double t )
+{
+	static const float stops[5][3] = { { 0.f, 0.f, 1.f }, { 0.f, 1.f, 1.f }, { 0.f, 1.f, 0.f },
+									   { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+	Color color;
+	double f;
+	int k;
+
+	t = ( t < 0.0 ) ? 0.0 : ( ( t > 1.0 ) ? 1.0 : t );
+	k = ( t >= 1.0 ) ? 3 : (int)( t * 4 );
+	f = t * 4 - k;
+
+	color.red = (float)( stops[k][0] + f * ( stops[k+1][0] - stops[k][0] ) );
+	color.green = (float)( stops[k][1] + f * ( stops[k+1][1] - stops[k][1] ) );
+	color.blue = (float)( stops[k][2] + f * ( stops[k+1][2] - stops[k][2] ) );
+	return color;
+}
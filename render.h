@@ -0,0 +1,241 @@
+/**
+ *	@file render.h Render: renderizao paralela de uma cena em ladrilhos.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include "scene.h"
+#include "image.h"
+
+
+/************************************************************************/
+/* Constantes Exportadas                                                */
+/************************************************************************/
+/** Um pixel a cada RENDER_SAMPLE_STEP, em cada direo,  traado na passada prvia de renRenderScene */
+#define RENDER_SAMPLE_STEP	4
+
+/** Nmero de vistas (cena, cmera, rvore de raios e ladrilho) lembradas por um histrico */
+#define RENDER_HISTORY_SIZE	16
+
+/** Ordens de percurso dos pixels dentro de um ladrilho (ver renSetOrder) */
+#define RENDER_ORDER_ROWS		0	/**< linhas, da base para o topo */
+#define RENDER_ORDER_MORTON		1	/**< curva Z (bits de x e y intercalados) */
+#define RENDER_ORDER_HILBERT	2	/**< curva de Hilbert */
+#define RENDER_ORDER_BLOCKS		3	/**< blocos de RENDER_BLOCK_SIZE x RENDER_BLOCK_SIZE, em linhas */
+
+/** Lado dos blocos de RENDER_ORDER_BLOCKS */
+#define RENDER_BLOCK_SIZE	4
+
+/** Medidas por pixel de um mapa de calor (ver renSetHeatmap) */
+#define RENDER_HEAT_CYCLES	0	/**< ciclos do processador (ver parGetTicks) */
+#define RENDER_HEAT_RAYS	1	/**< raios traados */
+#define RENDER_HEAT_TESTS	2	/**< testes de interseo raio-objeto */
+#define RENDER_HEAT_COUNT	3
+
+/** Frao dos pixels mais caros que saturam a escala de cores de renHeatmapWrite */
+#define RENDER_HEAT_CLIP	0.01
+
+
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+/**
+ *	Retngulo de pixels da tela renderizado como uma unidade de trabalho.
+ */
+typedef struct
+{
+	int x;
+	int y;
+	int width;
+	int height;
+} RenderTile;
+
+/**
+ *	Chamada quando um ladrilho termina de ser renderizado. As chamadas so
+ *	serializadas (nunca h duas ao mesmo tempo), mas podem vir de qualquer
+ *	thread do lao paralelo.
+ *
+ *	@param context Dados repassados de renRenderTiles.
+ *	@param tile Ladrilho concludo; seus pixels j esto na imagem.
+ */
+typedef void (*RenderTileDone)( void* context, const RenderTile* tile );
+
+/**
+ *	Histrico do custo (tempo) de cada ladrilho nas ltimas renderizaes.
+ */
+typedef struct _RenderHistory RenderHistory;
+
+/**
+ *	Mapa de calor: o custo de cada pixel da tela, em cada uma das medidas
+ *	RENDER_HEAT_*.
+ */
+typedef struct _RenderHeatmap RenderHeatmap;
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Divide um retngulo da tela em ladrilhos de size x size pixels (menores na
+ *	borda direita e na de cima), em ordem de linhas.
+ *
+ *	@param x Coluna do canto inferior esquerdo do retngulo.
+ *	@param y Linha do canto inferior esquerdo do retngulo.
+ *	@param width Largura do retngulo.
+ *	@param height Altura do retngulo.
+ *	@param size Lado dos ladrilhos.
+ *	@param tiles [out] Vetor de ladrilhos alocado com malloc (liberar com free).
+ *
+ *	@return Nmero de ladrilhos.
+ */
+int renCreateTiles( int x, int y, int width, int height, int size, RenderTile** tiles );
+
+/**
+ *	Renderiza ladrilhos com rayTracePixel, em paralelo (ver parFor). Cada thread
+ *	pega o prximo ladrilho da lista assim que termina o anterior, de modo que
+ *	ladrilhos caros no atrasam as demais threads.
+ *
+ *	@param scene Cena, com a cmera que define a tela.
+ *	@param image Imagem que recebe os pixels: o pixel (x,y) da tela vai para
+ *				(x - imageX, y - imageY) da imagem.
+ *	@param imageX Coluna da tela correspondente  coluna 0 da imagem.
+ *	@param imageY Linha da tela correspondente  linha 0 da imagem.
+ *	@param tiles Ladrilhos, em coordenadas da tela, na ordem em que so distribudos.
+ *	@param count Nmero de ladrilhos.
+ *	@param done Chamada ao fim de cada ladrilho (pode ser NULL).
+ *	@param context Dados repassados a done.
+ */
+void renRenderTiles( Scene* scene, Image* image, int imageX, int imageY,
+					const RenderTile* tiles, int count, RenderTileDone done, void* context );
+
+/**
+ *	Renderiza a tela inteira da cmera da cena, em paralelo, distribuindo os
+ *	ladrilhos do mais caro para o mais barato: um ladrilho caro comeado no fim
+ *	deixaria as outras threads paradas esperando por ele. O custo de cada
+ *	ladrilho vem do histrico, se a mesma vista j foi renderizada, ou de uma
+ *	passada prvia que traa um pixel a cada RENDER_SAMPLE_STEP x RENDER_SAMPLE_STEP
+ *	(esses pixels j so os da imagem final e no so traados de novo).
+ *	Ladrilhos com uma frao grande do custo total so divididos em quatro,
+ *	recursivamente, para que nenhum sozinho determine o fim da renderizao.
+ *	Com uma thread os ladrilhos so renderizados na ordem das linhas.
+ *
+ *	@param scene Cena, com a cmera que define a tela.
+ *	@param image Imagem do tamanho da tela.
+ *	@param size Lado dos ladrilhos.
+ *	@param history Histrico onde os custos medidos so guardados para a prxima
+ *				renderizao da mesma vista (pode ser NULL).
+ *	@param done Chamada ao fim de cada ladrilho (pode ser NULL).
+ *	@param context Dados repassados a done.
+ */
+void renRenderScene( Scene* scene, Image* image, int size, RenderHistory* history,
+					RenderTileDone done, void* context );
+
+/**
+ *	Define a ordem em que os pixels de cada ladrilho so traados. Pixels vizinhos
+ *	no plano tendem a atingir os mesmos objetos e texels; percorr-los em ordens
+ *	que preservam a vizinhana (curvas de Morton e Hilbert, blocos) mantm esses
+ *	dados no cache. A imagem resultante no muda.
+ *
+ *	@param order Uma das constantes RENDER_ORDER_* (padro: RENDER_ORDER_ROWS).
+ */
+void renSetOrder( int order );
+
+/**
+ *	Obtm a ordem de percurso definida por renSetOrder.
+ */
+int renGetOrder( void );
+
+/**
+ *	Obtm o nome de uma ordem de percurso: "rows", "morton", "hilbert" ou "blocks".
+ */
+const char* renGetOrderName( int order );
+
+/**
+ *	Obtm a ordem de percurso com um nome (ver renGetOrderName).
+ *
+ *	@return Uma das constantes RENDER_ORDER_*, ou -1 se o nome no for de nenhuma.
+ */
+int renFindOrder( const char* name );
+
+/**
+ *	Calcula a ordem de percurso dos pixels de um retngulo.
+ *
+ *	@param width Largura do retngulo.
+ *	@param height Altura do retngulo.
+ *	@param order Uma das constantes RENDER_ORDER_*.
+ *	@param pixels [out] Vetor com width x height deslocamentos (y*width + x),
+ *				na ordem de percurso, alocado com malloc (liberar com free).
+ */
+void renCreateOrder( int width, int height, int order, int** pixels );
+
+/**
+ *	Cria um histrico de custos vazio.
+ */
+RenderHistory* renHistoryCreate( void );
+
+/**
+ *	Destri um histrico criado com renHistoryCreate.
+ */
+void renHistoryDestroy( RenderHistory* history );
+
+/**
+ *	Cria um mapa de calor zerado.
+ *
+ *	@param width Largura da tela.
+ *	@param height Altura da tela.
+ */
+RenderHeatmap* renHeatmapCreate( int width, int height );
+
+/**
+ *	Liga o modo de diagnstico: os pixels renderizados a seguir (por
+ *	renRenderTiles e renRenderScene) so traados com rayTracePixelStats, e os
+ *	ciclos, raios e testes de interseo de cada um so guardados no pixel (x,y)
+ *	da tela no mapa. Pixels fora do mapa no so medidos. Os ciclos incluem a
+ *	prpria medio, mas ela  pequena diante de um raio.
+ *
+ *	@param heatmap Mapa que recebe as medidas, ou NULL para desligar (o padro).
+ */
+void renSetHeatmap( RenderHeatmap* heatmap );
+
+/**
+ *	Obtm a mdia e o mximo de uma medida entre os pixels do mapa.
+ *
+ *	@param heatmap Mapa de calor.
+ *	@param metric Uma das constantes RENDER_HEAT_*.
+ *	@param mean [out] Mdia por pixel (pode ser NULL).
+ *	@param max [out] Mximo (pode ser NULL).
+ */
+void renHeatmapGetStats( RenderHeatmap* heatmap, int metric, double* mean, double* max );
+
+/**
+ *	Obtm o nome de uma medida: "cycles", "rays" ou "tests".
+ */
+const char* renGetHeatName( int metric );
+
+/**
+ *	Grava cada medida do mapa como um BMP em falsa cor (azul, ciano, verde,
+ *	amarelo, vermelho, do menor ao maior custo), ao lado da imagem renderizada:
+ *	para "saida.bmp" so gravados "saida_cycles.bmp", "saida_rays.bmp" e
+ *	"saida_tests.bmp". A escala vai de zero ao valor que s RENDER_HEAT_CLIP
+ *	dos pixels ultrapassam, para que poucos pixels muito caros no escondam
+ *	as diferenas entre os demais (ou do mximo, se at esse valor todos os
+ *	pixels forem iguais).
+ *
+ *	@param heatmap Mapa de calor.
+ *	@param filename Nome do arquivo da imagem renderizada (a extenso  trocada).
+ *
+ *	@return No-zero se todos os arquivos foram gravados.
+ */
+int renHeatmapWrite( RenderHeatmap* heatmap, const char* filename );
+
+/**
+ *	Destri um mapa de calor criado com renHeatmapCreate.
+ */
+void renHeatmapDestroy( RenderHeatmap* heatmap );
+
+#endif
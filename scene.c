@@ -14,6 +14,8 @@
 
 #include "scene.h"
 #include "raytracing.h"
+#include "trace.h"
+#include "memory.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -21,6 +23,12 @@
 #include <sys/timeb.h>
 
 
+/************************************************************************/
+/* Constantes Privadas                                                  */
+/************************************************************************/
+#define MIN( a, b ) ( ( a < b ) ? a : b )
+
+
 /**
  *   Cena com a camera, os objetos, as luzes e a imagem/cor de fundo.
  */
@@ -36,9 +44,26 @@ struct _Scene
      */
 	Color bgColor;
 	/**
-     *  Imagem de fundo da cena
+     *  Imagem de fundo como lida do arquivo
      */
-	Image* bgImage;
+	Image* bgSource;
+	/**
+     *  Imagem de fundo no tamanho da tela da cmera, calculada pixel a pixel
+     *  a partir de bgSource (a imagem da tela inteira no  alocada); refeito
+     *  quando a cmera muda (ver sceSetCamera)
+     */
+	ImageSampler* bgSampler;
+	/**
+     *  Constantes do far plane, calculadas por sceSetCamera: origem,
+     *  normal, distncia da origem do sistema ao plano e eixos u e v divididos
+     *  pelo quadrado de seus comprimentos (o produto escalar d direto a
+     *  coordenada em [0,1]).
+     */
+	Vector farOrigin;
+	Vector farNormal;
+	double farDistance;
+	Vector farUScaled;
+	Vector farVScaled;
 
 	/**
      *  Nmero de materiais existentes na cena.
@@ -57,6 +82,12 @@ struct _Scene
      *  Vetor com os objetos existentes na cena.
      */
 	Object* objects[MAX_OBJECTS];
+	/**
+     *  Caixas envolventes dos objetos, calculadas ao fim de sceLoad (uma
+     *  por objeto, alocadas com a marca MEM_ACCEL).
+     */
+	Vector* boundsMin;
+	Vector* boundsMax;
 
 	/**
      *  Intensidade rgb da luz ambiente da cena
@@ -70,26 +101,55 @@ struct _Scene
      *  Vetor com as fontes de luz existentes na cena.
      */
 	Light* lights[MAX_LIGHTS];
+
+	/**
+     *  Profundidade mxima da rvore de raios.
+     */
+	int maxDepth;
+	/**
+     *  Peso mnimo acumulado para que um raio secundrio seja traado.
+     */
+	double minContribution;
+	/**
+     *  No-zero se raios abaixo de minContribution passam por roleta russa.
+     */
+	int roulette;
+
+	/**
+     *  Nmero de arquivos de imagem lidos pela cena.
+     */
+	int fileCount;
+	/**
+     *  Nomes dos arquivos de imagem lidos pela cena, sem repeties.
+     */
+	char files[MAX_SCENE_FILES][FILENAME_MAXLEN];
 };
 
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Acrescenta um arquivo  lista de arquivos lidos pela cena, se ainda no estiver nela.
+ */
+static void sceAddFile( Scene* scene, const char* filename );
+
 /************************************************************************/
 /* Definio das Funes Exportadas                                     */
 /************************************************************************/
 Color sceGetBackgroundColor( Scene* scene, Vector eye, Vector ray )
 {
-	double planeDistance, divisor, distance, scaleU, scaleV;
-	Vector farOrigin, farNormal, farU, farV, point, pointFromOrigin;
+	double divisor, distance, scaleU, scaleV;
+	Vector pointFromOrigin;
+	int width, height;
 
-	if( scene->bgImage == NULL || scene->camera == NULL )
+	if( scene->bgSampler == NULL || scene->camera == NULL )
 	{
 		return scene->bgColor;
 	}
 
-	/* Obtm informaes sobre o far plane */
-	camGetFarPlane( scene->camera, &farOrigin, &farNormal, &farU, &farV );
-
 	/* Cos(alpha) entre a normal do plano e o raio */
-	divisor = algDot( ray, farNormal );
+	divisor = algDot( ray, scene->farNormal );
 
 	/* Se o raio se distancia ou  paralelo ao far plane */
 	if( divisor > 0 || -divisor < EPSILON )
@@ -97,9 +157,7 @@ Color sceGetBackgroundColor( Scene* scene, Vector eye, Vector ray )
 		return scene->bgColor;
 	}
 
-	planeDistance = algDot( farOrigin, farNormal );
-
-	distance = ( ( planeDistance - algDot( eye, farNormal ) ) / divisor );
+	distance = ( ( scene->farDistance - algDot( eye, scene->farNormal ) ) / divisor );
 
 	/* Se o raio se distancia do far plane */
 	if( distance < 0 )
@@ -107,15 +165,9 @@ Color sceGetBackgroundColor( Scene* scene, Vector eye, Vector ray )
 		return scene->bgColor;
 	}
 
-	point = algAdd( eye, algScale( distance, ray ) );
-
-	pointFromOrigin = algSub( point, farOrigin );
-
-	divisor = algDot( farU, farU );
-	scaleU = ( algDot( farU, pointFromOrigin ) / divisor );
-
-	divisor = algDot( farV, farV );
-	scaleV = ( algDot( farV, pointFromOrigin ) / divisor );
+	pointFromOrigin = algSub( algAdd( eye, algScale( distance, ray ) ), scene->farOrigin );
+	scaleU = algDot( scene->farUScaled, pointFromOrigin );
+	scaleV = algDot( scene->farVScaled, pointFromOrigin );
 
 	/* Se o raio no intercepta o far plane (ou seja, a imagem de fundo)... */
 	if( scaleU < 0 || scaleV < 0 || scaleU > 1 || scaleV > 1 )
@@ -123,9 +175,23 @@ Color sceGetBackgroundColor( Scene* scene, Vector eye, Vector ray )
 		return scene->bgColor;
 	}
 	
-	return imageGetPixel( scene->bgImage,
-							(int)( scaleU * camGetScreenWidth( scene->camera ) ),
-							(int)( scaleV * camGetScreenHeight( scene->camera ) ) );
+	/* scaleU == 1 (ou scaleV == 1) cai na ltima coluna (linha) */
+	width = camGetScreenWidth( scene->camera );
+	height = camGetScreenHeight( scene->camera );
+	return imgSamplerGet( scene->bgSampler,
+						  MIN( (int)( scaleU * width ), width - 1 ),
+						  MIN( (int)( scaleV * height ), height - 1 ) );
+}
+
+Color sceGetBackgroundPixel( Scene* scene, int x, int y )
+{
+	if( scene->bgSampler == NULL || scene->camera == NULL || x < 0 || y < 0 ||
+		x >= camGetScreenWidth( scene->camera ) || y >= camGetScreenHeight( scene->camera ) )
+	{
+		return scene->bgColor;
+	}
+
+	return imgSamplerGet( scene->bgSampler, x, y );
 }
 
 Color sceGetAmbientLight( Scene* scene )
@@ -138,6 +204,29 @@ Camera* sceGetCamera( Scene* scene )
     return scene->camera;
 }
 
+void sceSetCamera( Scene* scene, Camera* camera )
+{
+	int width = camGetScreenWidth( camera );
+	int height = camGetScreenHeight( camera );
+	Vector farU, farV;
+
+	if( scene->camera != camera )
+	{
+		camDestroy( scene->camera );
+		scene->camera = camera;
+	}
+
+	/* Imagem de fundo no tamanho da tela (como imgResize, mas s os pesos ficam em memria) */
+	imgSamplerDestroy( scene->bgSampler );
+	scene->bgSampler = scene->bgSource ? imgSamplerCreate( scene->bgSource, width, height, IMG_RESIZE_BILINEAR ) : NULL;
+
+	/* Constantes do far plane usadas por sceGetBackgroundColor */
+	camGetFarPlane( camera, &scene->farOrigin, &scene->farNormal, &farU, &farV );
+	scene->farDistance = algDot( scene->farOrigin, scene->farNormal );
+	scene->farUScaled = algScale( 1.0 / algDot( farU, farU ), farU );
+	scene->farVScaled = algScale( 1.0 / algDot( farV, farV ), farV );
+}
+
 int sceGetObjectCount( Scene* scene )
 {
 	return scene->objectCount;
@@ -153,6 +242,18 @@ Object* sceGetObject( Scene* scene, int index )
 	return scene->objects[index];
 }
 
+int sceGetObjectBounds( Scene* scene, int index, Vector* boxMin, Vector* boxMax )
+{
+	if( index < 0 || index >= scene->objectCount || scene->objects[index] == NULL )
+	{
+		return 0;
+	}
+
+	*boxMin = scene->boundsMin[index];
+	*boxMax = scene->boundsMax[index];
+	return 1;
+}
+
 int sceGetLightCount( Scene* scene )
 {
 	return scene->lightCount;
@@ -168,15 +269,49 @@ Light* sceGetLight( Scene* scene, int index )
 	return scene->lights[index];
 }
 
+void sceSetRayTree( Scene* scene, int maxDepth, double minContribution, int roulette )
+{
+	if( maxDepth < 1 ) maxDepth = 1;
+	if( maxDepth > MAX_RAY_DEPTH ) maxDepth = MAX_RAY_DEPTH;
+	if( minContribution < 0 ) minContribution = 0;
+
+	scene->maxDepth = maxDepth;
+	scene->minContribution = minContribution;
+	scene->roulette = roulette;
+}
+
+int sceGetMaxDepth( Scene* scene )
+{
+	return scene->maxDepth;
+}
+
+double sceGetMinContribution( Scene* scene )
+{
+	return scene->minContribution;
+}
+
+int sceGetRoulette( Scene* scene )
+{
+	return scene->roulette;
+}
+
 Scene* sceLoad( const char *filename )
 {
 	FILE *file;
 	char buffer[512];
 
 	Scene* scene;
+	int i;
+	double span = trcBegin();
+	double boundsSpan;
 
 	/* indices dos objetos para btree e qual operao ser realizada. */
 	int obj1, obj2, op;
+
+	/* Parmetros da rvore de raios */
+	int maxDepth;
+	double minContribution;
+	int roulette = 0;
 	
 	Color bgColor;
 	Color ambientLight;
@@ -218,7 +353,7 @@ Scene* sceLoad( const char *filename )
 		return NULL;
 	}
 
-	scene = (struct _Scene *)malloc( sizeof(struct _Scene) );
+	scene = (struct _Scene *)memAlloc( MEM_SCENE, sizeof(struct _Scene) );
 	if( !scene )
 	{
 		return NULL;
@@ -226,10 +361,13 @@ Scene* sceLoad( const char *filename )
 
 	/* Default (undefined) values: */
 	scene->camera = NULL;
-	scene->bgImage = NULL;
+	scene->bgSampler = NULL;
+	scene->bgSource = NULL;
 	scene->objectCount = 0;
 	scene->lightCount = 0;
 	scene->materialCount = 0;
+	scene->fileCount = 0;
+	sceSetRayTree( scene, DEFAULT_RAY_DEPTH, DEFAULT_RAY_CONTRIBUTION, 0 );
 	
 	while( fgets( buffer, sizeof(buffer), file ) ) 
 	{
@@ -246,6 +384,11 @@ Scene* sceLoad( const char *filename )
 
 			scene->camera = camCreate( eye, at, up, fovy, nearp, farp, screenWidth, screenHeight );
 		} 
+		else if( sscanf( buffer, "RAYTREE %d %lf %d\n", &maxDepth, &minContribution, &roulette ) >= 2 )
+		{
+			/* O terceiro parmetro (roleta russa)  opcional */
+			sceSetRayTree( scene, maxDepth, minContribution, roulette );
+		}
 		else if( sscanf( buffer, "SCENE %f %f %f %f %f %f %s\n", &bgColor.red, &bgColor.green, &bgColor.blue, &ambientLight.red, &ambientLight.green, &ambientLight.blue, backgroundFileName ) == 7 ) 
 		{
 			bgColor = colorNormalize( bgColor );
@@ -254,32 +397,40 @@ Scene* sceLoad( const char *filename )
 			scene->bgColor = bgColor;
 			scene->ambientLight = ambientLight;
 
-			if( scene->bgImage )
+			if( scene->bgSource )
 			{
-				imgDestroy( scene->bgImage );
+				imgDestroy( scene->bgSource );
 			}
 
 			if( strcmp( backgroundFileName, "null") == 0 )
 			{
-				scene->bgImage = NULL;
+				scene->bgSource = NULL;
 			} 
 			else 
 			{
-				scene->bgImage = imgReadBMP (backgroundFileName);
+				scene->bgSource = imgReadBMP (backgroundFileName);
+				if( scene->bgSource )
+				{
+					sceAddFile( scene, backgroundFileName );
+				}
 			}
 		} 
 		else if( sscanf( buffer, "MATERIAL %f %f %f %f %f %f %lf %lf %lf %lf %s\n", &diffuse.red, &diffuse.green, &diffuse.blue, &specular.red, &specular.green, &specular.blue, &specularExponent, &reflective, &refractive, &opacity, textureFileName ) == 11 ) 
 		{
-			Image *image = NULL;
+			Texture *texture = NULL;
 			
 			if( strcmp( textureFileName, "null") != 0 )
 			{
-				image = imgReadBMP (textureFileName);
+				texture = texLoad( textureFileName );
+				if( texture )
+				{
+					sceAddFile( scene, textureFileName );
+				}
 			}
 
 			if( scene->materialCount >= MAX_MATERIALS )
 			{
-				imgDestroy( image );
+				texRelease( texture );
 				fprintf( stderr, "sceLoad: Foi ultrapassado o limite de definicoes de materiais na cena. Ignorando." );
 				continue;
 			}
@@ -287,7 +438,7 @@ Scene* sceLoad( const char *filename )
 			diffuse = colorNormalize( diffuse );
 			specular = colorNormalize( specular );
 
-			scene->materials[scene->materialCount++] = matCreate( image, diffuse, specular, specularExponent, reflective, refractive, opacity );
+			scene->materials[scene->materialCount++] = matCreate( texture, diffuse, specular, specularExponent, reflective, refractive, opacity );
 		} 
 		else if( sscanf( buffer, "LIGHT %lf %lf %lf %f %f %f\n", &pos1.x, &pos1.y, &pos1.z, &lightColor.red, &lightColor.green, &lightColor.blue ) == 6 )
 		{
@@ -361,18 +512,44 @@ Scene* sceLoad( const char *filename )
 		}
 	}
 
-	/* Adjust background image to screen size */
-	if( scene->camera && scene->bgImage )
+	/* Imagem de fundo e far plane da cmera do arquivo */
+	if( scene->camera )
 	{
-		scene->bgImage = imgResize( scene->bgImage, camGetScreenWidth( scene->camera ),
-			camGetScreenHeight( scene->camera ) );
+		sceSetCamera( scene, scene->camera );
 	}
 
+	/* Caixas envolventes usadas para descartar objetos durante o traado */
+	boundsSpan = trcBegin();
+	scene->boundsMin = (Vector*)memAlloc( MEM_ACCEL, ( scene->objectCount > 0 ? scene->objectCount : 1 ) * sizeof(Vector) );
+	scene->boundsMax = (Vector*)memAlloc( MEM_ACCEL, ( scene->objectCount > 0 ? scene->objectCount : 1 ) * sizeof(Vector) );
+	for( i = 0; i < scene->objectCount; ++i )
+	{
+		if( scene->objects[i] )
+			objGetBounds( scene->objects[i], &scene->boundsMin[i], &scene->boundsMax[i] );
+	}
+	trcEnd( "scene", "bounds", boundsSpan, "%d objetos", scene->objectCount );
+
 	fclose( file );
 
+	trcEnd( "scene", "sceLoad", span, "%s", filename );
 	return scene;
 }
 
+int sceGetFileCount( Scene* scene )
+{
+	return scene->fileCount;
+}
+
+const char* sceGetFileName( Scene* scene, int index )
+{
+	if( index < 0 || index >= scene->fileCount )
+	{
+		return NULL;
+	}
+
+	return scene->files[index];
+}
+
 int sceGetMaterialCount( Scene* scene )
 {
 	return scene->materialCount;
@@ -388,7 +565,8 @@ void sceDestroy( Scene* scene )
 	int i;
 
 	camDestroy( scene->camera );
-	imgDestroy( scene->bgImage );
+	imgSamplerDestroy( scene->bgSampler );
+	imgDestroy( scene->bgSource );
 
 	for( i = 0; i < scene->objectCount; ++i )
 	{
@@ -399,7 +577,37 @@ void sceDestroy( Scene* scene )
 	{
 		matDestroy( scene->materials[i] );
 	}
-	
-	free( scene );
+
+	for( i = 0; i < scene->lightCount; ++i )
+	{
+		lightDestroy( scene->lights[i] );
+	}
+
+	memFree( scene->boundsMin );
+	memFree( scene->boundsMax );
+	memFree( scene );
 }
 
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void sceAddFile( Scene* scene, const char* filename )
+{
+	int i;
+
+	for( i = 0; i < scene->fileCount; ++i )
+	{
+		if( strcmp( scene->files[i], filename ) == 0 )
+		{
+			return;
+		}
+	}
+
+	if( scene->fileCount < MAX_SCENE_FILES )
+	{
+		strncpy( scene->files[scene->fileCount], filename, FILENAME_MAXLEN - 1 );
+		scene->files[scene->fileCount][FILENAME_MAXLEN - 1] = '\0';
+		scene->fileCount++;
+	}
+}
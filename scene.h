@@ -29,6 +29,15 @@
 #define MAX_OBJECTS		128
 #define MAX_LIGHTS		100
 #define FILENAME_MAXLEN	64
+/** Arquivos lidos por uma cena alm do rt4: a imagem de fundo e uma textura por material */
+#define MAX_SCENE_FILES	( MAX_MATERIALS + 1 )
+
+/** Limite superior para a profundidade da rvore de raios */
+#define MAX_RAY_DEPTH	32
+/** Profundidade padro da rvore de raios */
+#define DEFAULT_RAY_DEPTH	6
+/** Contribuio mnima padro de um raio secundrio (1/255, menos de um tom de cor) */
+#define DEFAULT_RAY_CONTRIBUTION	( 1.0 / 255.0 )
 
 #ifndef EPSILON
 #define EPSILON	1.0e-10
@@ -59,6 +68,19 @@ typedef struct _Scene Scene;
  */
 Color sceGetBackgroundColor( Scene* scene, Vector eye, Vector ray );
 
+/**
+ *	Obtm a cor de fundo vista por um raio primrio que passa pelo pixel (x,y) da
+ *	tela e no atinge nenhum objeto. Como a imagem de fundo tem o tamanho da tela,
+ *	 o prprio pixel (x,y) da imagem, sem interseo com o far plane.
+ *
+ *	@param scene Handle para uma cena.
+ *	@param x Coluna do pixel.
+ *	@param y Linha do pixel.
+ *
+ *	@return Cor de fundo no pixel.
+ */
+Color sceGetBackgroundPixel( Scene* scene, int x, int y );
+
 /**
  *	Obtm a luz ambiente de uma cena.
  */
@@ -69,6 +91,18 @@ Color sceGetAmbientLight( Scene* scene );
  */
 Camera* sceGetCamera( Scene* scene );
 
+/**
+ *	Troca a cmera de uma cena, que passa a pertencer  cena (a anterior 
+ *	destruda). A cada chamada, o amostrador da imagem de fundo  recriado para o
+ *	tamanho de tela da cmera, a partir do arquivo original (ver imgSamplerCreate),
+ *	e as constantes do far plane so recalculadas; o resto da cena  reaproveitado. Permite renderizar uma cena j carregada com
+ *	outros pontos de vista e resolues.
+ *
+ *	@param scene Handle para uma cena.
+ *	@param camera Nova cmera (criada com camCreate).
+ */
+void sceSetCamera( Scene* scene, Camera* camera );
+
 /**
  *	Obtm o nmero de objetos existentes em uma cena.
  *
@@ -88,6 +122,19 @@ int sceGetObjectCount( Scene* scene );
  */
 Object* sceGetObject( Scene* scene, int index );
 
+/**
+ *	Obtm a caixa envolvente de um objeto de uma cena.
+ *
+ *	@param scene Handle para uma cena.
+ *	@param index ndice do objeto (de 0 a objectCount - 1).
+ *	@param boxMin [out] Canto inferior da caixa.
+ *	@param boxMax [out] Canto superior da caixa.
+ *
+ *	@return Zero se no h objeto no ndice (ndice invlido ou objeto
+ *			incorporado a uma rvore CSG), no-zero caso contrrio.
+ */
+int sceGetObjectBounds( Scene* scene, int index, Vector* boxMin, Vector* boxMax );
+
 /**
  *	Obtm o nmero de fontes de luz existentes em uma cena.
  *
@@ -116,6 +163,51 @@ Light* sceGetLight( Scene* scene, int index );
  */
 Scene* sceLoad( const char *filename );
 
+/**
+ *	Ajusta os parmetros de poda da rvore de raios de uma cena.
+ *	Equivale ao comando RAYTREE do arquivo rt4.
+ *
+ *	@param scene Handle para uma cena.
+ *	@param maxDepth Profundidade mxima da rvore (de 1 a MAX_RAY_DEPTH).
+ *	@param minContribution Peso mnimo acumulado para que um raio secundrio
+ *				seja traado (0 desliga a poda por contribuio).
+ *	@param roulette No-zero para, em vez de descartar, manter os raios abaixo de
+ *				minContribution por roleta russa (sem vis).
+ */
+void sceSetRayTree( Scene* scene, int maxDepth, double minContribution, int roulette );
+
+/**
+ *	Obtm a profundidade mxima da rvore de raios de uma cena.
+ */
+int sceGetMaxDepth( Scene* scene );
+
+/**
+ *	Obtm o peso mnimo acumulado para que um raio secundrio seja traado.
+ */
+double sceGetMinContribution( Scene* scene );
+
+/**
+ *	Indica se raios abaixo da contribuio mnima passam por roleta russa.
+ */
+int sceGetRoulette( Scene* scene );
+
+/**
+ *	Obtm o nmero de arquivos de imagem (fundo e texturas) lidos por sceLoad.
+ *	Junto com o prprio rt4, so os arquivos necessrios para ler a cena de novo
+ *	em outra mquina.
+ */
+int sceGetFileCount( Scene* scene );
+
+/**
+ *	Obtm o nome de um arquivo lido por sceLoad, como escrito no rt4.
+ *
+ *	@param scene Handle para uma cena.
+ *	@param index ndice do arquivo (de 0 a fileCount - 1).
+ *
+ *	@return Nome do arquivo (NULL se o ndice for invlido).
+ */
+const char* sceGetFileName( Scene* scene, int index );
+
 /**
  *	Obtm o nmero de materiais de uma cena.
  */
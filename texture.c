@@ -0,0 +1,468 @@
+/**
+ *	@file texture.c Texture: texturas com pirmide de mipmaps e amostragem filtrada.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "texture.h"
+#include "trace.h"
+#include "memory.h"
+
+
+/************************************************************************/
+/* Constantes Privadas                                                  */
+/************************************************************************/
+/** Nmero mximo de nveis da pirmide (texturas de at 32768x32768) */
+#define MAX_TEXTURE_LEVELS	16
+
+/** Nmero mximo de arquivos mantidos no cache de texturas */
+#define MAX_CACHED_TEXTURES	64
+
+/** Tamanho mximo do nome de arquivo guardado no cache */
+#define TEXTURE_PATH_MAXLEN	256
+
+/** Lado, em texels, dos blocos em que cada nvel  armazenado (4x4 RGBA = 64 bytes) */
+#define TEXTURE_TILE	4
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Um nvel da pirmide de mipmaps.
+ *
+ *   Os texels so guardados com 8 bits por componente (RGBA, alfa no usado) em
+ *   blocos de TEXTURE_TILE x TEXTURE_TILE, cada bloco em ordem de Morton. Os 4
+ *   texels de uma amostra bilinear ficam quase sempre na mesma linha de cache.
+ */
+typedef struct
+{
+	/**
+	 *  Dimenses do nvel, em texels.
+	 */
+	int width, height;
+	/**
+	 *  Nmero de blocos em cada linha de blocos.
+	 */
+	int tilesX;
+	/**
+	 *  Texels, bloco a bloco (dimenses arredondadas para mltiplos de TEXTURE_TILE).
+	 */
+	unsigned char *texels;
+} TextureLevel;
+
+/**
+ *   Textura com sua pirmide de mipmaps.
+ */
+struct _Texture
+{
+	/**
+	 *  Nmero de nveis da pirmide.
+	 */
+	int levelCount;
+	/**
+	 *  Nveis, do mais detalhado (0) ao de 1x1 texel.
+	 */
+	TextureLevel levels[MAX_TEXTURE_LEVELS];
+
+	/**
+	 *  Nmero de referncias (materiais)  textura.
+	 */
+	int refCount;
+	/**
+	 *  No-zero se a textura pertence ao cache (e no  destruda quando
+	 *  deixa de ser referenciada).
+	 */
+	int cached;
+};
+
+/**
+ *   Entrada do cache de texturas: um arquivo, identificado pelo nome e pela
+ *   data de modificao e tamanho no momento da leitura.
+ */
+typedef struct
+{
+	char path[TEXTURE_PATH_MAXLEN];
+	time_t mtime;
+	off_t size;
+	Texture* texture;
+} TextureCacheEntry;
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** Cache de texturas lidas de arquivo, compartilhado por todas as cenas */
+static TextureCacheEntry textureCache[MAX_CACHED_TEXTURES];
+static int textureCacheCount = 0;
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Remove a entrada i do cache (a ltima entrada ocupa seu lugar).
+ *	A textura no  destruda.
+ */
+static void texCacheRemove( int i );
+
+/**
+ *	Quantiza um nvel (rgb em float, linha a linha como em Image) para 8 bits
+ *	e o reorganiza em blocos.
+ */
+static void texStore( TextureLevel* level, const float* rgb, int width, int height );
+
+/**
+ *	Calcula, em float, a mdia 2x2 de um nvel (dimenses mpares repetem a
+ *	ltima linha/coluna).
+ *
+ *	@return Vetor rgb alocado com memAlloc, com dimenses *width x *height.
+ */
+static float* texDownsample( const float* rgb, int* width, int* height );
+
+/**
+ *	Posio (em texels) de (x,y) no vetor de blocos de um nvel.
+ */
+static int texOffset( const TextureLevel* level, int x, int y );
+
+/**
+ *	Amostra um nvel com interpolao bilinear e repetio da textura.
+ */
+static Color texBilinear( const TextureLevel* level, double u, double v );
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+Texture* texCreate( Image* image )
+{
+	Texture* texture;
+	float* rgb;
+	int width, height;
+
+	if( image == NULL )
+	{
+		return NULL;
+	}
+
+	texture = (struct _Texture *)memAlloc( MEM_TEXTURES, sizeof(struct _Texture) );
+	texture->levelCount = 0;
+	texture->refCount = 1;
+	texture->cached = 0;
+
+	/* A pirmide  calculada em float e cada nvel  quantizado separadamente */
+	width = imgGetWidth( image );
+	height = imgGetHeight( image );
+	rgb = imgGetRGBData( image );
+	texStore( &texture->levels[texture->levelCount++], rgb, width, height );
+
+	while( texture->levelCount < MAX_TEXTURE_LEVELS && ( width > 1 || height > 1 ) )
+	{
+		float* next = texDownsample( rgb, &width, &height );
+
+		if( rgb != imgGetRGBData( image ) )
+			memFree( rgb );
+		rgb = next;
+
+		texStore( &texture->levels[texture->levelCount++], rgb, width, height );
+	}
+
+	if( rgb != imgGetRGBData( image ) )
+		memFree( rgb );
+
+	return texture;
+}
+
+Texture* texLoad( const char* filename )
+{
+	struct stat info;
+	Texture* texture;
+	Image* image;
+	double span;
+	int i;
+
+	if( stat( filename, &info ) != 0 )
+	{
+		return NULL;
+	}
+
+	for( i = 0; i < textureCacheCount; ++i )
+	{
+		TextureCacheEntry* entry = &textureCache[i];
+
+		if( strcmp( entry->path, filename ) != 0 )
+			continue;
+
+		if( entry->mtime == info.st_mtime && entry->size == info.st_size )
+		{
+			entry->texture->refCount++;
+			return entry->texture;
+		}
+
+		/* Arquivo modificado: a verso antiga sai do cache (e morre com sua ltima referncia) */
+		entry->texture->cached = 0;
+		if( entry->texture->refCount == 0 )
+			texDestroy( entry->texture );
+		texCacheRemove( i );
+		break;
+	}
+
+	image = imgReadBMP( (char *)filename );
+	span = trcBegin();
+	texture = texCreate( image );
+	trcEnd( "texture", "texCreate", span, "%s", filename );
+	imgDestroy( image );
+	if( texture == NULL || strlen( filename ) >= TEXTURE_PATH_MAXLEN )
+	{
+		return texture;
+	}
+
+	/* Cache cheio: abre espao descartando uma textura sem referncias */
+	if( textureCacheCount == MAX_CACHED_TEXTURES )
+	{
+		for( i = 0; i < textureCacheCount; ++i )
+		{
+			if( textureCache[i].texture->refCount == 0 )
+			{
+				texDestroy( textureCache[i].texture );
+				texCacheRemove( i );
+				break;
+			}
+		}
+		if( textureCacheCount == MAX_CACHED_TEXTURES )
+			return texture;
+	}
+
+	strcpy( textureCache[textureCacheCount].path, filename );
+	textureCache[textureCacheCount].mtime = info.st_mtime;
+	textureCache[textureCacheCount].size = info.st_size;
+	textureCache[textureCacheCount].texture = texture;
+	textureCacheCount++;
+	texture->cached = 1;
+
+	return texture;
+}
+
+void texRelease( Texture* texture )
+{
+	if( texture == NULL )
+	{
+		return;
+	}
+
+	/* Texturas do cache continuam residentes para as prximas cenas */
+	if( --texture->refCount == 0 && !texture->cached )
+	{
+		texDestroy( texture );
+	}
+}
+
+void texFlushCache( void )
+{
+	while( textureCacheCount > 0 )
+	{
+		Texture* texture = textureCache[0].texture;
+
+		texCacheRemove( 0 );
+		texture->cached = 0;
+		if( texture->refCount == 0 )
+			texDestroy( texture );
+	}
+}
+
+void texTrimCache( void )
+{
+	int i = 0;
+
+	while( i < textureCacheCount )
+	{
+		Texture* texture = textureCache[i].texture;
+
+		/* texCacheRemove pe a ltima entrada no lugar de i */
+		if( texture->refCount == 0 )
+		{
+			texDestroy( texture );
+			texCacheRemove( i );
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+Color texSample( Texture* texture, double u, double v, double footprint )
+{
+	const TextureLevel* base = &texture->levels[0];
+	int size = ( base->width > base->height ) ? base->width : base->height;
+	double lod;
+	int level;
+	Color c0, c1;
+	float t;
+
+	/* Nvel de detalhe: log2 do nmero de texels cobertos pelo pixel */
+	lod = ( footprint > 0 ) ? log( footprint * size ) / log( 2.0 ) : 0.0;
+	if( lod <= 0 )
+	{
+		return texBilinear( base, u, v );
+	}
+	if( lod >= texture->levelCount - 1 )
+	{
+		return texBilinear( &texture->levels[texture->levelCount - 1], u, v );
+	}
+
+	level = (int)lod;
+	t = (float)( lod - level );
+	c0 = texBilinear( &texture->levels[level], u, v );
+	c1 = texBilinear( &texture->levels[level + 1], u, v );
+
+	c0.red   += t * ( c1.red   - c0.red );
+	c0.green += t * ( c1.green - c0.green );
+	c0.blue  += t * ( c1.blue  - c0.blue );
+	return c0;
+}
+
+int texGetWidth( Texture* texture )
+{
+	return texture->levels[0].width;
+}
+
+int texGetHeight( Texture* texture )
+{
+	return texture->levels[0].height;
+}
+
+void texDestroy( Texture* texture )
+{
+	int i;
+
+	if( texture == NULL )
+	{
+		return;
+	}
+
+	for( i = 0; i < texture->levelCount; ++i )
+	{
+		memFree( texture->levels[i].texels );
+	}
+	memFree( texture );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void texCacheRemove( int i )
+{
+	textureCache[i] = textureCache[--textureCacheCount];
+}
+
+static void texStore( TextureLevel* level, const float* rgb, int width, int height )
+{
+	int tilesY = ( height + TEXTURE_TILE - 1 ) / TEXTURE_TILE;
+	int x, y, k;
+
+	level->width = width;
+	level->height = height;
+	level->tilesX = ( width + TEXTURE_TILE - 1 ) / TEXTURE_TILE;
+	level->texels = (unsigned char *)memCalloc( MEM_TEXTURES, 4 * TEXTURE_TILE * TEXTURE_TILE * level->tilesX * tilesY, 1 );
+
+	for( y = 0; y < height; ++y )
+	{
+		for( x = 0; x < width; ++x )
+		{
+			const float* src = &rgb[3 * ( y * width + x )];
+			unsigned char* dst = &level->texels[4 * texOffset( level, x, y )];
+
+			for( k = 0; k < 3; ++k )
+			{
+				float c = src[k] * 255.f + 0.5f;
+				dst[k] = (unsigned char)( ( c < 0 ) ? 0 : ( ( c > 255 ) ? 255 : c ) );
+			}
+			dst[3] = 255;
+		}
+	}
+}
+
+static float* texDownsample( const float* rgb, int* width, int* height )
+{
+	int srcWidth = *width;
+	int srcHeight = *height;
+	int dstWidth = ( srcWidth > 1 ) ? srcWidth / 2 : 1;
+	int dstHeight = ( srcHeight > 1 ) ? srcHeight / 2 : 1;
+	float* dst = (float *)memAlloc( MEM_TEXTURES, 3 * dstWidth * dstHeight * sizeof(float) );
+	int x, y, k;
+
+	for( y = 0; y < dstHeight; ++y )
+	{
+		int y0 = 2 * y;
+		int y1 = ( y0 + 1 < srcHeight ) ? y0 + 1 : y0;
+
+		for( x = 0; x < dstWidth; ++x )
+		{
+			int x0 = 2 * x;
+			int x1 = ( x0 + 1 < srcWidth ) ? x0 + 1 : x0;
+			const float* p00 = &rgb[3 * ( y0 * srcWidth + x0 )];
+			const float* p01 = &rgb[3 * ( y0 * srcWidth + x1 )];
+			const float* p10 = &rgb[3 * ( y1 * srcWidth + x0 )];
+			const float* p11 = &rgb[3 * ( y1 * srcWidth + x1 )];
+			float* out = &dst[3 * ( y * dstWidth + x )];
+
+			for( k = 0; k < 3; ++k )
+				out[k] = 0.25f * ( p00[k] + p01[k] + p10[k] + p11[k] );
+		}
+	}
+
+	*width = dstWidth;
+	*height = dstHeight;
+	return dst;
+}
+
+static int texOffset( const TextureLevel* level, int x, int y )
+{
+	int tile = ( y / TEXTURE_TILE ) * level->tilesX + ( x / TEXTURE_TILE );
+
+	/* Ordem de Morton dentro do bloco 4x4: bits de x e y intercalados */
+	int morton = ( x & 1 ) | ( ( y & 1 ) << 1 ) | ( ( x & 2 ) << 1 ) | ( ( y & 2 ) << 2 );
+
+	return tile * TEXTURE_TILE * TEXTURE_TILE + morton;
+}
+
+static Color texBilinear( const TextureLevel* level, double u, double v )
+{
+	double fx = u * level->width - 0.5;
+	double fy = v * level->height - 0.5;
+	double ix = floor( fx );
+	double iy = floor( fy );
+	float tx = (float)( fx - ix );
+	float ty = (float)( fy - iy );
+	int x0, x1, y0, y1;
+	const unsigned char *p00, *p01, *p10, *p11;
+	Color color;
+
+	/* Repetio da textura: ndices sempre em [0, dimenso) */
+	x0 = (int)fmod( ix, level->width );
+	if( x0 < 0 ) x0 += level->width;
+	y0 = (int)fmod( iy, level->height );
+	if( y0 < 0 ) y0 += level->height;
+	x1 = ( x0 + 1 < level->width ) ? x0 + 1 : 0;
+	y1 = ( y0 + 1 < level->height ) ? y0 + 1 : 0;
+
+	p00 = &level->texels[4 * texOffset( level, x0, y0 )];
+	p01 = &level->texels[4 * texOffset( level, x1, y0 )];
+	p10 = &level->texels[4 * texOffset( level, x0, y1 )];
+	p11 = &level->texels[4 * texOffset( level, x1, y1 )];
+
+	/* Decodificao para [0,1] junto com a interpolao */
+	color.red   = ( ( 1 - ty ) * ( p00[0] + tx * ( p01[0] - p00[0] ) ) + ty * ( p10[0] + tx * ( p11[0] - p10[0] ) ) ) * ( 1.f / 255.f );
+	color.green = ( ( 1 - ty ) * ( p00[1] + tx * ( p01[1] - p00[1] ) ) + ty * ( p10[1] + tx * ( p11[1] - p10[1] ) ) ) * ( 1.f / 255.f );
+	color.blue  = ( ( 1 - ty ) * ( p00[2] + tx * ( p01[2] - p00[2] ) ) + ty * ( p10[2] + tx * ( p11[2] - p10[2] ) ) ) * ( 1.f / 255.f );
+	return color;
+}
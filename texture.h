@@ -0,0 +1,104 @@
+/**
+ *	@file texture.h Texture: texturas com pirmide de mipmaps e amostragem filtrada.
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include "color.h"
+#include "image.h"
+
+
+/************************************************************************/
+/* Tipos Exportados                                                     */
+/************************************************************************/
+
+
+typedef struct _Texture Texture;
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Cria uma textura a partir de uma imagem, construindo a pirmide de mipmaps
+ *	(cada nvel  a mdia 2x2 do anterior, at 1x1). Os nveis so guardados com
+ *	8 bits por componente, em blocos 4x4; a imagem no  modificada nem retida
+ *	e o chamador continua responsvel por destru-la.
+ *
+ *	@param image Imagem com o nvel 0 da textura.
+ *
+ *	@return Handle para a textura criada, com uma referncia (ver texRelease),
+ *			ou NULL se image for NULL.
+ */
+Texture* texCreate( Image* image );
+
+/**
+ *	Obtm a textura de um arquivo BMP atravs do cache de texturas. Arquivos j
+ *	lidos (mesmo nome, data de modificao e tamanho) no so lidos de novo: a
+ *	mesma textura  devolvida com mais uma referncia. O cache  global e
+ *	sobrevive  destruio das cenas, de modo que recarregar uma cena reaproveita
+ *	suas texturas.
+ *
+ *	@param filename Nome do arquivo.
+ *
+ *	@return Textura com uma referncia para o chamador (liberar com texRelease),
+ *			ou NULL se o arquivo no pde ser lido.
+ */
+Texture* texLoad( const char* filename );
+
+/**
+ *	Libera uma referncia a uma textura obtida com texLoad() ou texCreate().
+ *	Texturas fora do cache so destrudas junto com a ltima referncia; as do
+ *	cache continuam residentes at texFlushCache().
+ */
+void texRelease( Texture* texture );
+
+/**
+ *	Esvazia o cache de texturas. Texturas sem referncias so destrudas; as
+ *	demais passam a ser destrudas quando sua ltima referncia for liberada.
+ */
+void texFlushCache( void );
+
+/**
+ *	Destri as texturas do cache que no tm mais referncias. As que alguma
+ *	cena ainda usa continuam no cache, e um novo texLoad do mesmo arquivo no
+ *	as l de novo.
+ */
+void texTrimCache( void );
+
+/**
+ *	Amostra a textura com filtragem trilinear: interpolao bilinear dentro de
+ *	dois nveis vizinhos da pirmide e linear entre eles. A textura se repete
+ *	fora de [0,1].
+ *
+ *	@param texture Handle para a textura.
+ *	@param u Coordenada horizontal de textura.
+ *	@param v Coordenada vertical de textura (0 na base da imagem).
+ *	@param footprint Tamanho, em coordenadas de textura, da regio coberta pelo
+ *					pixel. Define o nvel de detalhe; 0 amostra o nvel 0.
+ *
+ *	@return Cor filtrada.
+ */
+Color texSample( Texture* texture, double u, double v, double footprint );
+
+/**
+ *	Obtm a largura, em texels, do nvel 0 de uma textura.
+ */
+int texGetWidth( Texture* texture );
+
+/**
+ *	Obtm a altura, em texels, do nvel 0 de uma textura.
+ */
+int texGetHeight( Texture* texture );
+
+/**
+ *	Destri uma textura criada com texCreate().
+ */
+void texDestroy( Texture* texture );
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ *	@file trace.c Trace: linha do tempo da execuo no formato de eventos do
+ *		Chrome (chrome://tracing, Perfetto).
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "trace.h"
+#include "parallel.h"
+
+
+/************************************************************************/
+/* Constantes Privadas                                                  */
+/************************************************************************/
+/** Trilha das threads de parStart (as de parFor vo de 0 a MAX_THREADS - 1) */
+#define ASYNC_TRACK	MAX_THREADS
+
+/** Nmero de eventos alocados de uma vez */
+#define EVENT_BLOCK	1024
+
+
+/************************************************************************/
+/* Tipos Privados                                                       */
+/************************************************************************/
+/**
+ *   Intervalo registrado por trcEnd.
+ */
+typedef struct
+{
+	const char* category;
+	char name[TRACE_NAME_SIZE];
+	char detail[TRACE_DETAIL_SIZE];
+	/** Incio e durao, em microssegundos */
+	double start;
+	double duration;
+	int track;
+} TraceEvent;
+
+
+/************************************************************************/
+/* Variveis Privadas                                                   */
+/************************************************************************/
+/** No-zero entre trcStart e trcStop */
+static volatile int traceEnabled = 0;
+
+/** Origem dos tempos (parGetTime de trcStart) */
+static double traceOrigin = 0.0;
+
+/** Arquivo gravado por trcStop */
+static char* traceFile = NULL;
+
+/** Eventos registrados, protegidos por traceMutex */
+static TraceEvent* traceEvents = NULL;
+static int traceCount = 0;
+static int traceCapacity = 0;
+static ParMutex* traceMutex = NULL;
+
+
+/************************************************************************/
+/* Funes Privadas                                                     */
+/************************************************************************/
+/**
+ *	Grava uma string entre aspas, com os caracteres especiais do JSON escapados
+ *	(os acima de 127 so tomados como ISO-8859-1, a codificao dos fontes).
+ */
+static void writeString( FILE* file, const char* s );
+
+
+/************************************************************************/
+/* Definio das Funes Exportadas                                     */
+/************************************************************************/
+int trcStart( const char* filename )
+{
+	if( traceEnabled )
+		return 0;
+
+	traceFile = (char*)malloc( strlen( filename ) + 1 );
+	strcpy( traceFile, filename );
+	traceMutex = parMutexCreate();
+	traceCount = 0;
+	traceOrigin = parGetTime();
+	traceEnabled = 1;
+	return 1;
+}
+
+int trcStop( void )
+{
+	int used[ASYNC_TRACK + 1];
+	FILE* file;
+	int i, ok;
+
+	if( !traceEnabled )
+		return 0;
+
+	traceEnabled = 0;
+
+	file = fopen( traceFile, "w" );
+	if( file )
+	{
+		memset( used, 0, sizeof(used) );
+		fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+		fprintf( file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"raytracer\"}}" );
+
+		for( i = 0; i < traceCount; ++i )
+		{
+			const TraceEvent* e = &traceEvents[i];
+
+			used[e->track] = 1;
+			fprintf( file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f,\"cat\":",
+					 e->track, e->start, e->duration );
+			writeString( file, e->category );
+			fprintf( file, ",\"name\":" );
+			writeString( file, e->name );
+			if( e->detail[0] )
+			{
+				fprintf( file, ",\"args\":{\"detail\":" );
+				writeString( file, e->detail );
+				fprintf( file, "}" );
+			}
+			fprintf( file, "}" );
+		}
+
+		/* Nomes das trilhas, na ordem das threads */
+		for( i = 0; i <= ASYNC_TRACK; ++i )
+		{
+			if( !used[i] )
+				continue;
+
+			if( i == 0 )
+				fprintf( file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}" );
+			else if( i == ASYNC_TRACK )
+				fprintf( file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"async\"}}", i );
+			else
+				fprintf( file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", i, i );
+
+			fprintf( file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", i, i );
+		}
+
+		fprintf( file, "\n]}\n" );
+	}
+	ok = ( file != NULL ) && !ferror( file );
+	if( file && fclose( file ) != 0 )
+		ok = 0;
+
+	free( traceEvents );
+	traceEvents = NULL;
+	traceCount = traceCapacity = 0;
+	parMutexDestroy( traceMutex );
+	traceMutex = NULL;
+	free( traceFile );
+	traceFile = NULL;
+	return ok;
+}
+
+double trcBegin( void )
+{
+	return traceEnabled ? parGetTime() : -1.0;
+}
+
+void trcEnd( const char* category, const char* name, double start, const char* format, ... )
+{
+	double end;
+	TraceEvent* e;
+	int index;
+
+	if( start < 0.0 || !traceEnabled )
+		return;
+
+	end = parGetTime();
+	index = parGetThreadIndex();
+
+	parLock( traceMutex );
+
+	if( traceCount == traceCapacity )
+	{
+		traceCapacity += EVENT_BLOCK;
+		traceEvents = (TraceEvent*)realloc( traceEvents, traceCapacity * sizeof(TraceEvent) );
+	}
+	e = &traceEvents[traceCount++];
+
+	e->category = category;
+	strncpy( e->name, name, TRACE_NAME_SIZE - 1 );
+	e->name[TRACE_NAME_SIZE - 1] = '\0';
+	e->detail[0] = '\0';
+	if( format )
+	{
+		va_list args;
+
+		va_start( args, format );
+		vsnprintf( e->detail, TRACE_DETAIL_SIZE, format, args );
+		va_end( args );
+	}
+	e->start = ( start - traceOrigin ) * 1e6;
+	e->duration = ( end - start ) * 1e6;
+	e->track = ( index < 0 || index >= ASYNC_TRACK ) ? ASYNC_TRACK : index;
+
+	parUnlock( traceMutex );
+}
+
+
+/************************************************************************/
+/* Definio das Funes Privadas                                       */
+/************************************************************************/
+static void writeString( FILE* file, const char* s )
+{
+	fputc( '"', file );
+	for( ; *s; ++s )
+	{
+		if( *s == '"' || *s == '\\' )
+			fprintf( file, "\\%c", *s );
+		else if( (unsigned char)*s < 0x20 || (unsigned char)*s >= 0x80 )
+			fprintf( file, "\\u%04x", (unsigned char)*s );
+		else
+			fputc( *s, file );
+	}
+	fputc( '"', file );
+}
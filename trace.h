@@ -0,0 +1,65 @@
+/**
+ *	@file trace.h Trace: linha do tempo da execuo no formato de eventos do
+ *		Chrome (chrome://tracing, Perfetto).
+ *
+ *	Cada fase medida  um intervalo (evento "X") na trilha da thread que a
+ *	executou; as trilhas so as threads de parFor (ver parGetThreadIndex), com
+ *	a chamadora na trilha "main" e as de parStart na trilha "async".
+ *
+ *	@date
+ *			Criado em:			18 de Outubro de 2026
+ *
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+
+/************************************************************************/
+/* Constantes Exportadas                                                */
+/************************************************************************/
+/** Tamanho mximo (com o '\0') do nome e da descrio de um evento; o excesso  cortado */
+#define TRACE_NAME_SIZE		32
+#define TRACE_DETAIL_SIZE	128
+
+
+/************************************************************************/
+/* Funes Exportadas                                                   */
+/************************************************************************/
+/**
+ *	Comea a gravar a linha do tempo. Os eventos ficam em memria at trcStop.
+ *	Os tempos so contados a partir desta chamada.
+ *
+ *	@param filename Arquivo JSON gravado por trcStop.
+ *
+ *	@return No-zero se a gravao comeou (zero se j havia uma em andamento).
+ */
+int trcStart( const char* filename );
+
+/**
+ *	Termina a gravao e grava os eventos no arquivo passado a trcStart. Deve
+ *	ser chamada quando nenhuma outra thread estiver gerando eventos.
+ *
+ *	@return No-zero se o arquivo foi gravado.
+ */
+int trcStop( void );
+
+/**
+ *	Marca o incio de um intervalo. Com a gravao desligada custa s um teste.
+ *
+ *	@return Instante de incio, a passar para trcEnd, ou um valor negativo se a
+ *			gravao est desligada (e trcEnd no faz nada).
+ */
+double trcBegin( void );
+
+/**
+ *	Registra o intervalo que vai de start at agora na trilha da thread corrente.
+ *
+ *	@param category Categoria do evento ("scene", "render", ...).
+ *	@param name Nome do evento.
+ *	@param start Valor retornado por trcBegin.
+ *	@param format Formato printf da descrio mostrada com o evento (pode ser NULL).
+ */
+void trcEnd( const char* category, const char* name, double start, const char* format, ... );
+
+#endif